@@ -3,21 +3,27 @@
  * SPDX-License-Identifier:	GPL-2.0+
  */
 
+#define _GNU_SOURCE	/* For the register names in ucontext_t */
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
 #include <time.h>
+#include <ucontext.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <linux/perf_event.h>
 #include <linux/types.h>
 
 #include <asm/getopt.h>
@@ -620,3 +626,99 @@ void os_localtime(struct rtc_time *rt)
 	rt->tm_yday = tm->tm_yday;
 	rt->tm_isdst = tm->tm_isdst;
 }
+
+static void (*os_profile_func)(unsigned long pc, unsigned long fp,
+			       unsigned long sp);
+
+static void os_profile_handler(int sig, siginfo_t *info, void *context)
+{
+	mcontext_t *mc = &((ucontext_t *)context)->uc_mcontext;
+
+#if defined(__x86_64__)
+	os_profile_func(mc->gregs[REG_RIP], mc->gregs[REG_RBP],
+			mc->gregs[REG_RSP]);
+#elif defined(__i386__)
+	os_profile_func(mc->gregs[REG_EIP], mc->gregs[REG_EBP],
+			mc->gregs[REG_ESP]);
+#elif defined(__aarch64__)
+	os_profile_func(mc->pc, mc->regs[29], mc->sp);
+#elif defined(__arm__)
+	os_profile_func(mc->arm_pc, mc->arm_fp, mc->arm_sp);
+#endif
+}
+
+int os_profile_timer(unsigned int interval_us,
+		     void (*func)(unsigned long pc, unsigned long fp,
+				  unsigned long sp))
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || \
+	defined(__arm__)
+	struct itimerval timer;
+	struct sigaction act;
+
+	memset(&timer, '\0', sizeof(timer));
+	memset(&act, '\0', sizeof(act));
+	if (interval_us) {
+		os_profile_func = func;
+		act.sa_sigaction = os_profile_handler;
+		act.sa_flags = SA_SIGINFO | SA_RESTART;
+		timer.it_interval.tv_sec = interval_us / 1000000;
+		timer.it_interval.tv_usec = interval_us % 1000000;
+		timer.it_value = timer.it_interval;
+	} else {
+		act.sa_handler = SIG_IGN;
+	}
+	sigemptyset(&act.sa_mask);
+
+	/* Stop the timer before dropping the handler, start it after */
+	if (!interval_us && setitimer(ITIMER_PROF, &timer, NULL))
+		return -errno;
+	if (sigaction(SIGPROF, &act, NULL))
+		return -errno;
+	if (interval_us && setitimer(ITIMER_PROF, &timer, NULL))
+		return -errno;
+
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+int os_perf_open(unsigned int hw_event)
+{
+	struct perf_event_attr attr;
+	int fd;
+
+	memset(&attr, '\0', sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = hw_event;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (fd < 0)
+		return -errno;
+
+	return fd;
+}
+
+int os_perf_enable(int fd, int enable)
+{
+	if (enable && ioctl(fd, PERF_EVENT_IOC_RESET, 0))
+		return -errno;
+	if (ioctl(fd, enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE,
+		  0))
+		return -errno;
+
+	return 0;
+}
+
+int os_perf_read(int fd, uint64_t *countp)
+{
+	if (read(fd, countp, sizeof(*countp)) != sizeof(*countp))
+		return -EIO;
+
+	return 0;
+}
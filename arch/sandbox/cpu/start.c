@@ -286,6 +286,7 @@ int main(int argc, char *argv[])
 		goto err;
 
 	state = state_get_current();
+	state->stack_top = &data;
 	if (os_parse_args(state, argc, argv))
 		return 1;
 
@@ -39,13 +39,56 @@ static inline void unmap_sysmem(const void *vaddr)
 /* Map from a pointer to our RAM buffer */
 phys_addr_t map_to_sysmem(const void *ptr);
 
-/* Define nops for sandbox I/O access */
-#define readb(addr) ((void)addr, 0)
-#define readw(addr) ((void)addr, 0)
-#define readl(addr) ((void)addr, 0)
-#define writeb(v, addr) ((void)addr)
-#define writew(v, addr) ((void)addr)
-#define writel(v, addr) ((void)addr)
+/* Emulated DMA devices see host addresses, so there is no translation */
+static inline unsigned long virt_to_phys(void *vaddr)
+{
+	return (unsigned long)vaddr;
+}
+
+/**
+ * struct sandbox_mmio_ops - operations of an emulated memory-mapped device
+ *
+ * @read:	Read a register. @offset is from the start of the window and
+ *		@size is the access size in bytes
+ * @write:	Write a register
+ */
+struct sandbox_mmio_ops {
+	unsigned int (*read)(void *priv, unsigned long offset, int size);
+	void (*write)(void *priv, unsigned long offset, unsigned int val,
+		      int size);
+};
+
+/**
+ * sandbox_mmio_add() - Emulate a device in a window of the address space
+ *
+ * Accesses with readl() and friends inside the window go to @ops. Others
+ * read as 0 and writes are dropped.
+ *
+ * @base:	Start of the window
+ * @size:	Size of the window in bytes
+ * @ops:	Device operations
+ * @priv:	Private data passed to @ops
+ * @return 0 if OK, -ENOSPC if too many windows are registered
+ */
+int sandbox_mmio_add(void *base, unsigned long size,
+		     const struct sandbox_mmio_ops *ops, void *priv);
+
+/**
+ * sandbox_mmio_remove() - Stop emulating a device
+ *
+ * @base:	Start of the window, as passed to sandbox_mmio_add()
+ */
+void sandbox_mmio_remove(void *base);
+
+unsigned int sandbox_mmio_read(unsigned long addr, int size);
+void sandbox_mmio_write(unsigned long addr, unsigned int val, int size);
+
+#define readb(addr) sandbox_mmio_read((unsigned long)(addr), 1)
+#define readw(addr) sandbox_mmio_read((unsigned long)(addr), 2)
+#define readl(addr) sandbox_mmio_read((unsigned long)(addr), 4)
+#define writeb(v, addr) sandbox_mmio_write((unsigned long)(addr), v, 1)
+#define writew(v, addr) sandbox_mmio_write((unsigned long)(addr), v, 2)
+#define writel(v, addr) sandbox_mmio_write((unsigned long)(addr), v, 4)
 
 /* I/O access functions */
 int inl(unsigned int addr);
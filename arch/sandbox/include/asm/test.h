@@ -79,4 +79,63 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_usb_flash_get_reads() - Get and reset a flash stick's read count
+ *
+ * @dev:	Emulated flash stick (UCLASS_USB_EMUL)
+ * @max_len:	Returns the largest number of blocks read by one command
+ * @return number of read commands received since the last call
+ */
+uint sandbox_usb_flash_get_reads(struct udevice *dev, uint *max_len);
+
+/**
+ * struct sandbox_ahci_stats - commands seen by an emulated AHCI controller
+ *
+ * @queued:	Number of READ/WRITE FPDMA QUEUED commands
+ * @unqueued:	Number of other commands
+ * @max_active:	Largest number of queued commands outstanding at once
+ * @flushes:	Number of FLUSH CACHE EXT commands
+ * @errors:	Number of commands failed by sandbox_ahci_fail_lba()
+ */
+struct sandbox_ahci_stats {
+	uint queued;
+	uint unqueued;
+	uint max_active;
+	uint flushes;
+	uint errors;
+};
+
+/**
+ * sandbox_ahci_add() - Add an emulated AHCI controller with one disk
+ *
+ * @disk:	Disk contents, which the controller reads and writes
+ * @blocks:	Size of the disk in 512-byte blocks
+ * @depth:	NCQ queue depth of the disk, or 0 for a disk without NCQ
+ * @return register base to pass to ahci_init(), or NULL if out of memory
+ */
+void *sandbox_ahci_add(u8 *disk, ulong blocks, uint depth);
+
+/**
+ * sandbox_ahci_remove() - Remove an emulated AHCI controller
+ *
+ * @mmio:	Register base returned by sandbox_ahci_add()
+ */
+void sandbox_ahci_remove(void *mmio);
+
+/**
+ * sandbox_ahci_fail_lba() - Make the next command touching a block fail
+ *
+ * @mmio:	Register base returned by sandbox_ahci_add()
+ * @lba:	Block to fail
+ */
+void sandbox_ahci_fail_lba(void *mmio, ulong lba);
+
+/**
+ * sandbox_ahci_get_stats() - Get and reset the controller's statistics
+ *
+ * @mmio:	Register base returned by sandbox_ahci_add()
+ * @stats:	Returns the statistics
+ */
+void sandbox_ahci_get_stats(void *mmio, struct sandbox_ahci_stats *stats);
+
 #endif
@@ -7,6 +7,8 @@
  */
 
 #include <common.h>
+#include <os.h>
+#include <profile.h>
 
 int interrupt_init(void)
 {
@@ -21,3 +23,15 @@ int disable_interrupts(void)
 {
 	return 0;
 }
+
+#ifdef CONFIG_PROFILE
+int profile_timer_start(uint rate)
+{
+	return os_profile_timer(1000000 / rate, profile_sample);
+}
+
+void profile_timer_stop(void)
+{
+	os_profile_timer(0, NULL);
+}
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Memory-mapped I/O for emulated devices
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <asm/io.h>
+
+#define SANDBOX_MMIO_WINDOWS	4
+
+struct sandbox_mmio {
+	unsigned long base;
+	unsigned long size;
+	const struct sandbox_mmio_ops *ops;
+	void *priv;
+};
+
+static struct sandbox_mmio sandbox_mmio[SANDBOX_MMIO_WINDOWS];
+
+int sandbox_mmio_add(void *base, unsigned long size,
+		     const struct sandbox_mmio_ops *ops, void *priv)
+{
+	struct sandbox_mmio *win;
+
+	for (win = sandbox_mmio; win < sandbox_mmio + SANDBOX_MMIO_WINDOWS;
+	     win++) {
+		if (win->ops)
+			continue;
+		win->base = (unsigned long)base;
+		win->size = size;
+		win->ops = ops;
+		win->priv = priv;
+		return 0;
+	}
+
+	return -ENOSPC;
+}
+
+void sandbox_mmio_remove(void *base)
+{
+	struct sandbox_mmio *win;
+
+	for (win = sandbox_mmio; win < sandbox_mmio + SANDBOX_MMIO_WINDOWS;
+	     win++) {
+		if (win->ops && win->base == (unsigned long)base)
+			win->ops = NULL;
+	}
+}
+
+static struct sandbox_mmio *sandbox_mmio_find(unsigned long addr)
+{
+	struct sandbox_mmio *win;
+
+	for (win = sandbox_mmio; win < sandbox_mmio + SANDBOX_MMIO_WINDOWS;
+	     win++) {
+		if (win->ops && addr - win->base < win->size)
+			return win;
+	}
+
+	return NULL;
+}
+
+unsigned int sandbox_mmio_read(unsigned long addr, int size)
+{
+	struct sandbox_mmio *win = sandbox_mmio_find(addr);
+
+	if (!win)
+		return 0;
+
+	return win->ops->read(win->priv, addr - win->base, size);
+}
+
+void sandbox_mmio_write(unsigned long addr, unsigned int val, int size)
+{
+	struct sandbox_mmio *win = sandbox_mmio_find(addr);
+
+	if (win)
+		win->ops->write(win->priv, addr - win->base, val, size);
+}
@@ -13,6 +13,7 @@
 
 #include <common.h>
 #include <dm.h>
+#include <profile.h>
 #include <asm/control_regs.h>
 #include <asm/i8259.h>
 #include <asm/interrupt.h>
@@ -297,6 +298,11 @@ void irq_llsr(struct irq_regs *regs)
 		/* Architecture defined exception */
 		do_exception(regs);
 	} else {
+		/* IRQ0 is the profiling timer, see profile_timer_start() */
+		if (IS_ENABLED(CONFIG_PROFILE) && regs->irq_id == 0x20)
+			profile_sample(regs->context.ctx1.eip, regs->ebp,
+				       regs->esp);
+
 		/* Hardware or User IRQ */
 		do_irq(regs->irq_id);
 	}
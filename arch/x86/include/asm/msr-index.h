@@ -569,6 +569,10 @@
 
 #define MSR_P4_PEBS_MATRIX_VERT		0x000003f2
 
+/* Intel architectural performance monitoring */
+#define MSR_ARCH_PERFMON_PERFCTR0	0x000000c1
+#define MSR_ARCH_PERFMON_EVENTSEL0	0x00000186
+
 /* Intel Core-based CPU performance counters */
 #define MSR_CORE_PERF_FIXED_CTR0	0x00000309
 #define MSR_CORE_PERF_FIXED_CTR1	0x0000030a
@@ -6,6 +6,8 @@
  */
 
 #include <common.h>
+#include <errno.h>
+#include <profile.h>
 #include <asm/io.h>
 #include <asm/i8254.h>
 
@@ -35,3 +37,36 @@ int i8254_init(void)
 
 	return 0;
 }
+
+#ifdef CONFIG_PROFILE
+/*
+ * Counter 0 drives IRQ0, which is not otherwise used. The sample itself is
+ * taken in irq_llsr(), which has the interrupted registers. The handler
+ * only needs to exist so that the interrupt is unmasked and acknowledged.
+ */
+static void i8254_profile_irq(void *arg)
+{
+}
+
+int profile_timer_start(uint rate)
+{
+	uint count = PIT_TICK_RATE / rate;
+
+	if (!rate || count < 2 || count > 0xffff)
+		return -EINVAL;
+
+	outb(PIT_CMD_CTR0 | PIT_CMD_BOTH | PIT_CMD_MODE2,
+	     PIT_BASE + PIT_COMMAND);
+	outb(count & 0xff, PIT_BASE + PIT_T0);
+	outb(count >> 8, PIT_BASE + PIT_T0);
+	irq_install_handler(0, i8254_profile_irq, NULL);
+	enable_interrupts();
+
+	return 0;
+}
+
+void profile_timer_stop(void)
+{
+	irq_free_handler(0);
+}
+#endif
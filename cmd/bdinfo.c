@@ -10,6 +10,7 @@
  */
 #include <common.h>
 #include <command.h>
+#include <malloc.h>
 #include <linux/compiler.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -419,8 +420,7 @@ static int do_bdinfo(cmd_tbl_t *cmdtp, int flag, int argc,
 	printf("Board Type  = %ld\n", gd->board_type);
 #endif
 #ifdef CONFIG_SYS_MALLOC_F
-	printf("Early malloc usage: %lx / %x\n", gd->malloc_ptr,
-	       CONFIG_SYS_MALLOC_F_LEN);
+	malloc_simple_info();
 #endif
 
 	return 0;
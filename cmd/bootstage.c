@@ -5,6 +5,8 @@
  */
 
 #include <common.h>
+#include <mapmem.h>
+#include <linux/sizes.h>
 
 static int do_bootstage_report(cmd_tbl_t *cmdtp, int flag, int argc,
 			       char * const argv[])
@@ -39,6 +41,7 @@ static int do_bootstage_stash(cmd_tbl_t *cmdtp, int flag, int argc,
 			      char * const argv[])
 {
 	ulong base, size;
+	void *buf;
 	int ret;
 
 	if (get_base_size(argc, argv, &base, &size))
@@ -48,20 +51,49 @@ static int do_bootstage_stash(cmd_tbl_t *cmdtp, int flag, int argc,
 		return 1;
 	}
 
+	buf = map_sysmem(base, size);
 	if (0 == strcmp(argv[0], "stash"))
-		ret = bootstage_stash((void *)base, size);
+		ret = bootstage_stash(buf, size);
 	else
-		ret = bootstage_unstash((void *)base, size);
+		ret = bootstage_unstash(buf, size);
+	unmap_sysmem(buf);
 	if (ret)
 		return 1;
 
 	return 0;
 }
 
+static int do_bootstage_export(cmd_tbl_t *cmdtp, int flag, int argc,
+			       char * const argv[])
+{
+	ulong base, size = SZ_64K;
+	char *buf;
+	int ret;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+	base = simple_strtoul(argv[1], NULL, 16);
+	if (argc > 2)
+		size = simple_strtoul(argv[2], NULL, 16);
+
+	buf = map_sysmem(base, size);
+	ret = bootstage_export(buf, size);
+	unmap_sysmem(buf);
+	if (ret < 0) {
+		printf("Bootstage export needs more than %#lx bytes\n", size);
+		return 1;
+	}
+	printf("%d bytes written\n", ret);
+	setenv_hex("filesize", ret);
+
+	return 0;
+}
+
 static cmd_tbl_t cmd_bootstage_sub[] = {
 	U_BOOT_CMD_MKENT(report, 2, 1, do_bootstage_report, "", ""),
 	U_BOOT_CMD_MKENT(stash, 4, 0, do_bootstage_stash, "", ""),
 	U_BOOT_CMD_MKENT(unstash, 4, 0, do_bootstage_stash, "", ""),
+	U_BOOT_CMD_MKENT(export, 3, 0, do_bootstage_export, "", ""),
 };
 
 /*
@@ -91,5 +123,7 @@ U_BOOT_CMD(bootstage, 4, 1, do_boostage,
 	" - check boot progress and timing\n"
 	"report                      - Print a report\n"
 	"stash [<start> [<size>]]    - Stash data into memory\n"
-	"unstash [<start> [<size>]]  - Unstash data from memory"
+	"unstash [<start> [<size>]]  - Unstash data from memory\n"
+	"export <start> [<size>]     - Write a Chrome trace to memory and set\n"
+	"                              'filesize', e.g. for a later 'save'"
 );
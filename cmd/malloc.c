@@ -0,0 +1,29 @@
+/*
+ * malloc() heap statistics
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+
+static int do_malloc(cmd_tbl_t *cmdtp, int flag, int argc,
+		     char * const argv[])
+{
+	if (argc != 2 || strcmp(argv[1], "info"))
+		return CMD_RET_USAGE;
+
+#ifdef CONFIG_SYS_MALLOC_F_LEN
+	malloc_simple_info();
+#endif
+	malloc_stats();
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	malloc,	2,	1,	do_malloc,
+	"malloc() heap",
+	"info - display heap usage, fragmentation and peak usage"
+);
@@ -25,6 +25,7 @@
 #include <console.h>
 #include <watchdog.h>
 #include <malloc.h>
+#include <div64.h>
 #include <asm/byteorder.h>
 #include <jffs2/jffs2.h>
 #include <nand.h>
@@ -285,6 +286,7 @@ static void nand_print_and_set_info(int idx)
 {
 	struct mtd_info *mtd = nand_info[idx];
 	struct nand_chip *chip = mtd_to_nand(mtd);
+	u32 read_ms;
 
 	printf("Device %d: ", idx);
 	if (chip->numchips > 1)
@@ -297,6 +299,12 @@ static void nand_print_and_set_info(int idx)
 	printf("  subpagesize %8d b\n", chip->subpagesize);
 	printf("  options     0x%8x\n", chip->options);
 	printf("  bbt options 0x%8x\n", chip->bbt_options);
+	printf("  cache read  %10s\n", NAND_HAS_CACHE_READ(chip) ? "yes" : "no");
+	read_ms = lldiv(chip->read_us, 1000);
+	if (read_ms)
+		printf("  read speed  %8llu KiB/s (%llu bytes read)\n",
+		       lldiv((chip->read_bytes >> 10) * 1000, read_ms),
+		       chip->read_bytes);
 
 	/* Set geometry info */
 	setenv_hex("nand_writesize", mtd->writesize);
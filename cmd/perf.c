@@ -0,0 +1,120 @@
+/*
+ * Performance counter commands
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <dm.h>
+#include <div64.h>
+#include <perf.h>
+
+/* Print @num / @den as a percentage, or as a ratio if @percent is false */
+static void print_ratio(u64 num, u64 den, bool percent, const char *what)
+{
+	u64 val;
+
+	if (!den)
+		return;
+	while (den >> 32) {
+		num >>= 1;
+		den >>= 1;
+	}
+	val = lldiv(num * (percent ? 10000 : 100), den);
+	printf("  # %5lu.%02lu%s %s", (ulong)lldiv(val, 100),
+	       (ulong)(val % 100), percent ? "%" : "", what);
+}
+
+static int do_perf_stat(cmd_tbl_t *cmdtp, int flag, int argc,
+			char * const argv[])
+{
+	u64 count[PERF_EVENT_COUNT];
+	struct udevice *dev;
+	int repeatable, event, events, ret;
+	int i;
+	ulong start, us;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+	ret = uclass_first_device_err(UCLASS_PERF, &dev);
+	if (ret) {
+		printf("No performance counters (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	events = perf_start(dev, (1 << PERF_EVENT_COUNT) - 1);
+	if (events < 0) {
+		printf("Cannot start counters (err=%d)\n", events);
+		return CMD_RET_FAILURE;
+	}
+	start = timer_get_us();
+	ret = cmd_process(0, argc - 1, argv + 1, &repeatable, NULL);
+	us = timer_get_us() - start;
+	perf_stop(dev);
+
+	printf("\nPerformance counter stats for '%s", argv[1]);
+	for (i = 2; i < argc; i++)
+		printf(" %s", argv[i]);
+	puts("':\n\n");
+	for (event = 0; event < PERF_EVENT_COUNT; event++) {
+		const char *name = perf_get_event_name(event);
+		int err;
+
+		count[event] = 0;
+		if (!(events & (1 << event)))
+			continue;
+		err = perf_read(dev, event, &count[event]);
+		if (err == -EOVERFLOW) {
+			printf("%15s  %-16s\n", "<overflow>", name);
+			count[event] = 0;
+			continue;
+		} else if (err) {
+			printf("%15s  %-16s (err=%d)\n", "<error>", name, err);
+			count[event] = 0;
+			continue;
+		}
+		print_grouped_ull(count[event], 15);
+		printf("  %-16s", name);
+		if (event == PERF_EVENT_INSTRUCTIONS)
+			print_ratio(count[event], count[PERF_EVENT_CYCLES],
+				    false, "insn per cycle");
+		else if (event == PERF_EVENT_CACHE_MISSES)
+			print_ratio(count[event], count[PERF_EVENT_CACHE_REFS],
+				    true, "of cache refs");
+		else if (event == PERF_EVENT_BRANCH_MISSES)
+			print_ratio(count[event], count[PERF_EVENT_BRANCHES],
+				    true, "of branches");
+		puts("\n");
+	}
+	printf("\n%8lu.%06lu seconds time elapsed\n", us / 1000000,
+	       us % 1000000);
+
+	return ret;
+}
+
+static cmd_tbl_t cmd_perf_sub[] = {
+	U_BOOT_CMD_MKENT(stat, CONFIG_SYS_MAXARGS, 0, do_perf_stat, "", ""),
+};
+
+static int do_perf(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	cmd_tbl_t *cp;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+	argc--;
+	argv++;
+
+	cp = find_cmd_tbl(argv[0], cmd_perf_sub, ARRAY_SIZE(cmd_perf_sub));
+	if (!cp)
+		return CMD_RET_USAGE;
+
+	return cp->cmd(cmdtp, flag, argc, argv);
+}
+
+U_BOOT_CMD(
+	perf,	CONFIG_SYS_MAXARGS,	0,	do_perf,
+	"performance counters",
+	"stat command [args...] - run a command and report event counts"
+);
@@ -0,0 +1,100 @@
+/*
+ * Sampling profiler commands
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <mapmem.h>
+#include <profile.h>
+
+/* Use the same buffer variables as the trace command, for proftool */
+static int get_args(int argc, char * const argv[], char **buff,
+		    size_t *buff_ptr, size_t *buff_size)
+{
+	if (argc == 3)
+		return -1;
+	if (argc < 4) {
+		*buff_size = getenv_ulong("profsize", 16, 0);
+		*buff = map_sysmem(getenv_ulong("profbase", 16, 0),
+				   *buff_size);
+		*buff_ptr = getenv_ulong("profoffset", 16, 0);
+	} else {
+		*buff_size = simple_strtoul(argv[3], NULL, 16);
+		*buff = map_sysmem(simple_strtoul(argv[2], NULL, 16),
+				   *buff_size);
+		*buff_ptr = 0;
+	}
+	if (!*buff_size || *buff_ptr > *buff_size)
+		return -1;
+
+	return 0;
+}
+
+static int create_sample_list(int argc, char * const argv[])
+{
+	size_t buff_size, avail, buff_ptr, used;
+	unsigned int needed;
+	char *buff;
+	int err;
+
+	if (get_args(argc, argv, &buff, &buff_ptr, &buff_size))
+		return -1;
+
+	avail = buff_size - buff_ptr;
+	err = profile_list_samples(buff + buff_ptr, avail, &needed);
+	if (err)
+		printf("Error: truncated (%#x bytes needed)\n", needed);
+	used = min(avail, (size_t)needed);
+	printf("Profile samples dumped to %08lx, size %#zx\n",
+	       (ulong)map_to_sysmem(buff + buff_ptr), used);
+
+	setenv_hex("profbase", map_to_sysmem(buff));
+	setenv_hex("profsize", buff_size);
+	setenv_hex("profoffset", buff_ptr + used);
+
+	return 0;
+}
+
+static int do_profile(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[])
+{
+	const char *cmd = argc < 2 ? NULL : argv[1];
+	uint rate;
+	int ret;
+
+	if (!cmd)
+		return CMD_RET_USAGE;
+	if (!strcmp(cmd, "start")) {
+		rate = argc > 2 ? simple_strtoul(argv[2], NULL, 10) :
+			CONFIG_PROFILE_RATE;
+		if (!rate)
+			return CMD_RET_USAGE;
+		ret = profile_start(rate);
+		if (ret) {
+			printf("Cannot start profiling (err=%d)\n", ret);
+			return CMD_RET_FAILURE;
+		}
+	} else if (!strcmp(cmd, "stop")) {
+		profile_stop();
+	} else if (!strcmp(cmd, "stats")) {
+		profile_print_stats();
+	} else if (!strcmp(cmd, "dump")) {
+		if (create_sample_list(argc, argv))
+			return CMD_RET_USAGE;
+	} else {
+		return CMD_RET_USAGE;
+	}
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	profile,	4,	1,	do_profile,
+	"sampling profiler",
+	"start [<rate>]             - start sampling <rate> times a second\n"
+	"profile stop                       - stop sampling\n"
+	"profile stats                      - display profiling statistics\n"
+	"profile dump [<addr> <size>]       - dump samples into buffer"
+);
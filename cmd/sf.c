@@ -153,48 +153,110 @@ static int do_spi_flash_probe(int argc, char * const argv[])
 	return 0;
 }
 
+/* Statistics gathered by spi_flash_update() */
+struct sf_update_stats {
+	size_t skipped;		/* bytes which already had the right data */
+	size_t erased;		/* bytes which did not need erasing */
+	ulong read_ms;
+	ulong erase_ms;
+	ulong write_ms;
+};
+
+/**
+ * Get the size of the next block to update: the largest erase block which
+ * starts at offset and fits in len, and at least one sector.
+ *
+ * @param flash		flash context pointer
+ * @param offset	flash offset of the block
+ * @param len		number of bytes left to update
+ * @return block size in bytes
+ */
+static u32 spi_flash_update_blksize(struct spi_flash *flash, u32 offset,
+				    size_t len)
+{
+	u32 size = flash->sector_size;
+	int i;
+
+	for (i = 0; i < SPI_FLASH_MAX_ERASE_TYPES; i++) {
+		u32 type = flash->erase_types[i].size;
+
+		if (type > size && !(offset % type) && len >= type)
+			size = type;
+	}
+
+	return size;
+}
+
+static bool spi_flash_is_erased(const char *buf, size_t len)
+{
+	const u32 *ptr = (const u32 *)buf;
+
+	/* Blocks are multiples of a sector, so this is word aligned */
+	for (; len >= sizeof(*ptr); len -= sizeof(*ptr)) {
+		if (*ptr++ != ~0U)
+			return false;
+	}
+
+	return true;
+}
+
 /**
  * Write a block of data to SPI flash, first checking if it is different from
  * what is already there.
  *
- * If the data being written is the same, then *skipped is incremented by len.
+ * If the data being written is the same, then stats->skipped is incremented
+ * by len. If the block is already erased it is written without erasing it.
  *
  * @param flash		flash context pointer
  * @param offset	flash offset to write
- * @param len		number of bytes to write
+ * @param blksize	size of the block to update (see
+ *			spi_flash_update_blksize())
+ * @param len		number of bytes to write, at most blksize
  * @param buf		buffer to write from
  * @param cmp_buf	read buffer to use to compare data
- * @param skipped	Count of skipped data (incremented by this function)
+ * @param stats		update statistics (updated by this function)
  * @return NULL if OK, else a string containing the stage which failed
  */
 static const char *spi_flash_update_block(struct spi_flash *flash, u32 offset,
-		size_t len, const char *buf, char *cmp_buf, size_t *skipped)
+		u32 blksize, size_t len, const char *buf, char *cmp_buf,
+		struct sf_update_stats *stats)
 {
 	char *ptr = (char *)buf;
+	ulong start;
 
-	debug("offset=%#x, sector_size=%#x, len=%#zx\n",
-	      offset, flash->sector_size, len);
-	/* Read the entire sector so to allow for rewriting */
-	if (spi_flash_read(flash, offset, flash->sector_size, cmp_buf))
+	debug("offset=%#x, blksize=%#x, len=%#zx\n", offset, blksize, len);
+	/* Read the entire block so to allow for rewriting */
+	start = get_timer(0);
+	if (spi_flash_read(flash, offset, blksize, cmp_buf))
 		return "read";
+	stats->read_ms += get_timer(start);
 	/* Compare only what is meaningful (len) */
 	if (memcmp(cmp_buf, buf, len) == 0) {
 		debug("Skip region %x size %zx: no change\n",
 		      offset, len);
-		*skipped += len;
+		stats->skipped += len;
 		return NULL;
 	}
-	/* Erase the entire sector */
-	if (spi_flash_erase(flash, offset, flash->sector_size))
+	/* Erase the entire block, unless that is already done */
+	start = get_timer(0);
+	if (spi_flash_is_erased(cmp_buf, blksize)) {
+		debug("Skip erase of region %x size %x: already erased\n",
+		      offset, blksize);
+		stats->erased += blksize;
+	} else if (spi_flash_erase(flash, offset, blksize)) {
 		return "erase";
-	/* If it's a partial sector, copy the data into the temp-buffer */
-	if (len != flash->sector_size) {
+	}
+	stats->erase_ms += get_timer(start);
+	/* If it's a partial block, copy the data into the temp-buffer */
+	if (len != blksize) {
 		memcpy(cmp_buf, buf, len);
 		ptr = cmp_buf;
 	}
-	/* Write one complete sector */
-	if (spi_flash_write(flash, offset, flash->sector_size, ptr))
+	/* Write one complete block */
+	start = get_timer(0);
+	if (spi_flash_write(flash, offset, blksize, ptr))
 		return "write";
+	stats->write_ms += get_timer(start);
 
 	return NULL;
 }
@@ -216,20 +278,29 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 	char *cmp_buf;
 	const char *end = buf + len;
 	size_t todo;		/* number of bytes to do in this pass */
-	size_t skipped = 0;	/* statistics */
+	struct sf_update_stats stats;
 	const ulong start_time = get_timer(0);
 	size_t scale = 1;
 	const char *start_buf = buf;
+	u32 blksize, max_blksize;
 	ulong delta;
+	int i;
+
+	memset(&stats, '\0', sizeof(stats));
+	max_blksize = flash->sector_size;
+	for (i = 0; i < SPI_FLASH_MAX_ERASE_TYPES; i++)
+		max_blksize = max(max_blksize, flash->erase_types[i].size);
 
 	if (end - buf >= 200)
 		scale = (end - buf) / 100;
-	cmp_buf = memalign(ARCH_DMA_MINALIGN, flash->sector_size);
+	cmp_buf = memalign(ARCH_DMA_MINALIGN, max_blksize);
 	if (cmp_buf) {
 		ulong last_update = get_timer(0);
 
 		for (; buf < end && !err_oper; buf += todo, offset += todo) {
-			todo = min_t(size_t, end - buf, flash->sector_size);
+			blksize = spi_flash_update_blksize(flash, offset,
+							   end - buf);
+			todo = min_t(size_t, end - buf, blksize);
 			if (get_timer(last_update) > 100) {
 				printf("   \rUpdating, %zu%% %lu B/s",
 				       100 - (end - buf) / scale,
@@ -237,8 +308,8 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 							 start_time));
 				last_update = get_timer(0);
 			}
-			err_oper = spi_flash_update_block(flash, offset, todo,
-					buf, cmp_buf, &skipped);
+			err_oper = spi_flash_update_block(flash, offset,
+					blksize, todo, buf, cmp_buf, &stats);
 		}
 	} else {
 		err_oper = "malloc";
@@ -251,10 +322,12 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 	}
 
 	delta = get_timer(start_time);
-	printf("%zu bytes written, %zu bytes skipped", len - skipped,
-	       skipped);
+	printf("%zu bytes written, %zu bytes skipped", len - stats.skipped,
+	       stats.skipped);
 	printf(" in %ld.%lds, speed %ld B/s\n",
 	       delta / 1000, delta % 1000, bytes_per_second(len, start_time));
+	printf("read %lu ms, erase %lu ms (%zu bytes already erased), write %lu ms\n",
+	       stats.read_ms, stats.erase_ms, stats.erased, stats.write_ms);
 
 	return 0;
 }
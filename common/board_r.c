@@ -276,8 +276,8 @@ static int initr_malloc(void)
 	ulong malloc_start;
 
 #ifdef CONFIG_SYS_MALLOC_F_LEN
-	debug("Pre-reloc malloc() used %#lx bytes (%ld KB)\n", gd->malloc_ptr,
-	      gd->malloc_ptr / 1024);
+	debug("Pre-reloc malloc() used %#lx bytes (%ld KB), peak %#lx\n",
+	      gd->malloc_ptr, gd->malloc_ptr / 1024, gd->malloc_peak);
 #endif
 	/* The malloc area is immediately below the monitor copy in DRAM */
 	malloc_start = gd->relocaddr - TOTAL_MALLOC_LEN;
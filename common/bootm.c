@@ -71,6 +71,10 @@ static inline void boot_start_lmb(bootm_headers_t *images) { }
 static int bootm_start(cmd_tbl_t *cmdtp, int flag, int argc,
 		       char * const argv[])
 {
+#ifdef CONFIG_LMB
+	/* Free the regions of an earlier bootm before forgetting them */
+	lmb_init(&images.lmb);
+#endif
 	memset((void *)&images, 0, sizeof(images));
 	images.verify = getenv_yesno("verify");
 
@@ -606,8 +610,10 @@ int do_bootm_states(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	boot_os_fn *boot_fn;
 	ulong iflag = 0;
 	int ret = 0, need_boot_fn;
+	int span, load_span;
 
 	images->state |= states;
+	span = bootstage_span_begin("bootm");
 
 	/*
 	 * Work through the states and see how far we get. We stop on
@@ -616,8 +622,11 @@ int do_bootm_states(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	if (states & BOOTM_STATE_START)
 		ret = bootm_start(cmdtp, flag, argc, argv);
 
-	if (!ret && (states & BOOTM_STATE_FINDOS))
+	if (!ret && (states & BOOTM_STATE_FINDOS)) {
+		load_span = bootstage_span_begin("bootm_find_os");
 		ret = bootm_find_os(cmdtp, flag, argc, argv);
+		bootstage_span_end(load_span);
+	}
 
 	if (!ret && (states & BOOTM_STATE_FINDOTHER))
 		ret = bootm_find_other(cmdtp, flag, argc, argv);
@@ -627,7 +636,9 @@ int do_bootm_states(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		ulong load_end;
 
 		iflag = bootm_disable_interrupts();
+		load_span = bootstage_span_begin("bootm_load_os");
 		ret = bootm_load_os(images, &load_end, 0);
+		bootstage_span_end(load_span);
 		if (ret == 0)
 			lmb_reserve(&images->lmb, images->os.load,
 				    (load_end - images->os.load));
@@ -659,8 +670,10 @@ int do_bootm_states(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 #endif
 
 	/* From now on, we need the OS boot function */
-	if (ret)
+	if (ret) {
+		bootstage_span_end(span);
 		return ret;
+	}
 	boot_fn = bootm_os_get_boot_func(images->os.os);
 	need_boot_fn = states & (BOOTM_STATE_OS_CMDLINE |
 			BOOTM_STATE_OS_BD_T | BOOTM_STATE_OS_PREP |
@@ -671,6 +684,7 @@ int do_bootm_states(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		printf("ERROR: booting os '%s' (%d) is not supported\n",
 		       genimg_get_os_name(images->os.os), images->os.os);
 		bootstage_error(BOOTSTAGE_ID_CHECK_BOOT_OS);
+		bootstage_span_end(span);
 		return 1;
 	}
 
@@ -703,6 +717,7 @@ int do_bootm_states(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	/* Check for unsupported subcommand. */
 	if (ret) {
 		puts("subcommand not supported\n");
+		bootstage_span_end(span);
 		return ret;
 	}
 
@@ -720,6 +735,7 @@ err:
 		bootstage_error(BOOTSTAGE_ID_DECOMP_UNIMPL);
 	else if (ret == BOOTM_ERR_RESET)
 		do_reset(cmdtp, flag, argc, argv);
+	bootstage_span_end(span);
 
 	return ret;
 }
@@ -19,6 +19,9 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Longest span name kept, including the terminator */
+#define BOOTSTAGE_SPAN_NAME_LEN	32
+
 struct bootstage_record {
 	ulong time_us;
 	uint32_t start_us;
@@ -27,11 +30,46 @@ struct bootstage_record {
 	enum bootstage_id id;
 };
 
+/**
+ * struct bootstage_span - a span of time, which may contain other spans
+ *
+ * @start_us:	Time the span started
+ * @end_us:	Time the span ended, if it is closed
+ * @parent:	Number of the enclosing span, or -1 if none
+ * @open:	true until the span ends
+ * @name:	Name of the span, copied since the caller's may not last
+ */
+struct bootstage_span {
+	ulong start_us;
+	ulong end_us;
+	int parent;
+	bool open;
+	char name[BOOTSTAGE_SPAN_NAME_LEN];
+};
+
 static struct bootstage_record record[BOOTSTAGE_ID_COUNT] = { {1} };
 static int next_id = BOOTSTAGE_ID_USER;
 
+/*
+ * Spans start in a fixed table, which moves to the heap once malloc() is
+ * fully up and grows there up to CONFIG_BOOTSTAGE_SPAN_MAX entries
+ */
+static struct bootstage_span early_spans[CONFIG_BOOTSTAGE_SPAN_COUNT];
+
+static struct {
+	struct bootstage_span *table;
+	int size;		/* Entries in @table */
+	int count;
+	int cur;		/* Innermost open span, or -1 */
+	int dropped;		/* Spans not recorded for lack of space */
+} spans = {
+	.table = early_spans,
+	.size = CONFIG_BOOTSTAGE_SPAN_COUNT,
+	.cur = -1,
+};
+
 enum {
-	BOOTSTAGE_VERSION	= 0,
+	BOOTSTAGE_VERSION	= 1,
 	BOOTSTAGE_MAGIC		= 0xb00757a3,
 	BOOTSTAGE_DIGITS	= 9,
 };
@@ -41,6 +79,8 @@ struct bootstage_hdr {
 	uint32_t count;		/* Number of records */
 	uint32_t size;		/* Total data size (non-zero if valid) */
 	uint32_t magic;		/* Unused */
+	uint32_t span_count;	/* Number of spans, after the records */
+	uint32_t reserved;	/* Keeps the records aligned */
 };
 
 int bootstage_relocate(void)
@@ -131,6 +171,70 @@ ulong bootstage_mark_code(const char *file, const char *func, int linenum)
 	return bootstage_mark_name(BOOTSTAGE_ID_ALLOC, str);
 }
 
+/* Get the next free span, growing the table if needed */
+static struct bootstage_span *bootstage_span_alloc(void)
+{
+	struct bootstage_span *table;
+	int size;
+
+	if (spans.count < spans.size)
+		return &spans.table[spans.count];
+
+	size = min(spans.size * 2, CONFIG_BOOTSTAGE_SPAN_MAX);
+	if (size <= spans.size || !(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return NULL;
+	table = malloc(size * sizeof(*table));
+	if (!table)
+		return NULL;
+	memcpy(table, spans.table, spans.count * sizeof(*table));
+	if (spans.table != early_spans)
+		free(spans.table);
+	spans.table = table;
+	spans.size = size;
+
+	return &spans.table[spans.count];
+}
+
+int bootstage_span_begin(const char *name)
+{
+	struct bootstage_span *sp;
+
+	sp = bootstage_span_alloc();
+	if (!sp) {
+		spans.dropped++;
+		return -1;
+	}
+
+	sp->start_us = timer_get_boot_us();
+	strlcpy(sp->name, name, sizeof(sp->name));
+	sp->parent = spans.cur;
+	sp->open = true;
+	spans.cur = spans.count;
+
+	return spans.count++;
+}
+
+void bootstage_span_end(int num)
+{
+	ulong now;
+	int i;
+
+	/* Only spans which are still open can end */
+	for (i = spans.cur; i != -1 && i != num; i = spans.table[i].parent)
+		;
+	if (i == -1)
+		return;
+
+	/* Anything still open inside this span ends with it */
+	now = timer_get_boot_us();
+	do {
+		i = spans.cur;
+		spans.table[i].end_us = now;
+		spans.table[i].open = false;
+		spans.cur = spans.table[i].parent;
+	} while (i != num);
+}
+
 uint32_t bootstage_start(enum bootstage_id id, const char *name)
 {
 	struct bootstage_record *rec = &record[id];
@@ -259,6 +363,23 @@ int bootstage_fdt_add_report(void)
 }
 #endif
 
+static void print_span(int num)
+{
+	struct bootstage_span *sp = &spans.table[num];
+	int depth = 0;
+	int i;
+
+	for (i = sp->parent; i != -1; i = spans.table[i].parent)
+		depth++;
+
+	print_grouped_ull(sp->start_us, BOOTSTAGE_DIGITS);
+	if (sp->open)
+		printf("%11s", "open");
+	else
+		print_grouped_ull(sp->end_us - sp->start_us, BOOTSTAGE_DIGITS);
+	printf("  %*s%s\n", depth * 2, "", sp->name);
+}
+
 void bootstage_report(void)
 {
 	struct bootstage_record *rec = record;
@@ -290,6 +411,18 @@ void bootstage_report(void)
 		if (rec->start_us)
 			prev = print_time_record(id, rec, -1);
 	}
+
+	if (!spans.count)
+		return;
+	puts("\nSpans:\n");
+	printf("%11s%11s  %s\n", "Start", "Duration", "Span");
+	for (id = 0; id < spans.count; id++)
+		print_span(id);
+	if (spans.dropped)
+		printf("(Dropped %d spans\n"
+		       "- please increase CONFIG_BOOTSTAGE_SPAN_COUNT or\n"
+		       "  CONFIG_BOOTSTAGE_SPAN_MAX\n",
+		       spans.dropped);
 }
 
 ulong __timer_get_boot_us(void)
@@ -357,6 +490,8 @@ int bootstage_stash(void *base, int size)
 	hdr->count = count;
 	hdr->size = 0;
 	hdr->magic = BOOTSTAGE_MAGIC;
+	hdr->span_count = spans.count;
+	hdr->reserved = 0;
 	ptr += sizeof(*hdr);
 
 	/* Write the records, silently stopping when we run out of space */
@@ -375,6 +510,10 @@ int bootstage_stash(void *base, int size)
 		}
 	}
 
+	/* Then the spans, aligned */
+	ptr = base + ALIGN(ptr - (char *)base, sizeof(ulong));
+	append_data(&ptr, end, spans.table, spans.count * sizeof(*spans.table));
+
 	/* Check for buffer overflow */
 	if (ptr > end) {
 		debug("%s: Not enough space for bootstage stash\n", __func__);
@@ -383,7 +522,7 @@ int bootstage_stash(void *base, int size)
 
 	/* Update total data size */
 	hdr->size = ptr - (char *)base;
-	printf("Stashed %d records\n", hdr->count);
+	printf("Stashed %d records, %d spans\n", hdr->count, hdr->span_count);
 
 	return 0;
 }
@@ -392,9 +531,10 @@ int bootstage_unstash(void *base, int size)
 {
 	struct bootstage_hdr *hdr = (struct bootstage_hdr *)base;
 	struct bootstage_record *rec;
+	struct bootstage_span *sp;
 	char *ptr = base, *end = ptr + size;
 	uint rec_size;
-	int id;
+	int id, first;
 
 	if (size == -1)
 		end = (char *)(~(uintptr_t)0);
@@ -414,7 +554,8 @@ int bootstage_unstash(void *base, int size)
 		return -1;
 	}
 
-	if (hdr->count * sizeof(*rec) > hdr->size) {
+	if (hdr->count * sizeof(*rec) + hdr->span_count * sizeof(*sp) >
+	    hdr->size) {
 		debug("%s: Bootstage has %d records needing %lu bytes, but "
 			"only %d bytes is available\n", __func__, hdr->count,
 		      (ulong)hdr->count * sizeof(*rec), hdr->size);
@@ -451,7 +592,110 @@ int bootstage_unstash(void *base, int size)
 
 	/* Mark the records as read */
 	next_id += hdr->count;
-	printf("Unstashed %d records\n", hdr->count);
+
+	/*
+	 * Add the spans after our own. They keep their nesting, but spans
+	 * which were open when stashed stay open for good.
+	 */
+	ptr = base + ALIGN(ptr - (char *)base, sizeof(ulong));
+	sp = (struct bootstage_span *)ptr;
+	first = spans.count;
+	for (id = 0; id < hdr->span_count; id++, sp++) {
+		struct bootstage_span *new = bootstage_span_alloc();
+
+		if (!new) {
+			spans.dropped += hdr->span_count - id;
+			break;
+		}
+		*new = *sp;
+		if (sp->parent != -1)
+			new->parent = first + sp->parent;
+		spans.count++;
+	}
+	printf("Unstashed %d records, %d spans\n", hdr->count,
+	       spans.count - first);
 
 	return 0;
 }
+
+static void append_string(char **ptrp, char *end, const char *str)
+{
+	append_data(ptrp, end, str, strlen(str));
+}
+
+/* Append a string to a memory buffer, quoted and escaped for JSON */
+static void append_json_string(char **ptrp, char *end, const char *str)
+{
+	append_string(ptrp, end, "\"");
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			append_string(ptrp, end, "\\");
+		if ((uchar)*str >= ' ')
+			append_data(ptrp, end, str, 1);
+	}
+	append_string(ptrp, end, "\"");
+}
+
+/*
+ * Append a trace event: an instant if @dur_us is -1, else a complete event
+ * covering the given time
+ */
+static void append_trace_event(char **ptrp, char *end, const char *name,
+			       const char *cat, ulong time_us, ulong dur_us)
+{
+	char buf[40];
+
+	append_string(ptrp, end, "{\"name\":");
+	append_json_string(ptrp, end, name);
+	snprintf(buf, sizeof(buf), ",\"cat\":\"%s\",\"ts\":%lu", cat, time_us);
+	append_string(ptrp, end, buf);
+	if (dur_us == -1UL) {
+		append_string(ptrp, end, ",\"ph\":\"i\",\"s\":\"g\"");
+	} else {
+		snprintf(buf, sizeof(buf), ",\"ph\":\"X\",\"dur\":%lu", dur_us);
+		append_string(ptrp, end, buf);
+	}
+	append_string(ptrp, end, ",\"pid\":0,\"tid\":0}");
+}
+
+int bootstage_export(char *base, int size)
+{
+	struct bootstage_record *rec;
+	char *ptr = base, *end = ptr + size;
+	char buf[20];
+	ulong now;
+	int id;
+
+	now = timer_get_boot_us();
+	append_string(&ptr, end, "{\"traceEvents\":[\n");
+
+	/*
+	 * Marks are instants, spans become complete events. As in the report,
+	 * the first record stands for the reset.
+	 */
+	append_trace_event(&ptr, end, "reset", "mark", 0, -1UL);
+	for (rec = record, id = 0; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
+		if (!rec->time_us || rec->start_us || !rec->id)
+			continue;
+		append_string(&ptr, end, ",\n");
+		append_trace_event(&ptr, end,
+				   get_record_name(buf, sizeof(buf), rec),
+				   "mark", rec->time_us, -1UL);
+	}
+	for (id = 0; id < spans.count; id++) {
+		struct bootstage_span *sp = &spans.table[id];
+
+		append_string(&ptr, end, ",\n");
+		append_trace_event(&ptr, end, sp->name, "span", sp->start_us,
+				   (sp->open ? now : sp->end_us) -
+				   sp->start_us);
+	}
+	append_string(&ptr, end, "\n]}\n");
+
+	if (ptr > end) {
+		debug("%s: Not enough space for bootstage export\n", __func__);
+		return -ENOSPC;
+	}
+
+	return ptr - base;
+}
@@ -36,6 +36,9 @@ int run_usb_dnl_gadget(int usbctrl_index, char *usb_dnl_gadget)
 		return CMD_RET_FAILURE;
 	}
 
+	/* Full buffers are written out below, between the USB polls */
+	dfu_set_async_drain(true);
+
 	while (1) {
 		if (g_dnl_detach()) {
 			/*
@@ -80,10 +83,20 @@ int run_usb_dnl_gadget(int usbctrl_index, char *usb_dnl_gadget)
 			}
 		}
 
+		/*
+		 * Write the staged data a piece at a time, so that the host
+		 * can keep sending the next blocks into the other half of
+		 * the buffer meanwhile. A write error is reported to the host
+		 * with the next block.
+		 */
+		if (dfu_get_defer_drain())
+			dfu_drain(dfu_get_defer_drain());
+
 		WATCHDOG_RESET();
 		usb_gadget_handle_interrupts(usbctrl_index);
 	}
 exit:
+	dfu_set_async_drain(false);
 	g_dnl_unregister();
 	board_usb_cleanup(usbctrl_index, USB_INIT_DEVICE);
 
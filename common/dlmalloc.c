@@ -7,15 +7,13 @@
 #include <malloc.h>
 #include <asm/io.h>
 
-#ifdef DEBUG
 #if __STD_C
-static void malloc_update_mallinfo (void);
+static unsigned long malloc_update_mallinfo (void);
 void malloc_stats (void);
 #else
-static void malloc_update_mallinfo ();
+static unsigned long malloc_update_mallinfo ();
 void malloc_stats();
 #endif
-#endif	/* DEBUG */
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -608,6 +606,10 @@ void mem_malloc_init(ulong start, ulong size)
 	      mem_malloc_end);
 #ifdef CONFIG_SYS_MALLOC_CLEAR_ON_INIT
 	memset((void *)mem_malloc_start, 0x0, size);
+#endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+	/* Small objects come from slabs at the top, out of reach of sbrk() */
+	mem_malloc_end -= malloc_slab_init(mem_malloc_end, size);
 #endif
 	malloc_bin_reloc();
 }
@@ -699,9 +701,7 @@ static struct mallinfo current_mallinfo = {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
 /* Tracking mmaps */
 
-#ifdef DEBUG
 static unsigned int n_mmaps = 0;
-#endif	/* DEBUG */
 static unsigned long mmapped_mem = 0;
 #if HAVE_MMAP
 static unsigned int max_n_mmaps = 0;
@@ -1233,11 +1233,40 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 
 */
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+/*
+ * Small requests are served from the size-class slabs while they have
+ * room, the rest from chunks. Callers which need a real chunk, such as
+ * memalign(), use chunk_malloc() directly.
+ */
+static Void_t *chunk_malloc(size_t bytes);
+
+Void_t *mALLOc(size_t bytes)
+{
+  Void_t *mem;
+
+#ifdef CONFIG_SYS_MALLOC_F_LEN
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return malloc_simple(bytes);
+#endif
+
+  mem = malloc_slab_alloc(bytes);
+  if (mem)
+    return mem;
+
+  return chunk_malloc(bytes);
+}
+
+static Void_t *chunk_malloc(size_t bytes)
+#else
+#define chunk_malloc mALLOc
+
 #if __STD_C
 Void_t* mALLOc(size_t bytes)
 #else
 Void_t* mALLOc(bytes) size_t bytes;
 #endif
+#endif
 {
   mchunkptr victim;                  /* inspected/selected chunk */
   INTERNAL_SIZE_T victim_size;       /* its size */
@@ -1523,14 +1552,24 @@ void fREe(mem) Void_t* mem;
   int       islr;      /* track whether merging with last_remainder */
 
 #ifdef CONFIG_SYS_MALLOC_F_LEN
-	/* free() is a no-op - all the memory will be freed on relocation */
-	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+	/* all the memory will be freed on relocation anyway */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		free_simple(mem);
 		return;
+	}
 #endif
 
   if (mem == NULL)                              /* free(0) has no effect */
     return;
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+  if (malloc_slab_owns(mem))
+  {
+    malloc_slab_free(mem);
+    return;
+  }
+#endif
+
   p = mem2chunk(mem);
   hd = p->size;
 
@@ -1686,6 +1725,19 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 	}
 #endif
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+  if (malloc_slab_owns(oldmem))
+  {
+    oldsize = malloc_slab_usable_size(oldmem);
+    if (bytes <= oldsize) return oldmem;
+    newmem = mALLOc(bytes);
+    if (newmem == NULL) return NULL;
+    MALLOC_COPY(newmem, oldmem, oldsize);
+    fREe(oldmem);
+    return newmem;
+  }
+#endif
+
   newp    = oldp    = mem2chunk(oldmem);
   newsize = oldsize = chunksize(oldp);
 
@@ -1804,7 +1856,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
     /* Must allocate */
 
-    newmem = mALLOc (bytes);
+    newmem = chunk_malloc(bytes);
 
     if (newmem == NULL)  /* propagate failure */
       return NULL;
@@ -1898,7 +1950,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
   /* Call malloc with worst case padding to hit alignment. */
 
   nb = request2size(bytes);
-  m  = (char*)(mALLOc(nb + alignment + MINSIZE));
+  m  = (char*)(chunk_malloc(nb + alignment + MINSIZE));
 
   /*
   * The attempt to over-allocate (with a size large enough to guarantee the
@@ -1914,7 +1966,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
      * Use bytes not nb, since mALLOc internally calls request2size too, and
      * each call increases the size to allocate, to account for the header.
      */
-    m  = (char*)(mALLOc(bytes));
+    m  = (char*)(chunk_malloc(bytes));
     /* Aligned -> return it */
     if ((((unsigned long)(m)) % alignment) == 0)
       return m;
@@ -1925,7 +1977,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     fREe(m);
     /* Add in extra bytes to match misalignment of unexpanded allocation */
     extra = alignment - (((unsigned long)(m)) % alignment);
-    m  = (char*)(mALLOc(bytes + extra));
+    m  = (char*)(chunk_malloc(bytes + extra));
     /*
      * m might not be the same as before. Validate that the previous value of
      * extra still works for the current value of m.
@@ -2079,6 +2131,13 @@ Void_t* cALLOc(n, elem_size) size_t n; size_t elem_size;
 		MALLOC_ZERO(mem, sz);
 		return mem;
 	}
+#endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+    if (malloc_slab_owns(mem))
+    {
+      MALLOC_ZERO(mem, sz);
+      return mem;
+    }
 #endif
     p = mem2chunk(mem);
 
@@ -2227,6 +2286,10 @@ size_t malloc_usable_size(mem) Void_t* mem;
   mchunkptr p;
   if (mem == NULL)
     return 0;
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+  else if (malloc_slab_owns(mem))
+    return malloc_slab_usable_size(mem);
+#endif
   else
   {
     p = mem2chunk(mem);
@@ -2243,10 +2306,12 @@ size_t malloc_usable_size(mem) Void_t* mem;
 
 
 
-/* Utility to update current_mallinfo for malloc_stats and mallinfo() */
+/*
+  Utility to update current_mallinfo for malloc_stats and mallinfo(). It
+  returns the size of the largest free chunk, to show fragmentation.
+*/
 
-#ifdef DEBUG
-static void malloc_update_mallinfo()
+static unsigned long malloc_update_mallinfo()
 {
   int i;
   mbinptr b;
@@ -2256,6 +2321,7 @@ static void malloc_update_mallinfo()
 #endif
 
   INTERNAL_SIZE_T avail = chunksize(top);
+  INTERNAL_SIZE_T largest = avail;
   int   navail = ((long)(avail) >= (long)MINSIZE)? 1 : 0;
 
   for (i = 1; i < NAV; ++i)
@@ -2271,19 +2337,25 @@ static void malloc_update_mallinfo()
 	check_inuse_chunk(q);
 #endif
       avail += chunksize(p);
+      if (chunksize(p) > largest)
+	largest = chunksize(p);
       navail++;
     }
   }
 
   current_mallinfo.ordblks = navail;
   current_mallinfo.uordblks = sbrked_mem - avail;
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+  /* Count the slabs too, so that callers checking for leaks see them */
+  current_mallinfo.uordblks += malloc_slab_inuse();
+#endif
   current_mallinfo.fordblks = avail;
   current_mallinfo.hblks = n_mmaps;
   current_mallinfo.hblkhd = mmapped_mem;
   current_mallinfo.keepcost = chunksize(top);
 
+  return largest;
 }
-#endif	/* DEBUG */
 
 
 
@@ -2300,24 +2372,44 @@ static void malloc_update_mallinfo()
     number requested. It will be larger than the number requested
     because of alignment and bookkeeping overhead.)
 
+    It also prints the free space in the heap and how fragmented it is:
+    the share of the free space outside the largest free chunk, which no
+    single request can use.
+
+    With the slab allocator, the slab region counts as system bytes and
+    the slab objects as bytes in use.
+
 */
 
-#ifdef DEBUG
 void malloc_stats()
 {
-  malloc_update_mallinfo();
+  unsigned long largest = malloc_update_mallinfo();
+  unsigned long avail = current_mallinfo.fordblks;
+  unsigned long slab_size = 0;
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+  /* The slab objects are in use, so count the region they come from */
+  slab_size = malloc_slab_size();
+#endif
   printf("max system bytes = %10u\n",
-	  (unsigned int)(max_total_mem));
+	  (unsigned int)(max_total_mem + slab_size));
   printf("system bytes     = %10u\n",
-	  (unsigned int)(sbrked_mem + mmapped_mem));
+	  (unsigned int)(sbrked_mem + mmapped_mem + slab_size));
   printf("in use bytes     = %10u\n",
 	  (unsigned int)(current_mallinfo.uordblks + mmapped_mem));
+  printf("free bytes       = %10lu in %d chunks, largest %lu\n",
+	  avail, current_mallinfo.ordblks, largest);
+  printf("fragmentation    = %10lu%%\n",
+	  avail ? (avail - largest) / DIV_ROUND_UP(avail, 100) : 0);
+  printf("heap bytes       = %10lu\n", mem_malloc_end - mem_malloc_start);
 #if HAVE_MMAP
   printf("max mmap regions = %10u\n",
 	  (unsigned int)max_n_mmaps);
 #endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+  malloc_slab_print_stats();
+#endif
 }
-#endif	/* DEBUG */
 
 /*
   mallinfo returns a copy of updated current mallinfo.
@@ -2379,6 +2471,8 @@ int initf_malloc(void)
 	assert(gd->malloc_base);	/* Set up by crt0.S */
 	gd->malloc_limit = CONFIG_SYS_MALLOC_F_LEN;
 	gd->malloc_ptr = 0;
+	gd->malloc_peak = 0;
+	gd->malloc_freed = 0;
 #endif
 
 	return 0;
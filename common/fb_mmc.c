@@ -68,6 +68,49 @@ static lbaint_t fb_mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DISCARD
+static lbaint_t fb_mmc_sparse_erase(struct sparse_storage *info,
+		lbaint_t blk, lbaint_t blkcnt)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+	struct blk_desc *dev_desc = sparse->dev_desc;
+
+	return blk_derase(dev_desc, blk, blkcnt);
+}
+#endif
+
+static void fb_mmc_sparse_init(struct sparse_storage *sparse,
+			       struct fb_mmc_sparse *sparse_priv,
+			       struct blk_desc *dev_desc,
+			       disk_partition_t *info)
+{
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DISCARD
+	struct mmc *mmc;
+#endif
+
+	sparse_priv->dev_desc = dev_desc;
+
+	sparse->blksz = info->blksz;
+	sparse->start = info->start;
+	sparse->size = info->size;
+	sparse->write = fb_mmc_sparse_write;
+	sparse->reserve = fb_mmc_sparse_reserve;
+	sparse->erase = NULL;
+	sparse->erased_val = -1;
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DISCARD
+	mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (mmc) {
+		sparse->erase = fb_mmc_sparse_erase;
+		sparse->erase_blks = mmc->erase_grp_size;
+		sparse->erased_val = mmc->erased_val;
+	}
+#endif
+	sparse->priv = sparse_priv;
+
+	printf("Flashing sparse image at offset " LBAFU "\n",
+	       sparse->start);
+}
+
 static void write_raw_image(struct blk_desc *dev_desc, disk_partition_t *info,
 		const char *part_name, void *buffer,
 		unsigned int download_bytes)
@@ -163,18 +206,7 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 		struct fb_mmc_sparse sparse_priv;
 		struct sparse_storage sparse;
 
-		sparse_priv.dev_desc = dev_desc;
-
-		sparse.blksz = info.blksz;
-		sparse.start = info.start;
-		sparse.size = info.size;
-		sparse.write = fb_mmc_sparse_write;
-		sparse.reserve = fb_mmc_sparse_reserve;
-
-		printf("Flashing sparse image at offset " LBAFU "\n",
-		       sparse.start);
-
-		sparse.priv = &sparse_priv;
+		fb_mmc_sparse_init(&sparse, &sparse_priv, dev_desc, &info);
 		write_sparse_image(&sparse, cmd, download_buffer,
 				   download_bytes);
 	} else {
@@ -183,6 +215,35 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 	}
 }
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+int fb_mmc_flash_stream(const char *cmd, struct sparse_writer *sw)
+{
+	/* Used by @sw until the download is complete */
+	static struct fb_mmc_sparse sparse_priv;
+	static struct sparse_storage sparse;
+	struct blk_desc *dev_desc;
+	disk_partition_t info;
+
+	dev_desc = blk_get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
+		error("invalid mmc device\n");
+		fastboot_fail("invalid mmc device");
+		return -ENODEV;
+	}
+
+	if (part_get_info_by_name_or_alias(dev_desc, cmd, &info)) {
+		error("cannot find partition: '%s'\n", cmd);
+		fastboot_fail("cannot find partition");
+		return -ENOENT;
+	}
+
+	fb_mmc_sparse_init(&sparse, &sparse_priv, dev_desc, &info);
+	sparse_writer_start(sw, &sparse, cmd);
+
+	return 0;
+}
+#endif
+
 void fb_mmc_erase(const char *cmd)
 {
 	int ret;
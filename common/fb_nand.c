@@ -145,6 +145,26 @@ static lbaint_t fb_nand_sparse_reserve(struct sparse_storage *info,
 	return blkcnt + bad_blocks;
 }
 
+static void fb_nand_sparse_init(struct sparse_storage *sparse,
+				struct fb_nand_sparse *sparse_priv,
+				struct mtd_info *mtd, struct part_info *part)
+{
+	sparse_priv->mtd = mtd;
+	sparse_priv->part = part;
+
+	sparse->blksz = mtd->writesize;
+	sparse->start = part->offset / sparse->blksz;
+	sparse->size = part->size / sparse->blksz;
+	sparse->write = fb_nand_sparse_write;
+	sparse->reserve = fb_nand_sparse_reserve;
+	sparse->erase = NULL;
+	sparse->erased_val = -1;
+	sparse->priv = sparse_priv;
+
+	printf("Flashing sparse image at offset " LBAFU "\n",
+	       sparse->start);
+}
+
 void fb_nand_flash_write(const char *cmd, void *download_buffer,
 			 unsigned int download_bytes)
 {
@@ -167,19 +187,7 @@ void fb_nand_flash_write(const char *cmd, void *download_buffer,
 		struct fb_nand_sparse sparse_priv;
 		struct sparse_storage sparse;
 
-		sparse_priv.mtd = mtd;
-		sparse_priv.part = part;
-
-		sparse.blksz = mtd->writesize;
-		sparse.start = part->offset / sparse.blksz;
-		sparse.size = part->size / sparse.blksz;
-		sparse.write = fb_nand_sparse_write;
-		sparse.reserve = fb_nand_sparse_reserve;
-
-		printf("Flashing sparse image at offset " LBAFU "\n",
-		       sparse.start);
-
-		sparse.priv = &sparse_priv;
+		fb_nand_sparse_init(&sparse, &sparse_priv, mtd, part);
 		write_sparse_image(&sparse, cmd, download_buffer,
 				   download_bytes);
 	} else {
@@ -201,6 +209,34 @@ void fb_nand_flash_write(const char *cmd, void *download_buffer,
 	fastboot_okay("");
 }
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+int fb_nand_flash_stream(const char *cmd, struct sparse_writer *sw)
+{
+	/* Used by @sw until the download is complete */
+	static struct fb_nand_sparse sparse_priv;
+	static struct sparse_storage sparse;
+	struct part_info *part;
+	struct mtd_info *mtd = NULL;
+	int ret;
+
+	ret = fb_nand_lookup(cmd, &mtd, &part);
+	if (ret) {
+		error("invalid NAND device");
+		fastboot_fail("invalid NAND device");
+		return ret;
+	}
+
+	ret = board_fastboot_write_partition_setup(part->name);
+	if (ret)
+		return ret;
+
+	fb_nand_sparse_init(&sparse, &sparse_priv, mtd, part);
+	sparse_writer_start(sw, &sparse, cmd);
+
+	return 0;
+}
+#endif
+
 void fb_nand_erase(const char *cmd)
 {
 	struct part_info *part;
@@ -38,10 +38,12 @@
 #include <common.h>
 #include <image-sparse.h>
 #include <div64.h>
+#include <errno.h>
 #include <malloc.h>
 #include <part.h>
 #include <sparse_format.h>
 #include <fastboot.h>
+#include <u-boot/crc.h>
 
 #include <linux/math64.h>
 
@@ -49,40 +51,253 @@
 #define CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE (1024 * 512)
 #endif
 
-void write_sparse_image(
-		struct sparse_storage *info, const char *part_name,
-		void *data, unsigned sz)
+/*
+ * FIXME: Ensure we always set this via Kconfig once all boards select
+ * FASTBOOT there
+ */
+#ifndef CONFIG_FASTBOOT_FLASH_SPARSE_BUF_SIZE
+#define CONFIG_FASTBOOT_FLASH_SPARSE_BUF_SIZE (1024 * 1024)
+#endif
+
+enum sparse_writer_state {
+	SPARSE_FILE_HEADER,
+	SPARSE_CHUNK_HEADER,
+	SPARSE_CHUNK_DATA,
+	SPARSE_DONE,
+	SPARSE_ERROR,
+};
+
+static void sparse_free(struct sparse_writer *sw)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
+	free(sw->buf);
+	free(sw->fill_buf);
+	sw->buf = NULL;
+	sw->fill_buf = NULL;
+}
+
+static int sparse_fail(struct sparse_writer *sw, const char *reason)
+{
+	fastboot_fail(reason);
+	sparse_free(sw);
+	sw->state = SPARSE_ERROR;
+
+	return -EIO;
+}
+
+static void sparse_crc(struct sparse_writer *sw, const void *data,
+		       unsigned int len)
+{
+	if (IS_ENABLED(CONFIG_FASTBOOT_FLASH_SPARSE_CRC))
+		sw->crc = crc32(sw->crc, data, len);
+}
+
+/* Block at which the next RAW data will be written */
+static lbaint_t sparse_next_blk(struct sparse_writer *sw)
+{
+	return sw->blk + sw->buf_len / sw->info->blksz;
+}
+
+static int sparse_check_range(struct sparse_writer *sw, lbaint_t blkcnt)
+{
+	struct sparse_storage *info = sw->info;
+
+	if (sparse_next_blk(sw) + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		return sparse_fail(sw, "Request would exceed partition size!");
+	}
+
+	return 0;
+}
+
+static int sparse_write_blocks(struct sparse_writer *sw, const void *data,
+			       lbaint_t blkcnt)
+{
+	struct sparse_storage *info = sw->info;
 	lbaint_t blks;
-	uint32_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
+
+	blks = info->write(info, sw->blk, blkcnt, data);
+	/* blks might be > blkcnt (eg. NAND bad-blocks) */
+	if (blks < blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Write failed, block #", sw->blk, blks);
+		return sparse_fail(sw, "flash write failure");
+	}
+	sw->blk += blks;
+	sw->bytes_written += blkcnt * info->blksz;
+
+	return 0;
+}
+
+/* Write out the RAW data collected so far */
+static int sparse_flush(struct sparse_writer *sw)
+{
+	int ret;
+
+	if (!sw->buf_len)
+		return 0;
+
+	ret = sparse_write_blocks(sw, sw->buf, sw->buf_len / sw->info->blksz);
+	sw->buf_len = 0;
+
+	return ret;
+}
+
+static int sparse_get_fill_buf(struct sparse_writer *sw, u32 fill_val)
+{
+	struct sparse_storage *info = sw->info;
 	int i;
-	int j;
 
-	fill_buf_num_blks = CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE / info->blksz;
+	if (!sw->fill_buf) {
+		sw->fill_buf_blks = CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE /
+				    info->blksz;
+		if (!sw->fill_buf_blks)
+			sw->fill_buf_blks = 1;
+		sw->fill_buf = memalign(ARCH_DMA_MINALIGN,
+					ROUNDUP(info->blksz * sw->fill_buf_blks,
+						ARCH_DMA_MINALIGN));
+		if (!sw->fill_buf)
+			return sparse_fail(sw,
+					   "Malloc failed for: CHUNK_TYPE_FILL");
+	} else if (sw->fill_buf_val == fill_val) {
+		return 0;
+	}
+
+	for (i = 0; i < info->blksz * sw->fill_buf_blks / sizeof(fill_val);
+	     i++)
+		sw->fill_buf[i] = fill_val;
+	sw->fill_buf_val = fill_val;
+
+	return 0;
+}
+
+static int sparse_write_fill(struct sparse_writer *sw, lbaint_t blkcnt)
+{
+	lbaint_t i, j;
+	int ret;
+
+	for (i = 0; i < blkcnt; i += j) {
+		j = min(blkcnt - i, sw->fill_buf_blks);
+		ret = sparse_write_blocks(sw, sw->fill_buf, j);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Get the part of @blkcnt blocks at the current block which is aligned
+ * to whole erase blocks. Returns the number of blocks in front of it.
+ */
+static lbaint_t sparse_erase_range(struct sparse_writer *sw, lbaint_t blkcnt,
+				   lbaint_t *erase_cnt)
+{
+	struct sparse_storage *info = sw->info;
+	lbaint_t head = 0;
+	u32 rem;
+
+	*erase_cnt = 0;
+	if (!info->erase || !info->erase_blks)
+		return 0;
+
+	div_u64_rem(sw->blk, info->erase_blks, &rem);
+	if (rem)
+		head = info->erase_blks - rem;
+	if (head >= blkcnt)
+		return 0;
+
+	div_u64_rem(blkcnt - head, info->erase_blks, &rem);
+	*erase_cnt = blkcnt - head - rem;
+
+	return head;
+}
+
+static void sparse_crc_fill(struct sparse_writer *sw, lbaint_t blkcnt)
+{
+	lbaint_t i, j;
+
+	if (!IS_ENABLED(CONFIG_FASTBOOT_FLASH_SPARSE_CRC))
+		return;
+
+	for (i = 0; i < blkcnt; i += j) {
+		j = min(blkcnt - i, sw->fill_buf_blks);
+		sparse_crc(sw, sw->fill_buf, j * sw->info->blksz);
+	}
+}
+
+static int sparse_fill(struct sparse_writer *sw, lbaint_t blkcnt)
+{
+	struct sparse_storage *info = sw->info;
+	lbaint_t head, erase_cnt = 0;
+	int ret;
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
+	ret = sparse_get_fill_buf(sw, sw->fill_val);
+	if (ret)
+		return ret;
+	sparse_crc_fill(sw, blkcnt);
 
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+	/* Erased blocks already hold the fill value, erase what we can */
+	if (info->erased_val >= 0 &&
+	    sw->fill_val == (u8)info->erased_val * 0x01010101U) {
+		head = sparse_erase_range(sw, blkcnt, &erase_cnt);
+		if (erase_cnt) {
+			ret = sparse_write_fill(sw, head);
+			if (ret)
+				return ret;
+			if (info->erase(info, sw->blk, erase_cnt) != erase_cnt) {
+				printf("%s: Erase failed, writing instead\n",
+				       __func__);
+				erase_cnt = 0;
+			}
+			sw->blk += erase_cnt;
+			sw->bytes_written += erase_cnt * info->blksz;
+			blkcnt -= head + erase_cnt;
+		}
 	}
 
+	return sparse_write_fill(sw, blkcnt);
+}
+
+static int sparse_dont_care(struct sparse_writer *sw, lbaint_t blkcnt)
+{
+	struct sparse_storage *info = sw->info;
+	int ret;
+
+	/*
+	 * Leave the blocks alone, never erase them: when the host splits
+	 * an image that is larger than our download buffer, the ranges
+	 * written by the other pieces are marked DONT_CARE. The blocks
+	 * count as zero in the image checksum.
+	 */
+	if (IS_ENABLED(CONFIG_FASTBOOT_FLASH_SPARSE_CRC)) {
+		ret = sparse_get_fill_buf(sw, 0);
+		if (ret)
+			return ret;
+		sparse_crc_fill(sw, blkcnt);
+	}
+
+	sw->blk += info->reserve(info, sw->blk, blkcnt);
+
+	return 0;
+}
+
+static void sparse_next_chunk(struct sparse_writer *sw)
+{
+	sw->total_blocks += sw->chunk_header.chunk_sz;
+	sw->chunk++;
+	sw->hdr_len = 0;
+	if (sw->chunk < sw->sparse_header.total_chunks)
+		sw->state = SPARSE_CHUNK_HEADER;
+	else
+		sw->state = SPARSE_DONE;
+}
+
+static int sparse_start_image(struct sparse_writer *sw)
+{
+	sparse_header_t *sparse_header = &sw->sparse_header;
+	struct sparse_storage *info = sw->info;
+	u32 offset;
+
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
 	debug("major_version: 0x%x\n", sparse_header->major_version);
@@ -93,172 +308,312 @@ void write_sparse_image(
 	debug("total_blks: %d\n", sparse_header->total_blks);
 	debug("total_chunks: %d\n", sparse_header->total_chunks);
 
+	if (!is_sparse_image(sparse_header))
+		return sparse_fail(sw, "not a sparse image");
+
+	if (sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_fail(sw, "sparse image header size issue");
+
+	/*
+	 * Skip the remaining bytes in a header that is longer than
+	 * we expected.
+	 */
+	sw->skip = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+
 	/*
 	 * Verify that the sparse block size is a multiple of our
 	 * storage backend block size
 	 */
 	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
-	if (offset) {
+	if (!sparse_header->blk_sz || offset) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
-		fastboot_fail("sparse image block size issue");
-		return;
+		return sparse_fail(sw, "sparse image block size issue");
 	}
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	sw->buf_size = CONFIG_FASTBOOT_FLASH_SPARSE_BUF_SIZE / info->blksz *
+		       info->blksz;
+	if (!sw->buf_size)
+		sw->buf_size = info->blksz;
+	sw->blk = info->start;
+	sw->hdr_len = 0;
+	sw->state = sparse_header->total_chunks ? SPARSE_CHUNK_HEADER :
+						  SPARSE_DONE;
+
+	return 0;
+}
+
+static int sparse_start_chunk(struct sparse_writer *sw)
+{
+	sparse_header_t *sparse_header = &sw->sparse_header;
+	chunk_header_t *chunk_header = &sw->chunk_header;
+	struct sparse_storage *info = sw->info;
+	u64 chunk_data_sz;
+	lbaint_t blkcnt;
+	int ret;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	/*
+	 * Skip the remaining bytes in a header that is longer
+	 * than we expected.
+	 */
+	sw->skip = sparse_header->chunk_hdr_sz - sizeof(chunk_header_t);
+
+	chunk_data_sz = (u64)sparse_header->blk_sz * chunk_header->chunk_sz;
+	blkcnt = lldiv(chunk_data_sz, info->blksz);
+	sw->hdr_len = 0;
+
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz))
+			return sparse_fail(sw,
+					   "Bogus chunk size for chunk type Raw");
+
+		ret = sparse_check_range(sw, blkcnt);
+		if (ret)
+			return ret;
+
+		/* Consecutive RAW chunks are collected into one write */
+		sw->chunk_left = chunk_data_sz;
+		sw->state = SPARSE_CHUNK_DATA;
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
+			return sparse_fail(sw,
+					   "Bogus chunk size for chunk type FILL");
+
+		ret = sparse_flush(sw);
+		if (ret)
+			return ret;
+		ret = sparse_check_range(sw, blkcnt);
+		if (ret)
+			return ret;
+
+		sw->chunk_left = sizeof(uint32_t);
+		sw->state = SPARSE_CHUNK_DATA;
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		ret = sparse_flush(sw);
+		if (ret)
+			return ret;
+		ret = sparse_dont_care(sw, blkcnt);
+		if (ret)
+			return ret;
+		sparse_next_chunk(sw);
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)) &&
+		    chunk_header->total_sz != sparse_header->chunk_hdr_sz)
+			return sparse_fail(sw,
+					   "Bogus chunk size for chunk type CRC32");
+
+		sw->chunk_left = chunk_header->total_sz -
+				 sparse_header->chunk_hdr_sz;
+		sw->state = SPARSE_CHUNK_DATA;
+		if (!sw->chunk_left)
+			sparse_next_chunk(sw);
+		break;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_fail(sw, "Unknown chunk type");
+	}
+
+	return 0;
+}
+
+/* Collect the bytes of a header or a value; returns bytes consumed */
+static unsigned int sparse_collect(struct sparse_writer *sw, void *hdr,
+				   unsigned int size, const u8 *data,
+				   unsigned int len)
+{
+	unsigned int n = min(size - sw->hdr_len, len);
+
+	memcpy(hdr + sw->hdr_len, data, n);
+	sw->hdr_len += n;
+
+	return n;
+}
+
+/* Write the data of a RAW chunk, setting @consumed to the bytes used */
+static int sparse_raw(struct sparse_writer *sw, const u8 *data,
+		      unsigned int len, unsigned int *consumed)
+{
+	struct sparse_storage *info = sw->info;
+	lbaint_t blkcnt;
+	unsigned int n;
+	int ret;
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
+	n = min_t(u64, len, sw->chunk_left);
+	if (!sw->buf_len && n >= sw->buf_size) {
+		/* Large runs are written straight from the input */
+		blkcnt = n / info->blksz;
+		n = blkcnt * info->blksz;
+		sparse_crc(sw, data, n);
+		ret = sparse_write_blocks(sw, data, blkcnt);
+		if (ret)
+			return ret;
+	} else {
+		if (!sw->buf) {
+			sw->buf = memalign(ARCH_DMA_MINALIGN, sw->buf_size);
+			if (!sw->buf)
+				return sparse_fail(sw,
+					"Malloc failed for: CHUNK_TYPE_RAW");
+		}
+		n = min(n, sw->buf_size - sw->buf_len);
+		memcpy(sw->buf + sw->buf_len, data, n);
+		sparse_crc(sw, data, n);
+		sw->buf_len += n;
+		if (sw->buf_len == sw->buf_size) {
+			ret = sparse_flush(sw);
+			if (ret)
+				return ret;
 		}
+	}
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		blkcnt = chunk_data_sz / info->blksz;
-		switch (chunk_header->chunk_type) {
-		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				fastboot_fail(
-					"Bogus chunk size for chunk type Raw");
-				return;
-			}
+	*consumed = n;
+	sw->chunk_left -= n;
+	if (!sw->chunk_left)
+		sparse_next_chunk(sw);
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
+	return 0;
+}
 
-			blks = info->write(info, blk, blkcnt, data);
-			/* blks might be > blkcnt (eg. NAND bad-blocks) */
-			if (blks < blkcnt) {
-				printf("%s: %s" LBAFU " [" LBAFU "]\n",
-				       __func__, "Write failed, block #",
-				       blk, blks);
-				fastboot_fail(
-					      "flash write failure");
-				return;
-			}
-			blk += blks;
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
-
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				fastboot_fail(
-					"Bogus chunk size for chunk type FILL");
-				return;
-			}
+static int sparse_chunk_data(struct sparse_writer *sw, const u8 *data,
+			     unsigned int len, unsigned int *consumed)
+{
+	chunk_header_t *chunk_header = &sw->chunk_header;
+	lbaint_t blkcnt;
+	u32 crc;
+	int ret;
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				fastboot_fail(
-					"Malloc failed for: CHUNK_TYPE_FILL");
-				return;
-			}
+	if (chunk_header->chunk_type == CHUNK_TYPE_RAW)
+		return sparse_raw(sw, data, len, consumed);
 
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
-
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
-
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
+	*consumed = sparse_collect(sw, &sw->fill_val, sizeof(sw->fill_val),
+				   data, len);
+	if (sw->hdr_len < sizeof(sw->fill_val))
+		return 0;
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					fastboot_fail(
-						      "flash write failure");
-					free(fill_buf);
-					return;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_data_sz / sparse_header->blk_sz;
-			free(fill_buf);
-			break;
-
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
-			break;
-
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz) {
-				fastboot_fail(
-					"Bogus chunk size for chunk type Dont Care");
-				return;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
-
-		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			fastboot_fail("Unknown chunk type");
-			return;
+	if (chunk_header->chunk_type == CHUNK_TYPE_FILL) {
+		blkcnt = lldiv((u64)sw->sparse_header.blk_sz *
+			       chunk_header->chunk_sz, sw->info->blksz);
+		ret = sparse_fill(sw, blkcnt);
+		if (ret)
+			return ret;
+	} else if (IS_ENABLED(CONFIG_FASTBOOT_FLASH_SPARSE_CRC)) {
+		crc = sw->fill_val;
+		if (crc != sw->crc) {
+			printf("%s: CRC32 mismatch: %08x != %08x\n", __func__,
+			       crc, sw->crc);
+			return sparse_fail(sw, "sparse image CRC32 mismatch");
+		}
+	}
+	sparse_next_chunk(sw);
+
+	return 0;
+}
+
+void sparse_writer_start(struct sparse_writer *sw,
+			 struct sparse_storage *info, const char *part_name)
+{
+	memset(sw, 0, sizeof(*sw));
+	sw->info = info;
+	sw->part_name = part_name;
+	sw->state = SPARSE_FILE_HEADER;
+}
+
+int sparse_writer_feed(struct sparse_writer *sw, const void *data,
+		       unsigned int len)
+{
+	const u8 *p = data;
+	unsigned int n = 0;
+	int ret = 0;
+
+	while (len && sw->state != SPARSE_DONE && sw->state != SPARSE_ERROR) {
+		if (sw->skip) {
+			n = min(sw->skip, len);
+			sw->skip -= n;
+		} else if (sw->state == SPARSE_FILE_HEADER) {
+			n = sparse_collect(sw, &sw->sparse_header,
+					   sizeof(sparse_header_t), p, len);
+			if (sw->hdr_len == sizeof(sparse_header_t))
+				ret = sparse_start_image(sw);
+		} else if (sw->state == SPARSE_CHUNK_HEADER) {
+			n = sparse_collect(sw, &sw->chunk_header,
+					   sizeof(chunk_header_t), p, len);
+			if (sw->hdr_len == sizeof(chunk_header_t))
+				ret = sparse_start_chunk(sw);
+		} else {
+			ret = sparse_chunk_data(sw, p, len, &n);
 		}
+		if (ret)
+			return ret;
+		p += n;
+		len -= n;
 	}
 
+	return sw->state == SPARSE_ERROR ? -EIO : 0;
+}
+
+int sparse_writer_finish(struct sparse_writer *sw)
+{
+	sparse_header_t *sparse_header = &sw->sparse_header;
+	int ret;
+
+	if (sw->state == SPARSE_ERROR)
+		return -EIO;
+
+	ret = sparse_flush(sw);
+	if (ret)
+		return ret;
+	sparse_free(sw);
+
 	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	      sw->total_blocks, sparse_header->total_blks);
+	printf("........ wrote %llu bytes to '%s'\n", sw->bytes_written,
+	       sw->part_name);
 
-	if (total_blocks != sparse_header->total_blks)
-		fastboot_fail("sparse image write failure");
-	else
-		fastboot_okay("");
+	if (sw->state != SPARSE_DONE ||
+	    sw->total_blocks != sparse_header->total_blks)
+		return sparse_fail(sw, "sparse image write failure");
+
+	if (IS_ENABLED(CONFIG_FASTBOOT_FLASH_SPARSE_CRC) &&
+	    sparse_header->image_checksum &&
+	    sparse_header->image_checksum != sw->crc) {
+		printf("%s: Image checksum mismatch: %08x != %08x\n",
+		       __func__, sparse_header->image_checksum, sw->crc);
+		return sparse_fail(sw, "sparse image checksum mismatch");
+	}
+
+	fastboot_okay("");
+
+	return 0;
+}
+
+void write_sparse_image(
+		struct sparse_storage *info, const char *part_name,
+		void *data, unsigned sz)
+{
+	struct sparse_writer sw;
 
-	return;
+	sparse_writer_start(&sw, info, part_name);
+	sparse_writer_feed(&sw, data, sz);
+	sparse_writer_finish(&sw);
 }
@@ -13,44 +13,181 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
-void *malloc_simple(size_t bytes)
+/*
+ * With CONFIG_SYS_MALLOC_F_FREE each block starts with a header word which
+ * holds the size of the block, including the header, and a flag to say that
+ * it is free. Freeing the top block gives it back to the pool at once, along
+ * with any free blocks below it. Other free blocks are reused by later
+ * requests which fit.
+ */
+#define SIMPLE_HDR	\
+	(IS_ENABLED(CONFIG_SYS_MALLOC_F_FREE) ? sizeof(ulong) : 0)
+#define SIMPLE_FREE	1UL
+
+static ulong *simple_hdr(ulong offset)
 {
-	ulong new_ptr;
-	void *ptr;
+	return map_sysmem(gd->malloc_base + offset, sizeof(ulong));
+}
 
-	new_ptr = gd->malloc_ptr + bytes;
-	debug("%s: size=%zx, ptr=%lx, limit=%lx: ", __func__, bytes, new_ptr,
-	      gd->malloc_limit);
-	if (new_ptr > gd->malloc_limit) {
-		debug("space exhausted\n");
+/* Drop free blocks from the top of the pool and recount the free space */
+static void simple_trim(void)
+{
+	ulong offset, len, top = 0, freed = 0, freed_below = 0;
+
+	for (offset = 0; offset < gd->malloc_ptr; offset += len) {
+		ulong hdr = *simple_hdr(offset);
+
+		len = hdr & ~SIMPLE_FREE;
+		if (hdr & SIMPLE_FREE) {
+			freed += len;
+		} else {
+			top = offset + len;
+			freed_below = freed;
+		}
+	}
+	gd->malloc_ptr = top;
+	gd->malloc_freed = freed_below;
+}
+
+/* Find a free block for a request, merging neighbouring free blocks */
+static void *simple_reuse(size_t bytes)
+{
+	ulong offset, len, size, *hdr, *next;
+
+	size = ALIGN(bytes + SIMPLE_HDR, sizeof(ulong));
+	if (gd->malloc_freed < size)
 		return NULL;
+
+	for (offset = 0; offset < gd->malloc_ptr; offset += len) {
+		hdr = simple_hdr(offset);
+		len = *hdr & ~SIMPLE_FREE;
+		if (!(*hdr & SIMPLE_FREE))
+			continue;
+		while (offset + len < gd->malloc_ptr) {
+			next = simple_hdr(offset + len);
+			if (!(*next & SIMPLE_FREE))
+				break;
+			len += *next & ~SIMPLE_FREE;
+		}
+		*hdr = len | SIMPLE_FREE;
+		if (len < size)
+			continue;
+
+		/* The rest is a multiple of the header size, so can be split */
+		if (len > size)
+			*simple_hdr(offset + size) = (len - size) | SIMPLE_FREE;
+		*hdr = size;
+		gd->malloc_freed -= size;
+		debug("reused %lx\n", gd->malloc_base + offset + SIMPLE_HDR);
+
+		return map_sysmem(gd->malloc_base + offset + SIMPLE_HDR, bytes);
 	}
-	ptr = map_sysmem(gd->malloc_base + gd->malloc_ptr, bytes);
-	gd->malloc_ptr = ALIGN(new_ptr, sizeof(new_ptr));
-	debug("%lx\n", (ulong)ptr);
 
-	return ptr;
+	return NULL;
 }
 
-void *memalign_simple(size_t align, size_t bytes)
+static void *alloc_simple(size_t bytes, size_t align)
 {
-	ulong addr, new_ptr;
+	ulong addr, start, new_ptr;
 	void *ptr;
 
-	addr = ALIGN(gd->malloc_base + gd->malloc_ptr, align);
+	if (IS_ENABLED(CONFIG_SYS_MALLOC_F_FREE) && align == 1) {
+		ptr = simple_reuse(bytes);
+		if (ptr)
+			return ptr;
+	}
+
+	addr = ALIGN(gd->malloc_base + gd->malloc_ptr + SIMPLE_HDR, align);
 	new_ptr = addr + bytes - gd->malloc_base;
 	if (new_ptr > gd->malloc_limit) {
 		debug("space exhausted\n");
 		return NULL;
 	}
+	new_ptr = ALIGN(new_ptr, sizeof(new_ptr));
+
+	if (IS_ENABLED(CONFIG_SYS_MALLOC_F_FREE)) {
+		start = addr - SIMPLE_HDR - gd->malloc_base;
+
+		/* Space skipped for alignment becomes a free block */
+		if (start > gd->malloc_ptr) {
+			*simple_hdr(gd->malloc_ptr) = (start - gd->malloc_ptr) |
+				SIMPLE_FREE;
+			gd->malloc_freed += start - gd->malloc_ptr;
+		}
+		*simple_hdr(start) = new_ptr - start;
+	}
 
 	ptr = map_sysmem(addr, bytes);
-	gd->malloc_ptr = ALIGN(new_ptr, sizeof(new_ptr));
+	gd->malloc_ptr = new_ptr;
+	if (new_ptr > gd->malloc_peak)
+		gd->malloc_peak = new_ptr;
 	debug("%lx\n", (ulong)ptr);
 
 	return ptr;
 }
 
+void *malloc_simple(size_t bytes)
+{
+	debug("%s: size=%zx, ptr=%lx, limit=%lx: ", __func__, bytes,
+	      gd->malloc_ptr, gd->malloc_limit);
+
+	return alloc_simple(bytes, 1);
+}
+
+void *memalign_simple(size_t align, size_t bytes)
+{
+	return alloc_simple(bytes, align);
+}
+
+void free_simple(void *ptr)
+{
+	ulong offset, *hdr;
+
+	if (!IS_ENABLED(CONFIG_SYS_MALLOC_F_FREE) || !ptr)
+		return;
+
+	offset = map_to_sysmem(ptr) - SIMPLE_HDR - gd->malloc_base;
+	if (offset >= gd->malloc_ptr)
+		return;
+	hdr = simple_hdr(offset);
+	if (*hdr & SIMPLE_FREE)
+		return;
+
+	if (offset + *hdr < gd->malloc_ptr) {
+		gd->malloc_freed += *hdr;
+		*hdr |= SIMPLE_FREE;
+	} else {
+		gd->malloc_ptr = offset;
+		if (gd->malloc_freed)
+			simple_trim();
+	}
+	debug("%s: ptr=%lx, freed=%lx\n", __func__, gd->malloc_ptr,
+	      gd->malloc_freed);
+}
+
+ulong malloc_simple_mark(void)
+{
+	return gd->malloc_ptr;
+}
+
+void malloc_simple_release(ulong mark)
+{
+	if (mark >= gd->malloc_ptr)
+		return;
+	gd->malloc_ptr = mark;
+	if (IS_ENABLED(CONFIG_SYS_MALLOC_F_FREE))
+		simple_trim();
+}
+
+void malloc_simple_info(void)
+{
+	printf("Early malloc usage: %lx / %lx, peak %lx", gd->malloc_ptr,
+	       gd->malloc_limit, gd->malloc_peak);
+	if (gd->malloc_freed)
+		printf(", %lx free below top", gd->malloc_freed);
+	printf("\n");
+}
+
 #if CONFIG_IS_ENABLED(SYS_MALLOC_SIMPLE)
 void *calloc(size_t nmemb, size_t elem_size)
 {
@@ -0,0 +1,267 @@
+/*
+ * Size-class slab allocator for small malloc() requests
+ *
+ * Driver model allocates many small objects (devices, uclass and platform
+ * data) and each costs a dlmalloc chunk header, a search of the bins and
+ * some fragmentation when they are freed in a different order. Instead,
+ * small requests are rounded up to one of a few size classes and served
+ * from pages which only hold objects of that class. The rest of the heap
+ * is left to dlmalloc, which handles the large objects.
+ *
+ * The slab region is taken from the top of the malloc() area. It starts
+ * with a table of page descriptors, followed by the pages themselves.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/list.h>
+
+#define SLAB_PAGE_SIZE		4096
+#define SLAB_GRAIN		16	/* All class sizes are a multiple */
+
+static const u16 slab_sizes[] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, MALLOC_SLAB_MAX
+};
+
+#define SLAB_CLASSES		ARRAY_SIZE(slab_sizes)
+
+/**
+ * struct slab_page - descriptor for a page of the slab region
+ *
+ * @list:	Node in the class's list of partly used pages, or in the list
+ *		of free pages. Full pages are in no list.
+ * @free:	First free object which has been used before
+ * @class:	Size class of the objects in this page
+ * @inuse:	Number of objects allocated
+ * @carved:	Number of objects handed out since the page was last free.
+ *		Objects above this have never been used.
+ */
+struct slab_page {
+	struct list_head list;
+	void *free;
+	u16 class;
+	u16 inuse;
+	u16 carved;
+};
+
+/**
+ * struct slab_class - a size class
+ *
+ * @partial:	Pages which have some objects allocated and some free
+ * @objs:	Number of objects in a page
+ * @inuse:	Number of objects allocated
+ * @peak:	Largest number of objects allocated at once
+ * @pages:	Number of pages in use
+ * @allocs:	Number of allocations made
+ * @requested:	Total bytes requested by those allocations
+ */
+struct slab_class {
+	struct list_head partial;
+	uint objs;
+	ulong inuse;
+	ulong peak;
+	ulong pages;
+	ulong allocs;
+	ulong requested;
+};
+
+/**
+ * struct slab_state - state of the slab allocator
+ *
+ * @base:	Address of the first page
+ * @end:	Address just after the last page
+ * @page:	Descriptor for each page
+ * @size:	Bytes taken from the top of the heap, for descriptors and pages
+ * @npages:	Number of pages, 0 if the allocator is not set up
+ * @used_pages:	Number of pages holding objects
+ * @peak_pages:	Largest value of @used_pages
+ * @fallbacks:	Number of small requests passed to dlmalloc since there was
+ *		no free page
+ * @free:	List of free pages
+ * @class:	Size classes
+ * @size_class:	Index into @class, for each request size in SLAB_GRAIN units
+ */
+struct slab_state {
+	ulong base;
+	ulong end;
+	struct slab_page *page;
+	ulong size;
+	uint npages;
+	uint used_pages;
+	uint peak_pages;
+	ulong fallbacks;
+	struct list_head free;
+	struct slab_class class[SLAB_CLASSES];
+	u8 size_class[MALLOC_SLAB_MAX / SLAB_GRAIN + 1];
+};
+
+static struct slab_state slab;
+
+static ulong slab_page_addr(struct slab_page *page)
+{
+	return slab.base + (page - slab.page) * SLAB_PAGE_SIZE;
+}
+
+static struct slab_page *slab_page_of(const void *mem)
+{
+	return &slab.page[((ulong)mem - slab.base) / SLAB_PAGE_SIZE];
+}
+
+ulong malloc_slab_init(ulong end, ulong size)
+{
+	ulong len, top;
+	uint i, class;
+
+	memset(&slab, '\0', sizeof(slab));
+	INIT_LIST_HEAD(&slab.free);
+
+	/* Leave most of the heap to dlmalloc */
+	len = min((ulong)CONFIG_SYS_MALLOC_SLAB_LEN, size / 4);
+	top = end & ~(SLAB_PAGE_SIZE - 1);
+	slab.npages = len / (SLAB_PAGE_SIZE + sizeof(struct slab_page));
+	if (!slab.npages)
+		return 0;
+	slab.end = top;
+	slab.base = top - slab.npages * SLAB_PAGE_SIZE;
+	slab.page = (struct slab_page *)(slab.base -
+					 slab.npages * sizeof(*slab.page));
+	for (i = 0; i < slab.npages; i++)
+		list_add_tail(&slab.page[i].list, &slab.free);
+
+	for (i = 0, class = 0; i < ARRAY_SIZE(slab.size_class); i++) {
+		while (slab_sizes[class] < i * SLAB_GRAIN)
+			class++;
+		slab.size_class[i] = class;
+	}
+	for (i = 0; i < SLAB_CLASSES; i++) {
+		INIT_LIST_HEAD(&slab.class[i].partial);
+		slab.class[i].objs = SLAB_PAGE_SIZE / slab_sizes[i];
+	}
+	debug("using memory %#lx-%#lx for %u slab pages\n", slab.base,
+	      slab.end, slab.npages);
+	slab.size = end - (ulong)slab.page;
+
+	return slab.size;
+}
+
+bool malloc_slab_owns(const void *mem)
+{
+	return (ulong)mem >= slab.base && (ulong)mem < slab.end;
+}
+
+void *malloc_slab_alloc(size_t bytes)
+{
+	struct slab_class *sc;
+	struct slab_page *page;
+	uint class;
+	void *mem;
+
+	if (!slab.npages || bytes > MALLOC_SLAB_MAX)
+		return NULL;
+
+	class = slab.size_class[DIV_ROUND_UP(bytes, SLAB_GRAIN)];
+	sc = &slab.class[class];
+	if (list_empty(&sc->partial)) {
+		if (list_empty(&slab.free)) {
+			slab.fallbacks++;
+			return NULL;
+		}
+		page = list_first_entry(&slab.free, struct slab_page, list);
+		list_move(&page->list, &sc->partial);
+		page->free = NULL;
+		page->class = class;
+		page->carved = 0;
+		sc->pages++;
+		if (++slab.used_pages > slab.peak_pages)
+			slab.peak_pages = slab.used_pages;
+	} else {
+		page = list_first_entry(&sc->partial, struct slab_page, list);
+	}
+
+	if (page->free) {
+		mem = page->free;
+		page->free = *(void **)mem;
+	} else {
+		mem = (void *)(slab_page_addr(page) +
+			       page->carved++ * slab_sizes[class]);
+	}
+	if (++page->inuse == sc->objs)
+		list_del_init(&page->list);
+
+	if (++sc->inuse > sc->peak)
+		sc->peak = sc->inuse;
+	sc->allocs++;
+	sc->requested += bytes;
+
+	return mem;
+}
+
+void malloc_slab_free(void *mem)
+{
+	struct slab_page *page = slab_page_of(mem);
+	struct slab_class *sc = &slab.class[page->class];
+
+	/* A full page has room again */
+	if (page->inuse == sc->objs)
+		list_add(&page->list, &sc->partial);
+
+	*(void **)mem = page->free;
+	page->free = mem;
+	sc->inuse--;
+	if (!--page->inuse) {
+		list_move(&page->list, &slab.free);
+		sc->pages--;
+		slab.used_pages--;
+	}
+}
+
+size_t malloc_slab_usable_size(const void *mem)
+{
+	return slab_sizes[slab_page_of(mem)->class];
+}
+
+ulong malloc_slab_size(void)
+{
+	return slab.size;
+}
+
+ulong malloc_slab_inuse(void)
+{
+	ulong total = 0;
+	uint i;
+
+	for (i = 0; i < SLAB_CLASSES; i++)
+		total += slab.class[i].inuse * slab_sizes[i];
+
+	return total;
+}
+
+void malloc_slab_print_stats(void)
+{
+	ulong inuse = malloc_slab_inuse();
+	ulong held = slab.used_pages * SLAB_PAGE_SIZE;
+	uint i;
+
+	printf("slab pages       = %10u of %u, peak %u (%u bytes each)\n",
+	       slab.used_pages, slab.npages, slab.peak_pages, SLAB_PAGE_SIZE);
+	printf("slab in use      = %10lu bytes, %lu bytes spare in pages\n",
+	       inuse, held - inuse);
+	printf("slab fallbacks   = %10lu\n", slab.fallbacks);
+	if (!slab.peak_pages)
+		return;
+
+	/* Waste is the rounding up of requests to the class size */
+	printf("  size   objects      peak  pages    allocs  waste\n");
+	for (i = 0; i < SLAB_CLASSES; i++) {
+		struct slab_class *sc = &slab.class[i];
+
+		if (!sc->allocs)
+			continue;
+		printf("  %4u %9lu %9lu %6lu %9lu  %4lu%%\n", slab_sizes[i],
+		       sc->inuse, sc->peak, sc->pages, sc->allocs,
+		       100 - sc->requested /
+		       DIV_ROUND_UP(sc->allocs * slab_sizes[i], 100));
+	}
+}
@@ -186,6 +186,8 @@ int spl_init(void)
 #endif
 	gd->malloc_limit = CONFIG_SYS_MALLOC_F_LEN;
 	gd->malloc_ptr = 0;
+	gd->malloc_peak = 0;
+	gd->malloc_freed = 0;
 #endif
 	if (CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)) {
 		ret = fdtdec_setup();
@@ -332,8 +334,8 @@ void board_init_r(gd_t *dummy1, ulong dummy2)
 		debug("Unsupported OS image.. Jumping nevertheless..\n");
 	}
 #if defined(CONFIG_SYS_MALLOC_F_LEN) && !defined(CONFIG_SYS_SPL_MALLOC_SIZE)
-	debug("SPL malloc() used %#lx bytes (%ld KB)\n", gd->malloc_ptr,
-	      gd->malloc_ptr / 1024);
+	debug("SPL malloc() used %#lx bytes (%ld KB), peak %#lx\n",
+	      gd->malloc_ptr, gd->malloc_ptr / 1024, gd->malloc_peak);
 #endif
 
 	debug("loaded - jumping to U-Boot...\n");
@@ -391,6 +393,8 @@ ulong spl_relocate_stack_gd(void)
 		gd->malloc_base = ptr;
 		gd->malloc_limit = CONFIG_SPL_STACK_R_MALLOC_SIMPLE_LEN;
 		gd->malloc_ptr = 0;
+		gd->malloc_peak = 0;
+		gd->malloc_freed = 0;
 	}
 #endif
 	/* Get stack position: use 8-byte alignment for ABI compliance */
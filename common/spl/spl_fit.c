@@ -11,6 +11,27 @@
 #include <libfdt.h>
 #include <spl.h>
 
+/* The most images SPL loads from one FIT: firmware, FDT and loadables */
+#define SPL_FIT_MAX_IMAGES	8
+
+/**
+ * struct spl_fit_image - an image which SPL loads from a FIT
+ *
+ * @name:	Image node name, for debugging
+ * @id:		Bootstage ID to mark once the image is in place. SPL has no
+ *		bootstage records, so this only reaches show_boot_progress()
+ * @offset:	Offset of the image data from the start of the FIT
+ * @size:	Size of the image data in bytes
+ * @dst:	Where the image data must end up
+ */
+struct spl_fit_image {
+	const char *name;
+	enum bootstage_id id;
+	ulong offset;
+	ulong size;
+	void *dst;
+};
+
 static ulong fdt_getprop_u32(const void *fdt, int node, const char *prop)
 {
 	const u32 *cell;
@@ -22,13 +43,12 @@ static ulong fdt_getprop_u32(const void *fdt, int node, const char *prop)
 	return fdt32_to_cpu(*cell);
 }
 
-static int spl_fit_select_fdt(const void *fdt, int images, int *fdt_offsetp)
+static int spl_fit_select_config(const void *fdt)
 {
-	const char *name, *fdt_name;
-	int conf, node, fdt_node;
+	const char *name;
+	int conf, node;
 	int len;
 
-	*fdt_offsetp = 0;
 	conf = fdt_path_offset(fdt, FIT_CONFS_PATH);
 	if (conf < 0) {
 		debug("%s: Cannot find /configurations node: %d\n", __func__,
@@ -49,27 +69,9 @@ static int spl_fit_select_fdt(const void *fdt, int images, int *fdt_offsetp)
 		if (board_fit_config_name_match(name))
 			continue;
 
-		debug("Selecting config '%s'", name);
-		fdt_name = fdt_getprop(fdt, node, FIT_FDT_PROP, &len);
-		if (!fdt_name) {
-			debug("%s: Cannot find fdt name property: %d\n",
-			      __func__, len);
-			return -EINVAL;
-		}
-
-		debug(", fdt '%s'\n", fdt_name);
-		fdt_node = fdt_subnode_offset(fdt, images, fdt_name);
-		if (fdt_node < 0) {
-			debug("%s: Cannot find fdt node '%s': %d\n",
-			      __func__, fdt_name, fdt_node);
-			return -EINVAL;
-		}
-
-		*fdt_offsetp = fdt_getprop_u32(fdt, fdt_node, "data-offset");
-		len = fdt_getprop_u32(fdt, fdt_node, "data-size");
 		debug("FIT: Selected '%s'\n", name);
 
-		return len;
+		return node;
 	}
 
 #ifdef CONFIG_SPL_LIBCOMMON_SUPPORT
@@ -85,6 +87,49 @@ static int spl_fit_select_fdt(const void *fdt, int images, int *fdt_offsetp)
 	return -ENOENT;
 }
 
+static int spl_fit_get_image_node(const void *fit, int images, int conf,
+				  const char *prop, int index)
+{
+	const char *name;
+	int node;
+
+	name = fdt_stringlist_get(fit, conf, prop, index, NULL);
+	if (!name)
+		return -ENOENT;
+
+	node = fdt_subnode_offset(fit, images, name);
+	if (node < 0)
+		debug("%s: Cannot find %s node '%s': %d\n", __func__, prop,
+		      name, node);
+
+	return node;
+}
+
+static int spl_fit_get_image_data(const void *fit, int node, int base_offset,
+				  struct spl_fit_image *img)
+{
+	ulong offset, size;
+
+	/* 'data-position' is absolute, 'data-offset' follows the FIT itself */
+	offset = fdt_getprop_u32(fit, node, FIT_DATA_POSITION_PROP);
+	if (offset == -1U) {
+		offset = fdt_getprop_u32(fit, node, FIT_DATA_OFFSET_PROP);
+		if (offset == -1U)
+			return -ENOENT;
+		offset += base_offset;
+	}
+	size = fdt_getprop_u32(fit, node, FIT_DATA_SIZE_PROP);
+	if (size == -1U)
+		return -ENOENT;
+
+	img->name = fdt_get_name(fit, node, NULL);
+	img->offset = offset;
+	img->size = size;
+	debug("%s: data_offset=%lx, data_size=%lx\n", img->name, offset, size);
+
+	return 0;
+}
+
 static int get_aligned_image_offset(struct spl_load_info *info, int offset)
 {
 	/*
@@ -123,19 +168,85 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return (data_size + info->bl_len - 1) / info->bl_len;
 }
 
+/*
+ * Check whether the read which places @prev can place @img as well. That
+ * needs the two to have the same layout in memory as in the FIT, with no
+ * more than a part block of padding between them.
+ */
+static bool spl_fit_same_read(struct spl_load_info *info,
+			      const struct spl_fit_image *prev,
+			      const struct spl_fit_image *img)
+{
+	ulong prev_end = prev->offset + prev->size;
+	ulong gap = info->filename ? ARCH_DMA_MINALIGN : info->bl_len;
+
+	if (img->offset < prev_end || img->offset - prev_end >= gap)
+		return false;
+
+	return img->dst - prev->dst == img->offset - prev->offset;
+}
+
+/*
+ * Read the images @first to @last - 1, which share one read, into place.
+ * Since we can only read whole blocks, the data may start part way into
+ * the first block. Nothing below the load address belongs to us, so in
+ * that case, or if the load address is not aligned for DMA, use the
+ * memory from the next aligned address up as a scratch buffer and move
+ * the data down afterwards.
+ */
+static int spl_fit_read(struct spl_load_info *info, ulong sector,
+			struct spl_fit_image *first, struct spl_fit_image *last)
+{
+	ulong offset = first->offset;
+	ulong size = last[-1].offset + last[-1].size - offset;
+	int overhead = get_aligned_image_overhead(info, offset);
+	int sectors = get_aligned_image_size(info, size, offset);
+	int src_sector = sector + get_aligned_image_offset(info, offset);
+	void *dst = first->dst;
+	unsigned long count;
+
+	if (overhead || (ulong)dst & (ARCH_DMA_MINALIGN - 1))
+		dst = (void *)ALIGN((ulong)first->dst, ARCH_DMA_MINALIGN);
+
+	count = info->read(info, src_sector, sectors, dst);
+	debug("%s: dst=%p, src_sector=%x, sectors=%x, images=%d\n", __func__,
+	      dst, src_sector, sectors, (int)(last - first));
+	if (count != sectors)
+		return -EIO;
+
+	if (dst + overhead != first->dst)
+		memmove(first->dst, dst + overhead, size);
+
+	return 0;
+}
+
+/* Sort the images by load address, which is the order we place them in */
+static void spl_fit_sort_images(struct spl_fit_image *img, int count)
+{
+	struct spl_fit_image tmp;
+	int i, j;
+
+	for (i = 1; i < count; i++) {
+		tmp = img[i];
+		for (j = i; j > 0 && img[j - 1].dst > tmp.dst; j--)
+			img[j] = img[j - 1];
+		img[j] = tmp;
+	}
+}
+
 int spl_load_simple_fit(struct spl_image_info *spl_image,
 			struct spl_load_info *info, ulong sector, void *fit)
 {
+	struct spl_fit_image img[SPL_FIT_MAX_IMAGES];
+	struct spl_fit_image *fw, *fdt, *end;
+	const char *name;
 	int sectors;
 	ulong size, load;
 	unsigned long count;
-	int node, images;
-	void *load_ptr;
-	int fdt_offset, fdt_len;
-	int data_offset, data_size;
+	int node, images, conf;
 	int base_offset, align_len = ARCH_DMA_MINALIGN - 1;
-	int src_sector;
-	void *dst, *src;
+	int count_img, i, j, ret;
+	bool merge = true;
 
 	/*
 	 * Figure out where the external images start. This is the base for the
@@ -167,91 +278,125 @@ int spl_load_simple_fit(struct spl_image_info *spl_image,
 	      sector, sectors, fit, count);
 	if (count == 0)
 		return -EIO;
+	/* Without bootstage in SPL, the marks just call show_boot_progress() */
+	bootstage_mark_name(BOOTSTAGE_ID_SPL_FIT_HEADER, "spl_fit_header");
 
-	/* find the firmware image to load */
 	images = fdt_path_offset(fit, FIT_IMAGES_PATH);
 	if (images < 0) {
 		debug("%s: Cannot find /images node: %d\n", __func__, images);
 		return -1;
 	}
-	node = fdt_first_subnode(fit, images);
+
+	/* Figure out which configuration, and so device tree, to use */
+	conf = spl_fit_select_config(fit);
+	if (conf < 0)
+		return conf;
+
+	/*
+	 * Find the firmware image to load. Older FITs do not name it in the
+	 * configuration, so fall back to the first image.
+	 */
+	node = spl_fit_get_image_node(fit, images, conf, FIT_FIRMWARE_PROP, 0);
+	if (node == -ENOENT)
+		node = fdt_first_subnode(fit, images);
 	if (node < 0) {
-		debug("%s: Cannot find first image node: %d\n", __func__, node);
+		debug("%s: Cannot find firmware image node: %d\n", __func__,
+		      node);
 		return -1;
 	}
 
 	/* Get its information and set up the spl_image structure */
-	data_offset = fdt_getprop_u32(fit, node, "data-offset");
-	data_size = fdt_getprop_u32(fit, node, "data-size");
-	load = fdt_getprop_u32(fit, node, "load");
-	debug("data_offset=%x, data_size=%x\n", data_offset, data_size);
+	fw = &img[0];
+	if (spl_fit_get_image_data(fit, node, base_offset, fw))
+		return -EINVAL;
+	load = fdt_getprop_u32(fit, node, FIT_LOAD_PROP);
 	spl_image->load_addr = load;
 	spl_image->entry_point = load;
 	spl_image->os = IH_OS_U_BOOT;
+	fw->id = BOOTSTAGE_ID_SPL_FIT_FIRMWARE;
+	fw->dst = (void *)load;
 
-	/*
-	 * Work out where to place the image. We read it so that the first
-	 * byte will be at 'load'. This may mean we need to load it starting
-	 * before then, since we can only read whole blocks.
-	 */
-	data_offset += base_offset;
-	sectors = get_aligned_image_size(info, data_size, data_offset);
-	load_ptr = (void *)load;
-	debug("U-Boot size %x, data %p\n", data_size, load_ptr);
-	dst = load_ptr;
-
-	/* Read the image */
-	src_sector = sector + get_aligned_image_offset(info, data_offset);
-	debug("Aligned image read: dst=%p, src_sector=%x, sectors=%x\n",
-	      dst, src_sector, sectors);
-	count = info->read(info, src_sector, sectors, dst);
-	if (count != sectors)
-		return -EIO;
-	debug("image: dst=%p, data_offset=%x, size=%x\n", dst, data_offset,
-	      data_size);
-	src = dst + get_aligned_image_overhead(info, data_offset);
+	/* The device tree goes immediately after the image */
+	node = spl_fit_get_image_node(fit, images, conf, FIT_FDT_PROP, 0);
+	if (node < 0)
+		return -EINVAL;
+	fdt = &img[1];
+	if (spl_fit_get_image_data(fit, node, base_offset, fdt))
+		return -EINVAL;
+	fdt->id = BOOTSTAGE_ID_SPL_FIT_FDT;
+	fdt->dst = fw->dst + fw->size;
+
+	/* Anything else the configuration wants goes to its own address */
+	for (count_img = 2, i = 0; ; i++) {
+		node = spl_fit_get_image_node(fit, images, conf,
+					      FIT_LOADABLE_PROP, i);
+		if (node == -ENOENT)
+			break;
+		if (node < 0)
+			return -EINVAL;
+		name = fdt_get_name(fit, node, NULL);
+		if (!strcmp(name, fw->name) || !strcmp(name, fdt->name))
+			continue;
+		if (count_img == SPL_FIT_MAX_IMAGES) {
+			debug("%s: Too many loadables\n", __func__);
+			return -E2BIG;
+		}
+		load = fdt_getprop_u32(fit, node, FIT_LOAD_PROP);
+		if (load == -1U ||
+		    spl_fit_get_image_data(fit, node, base_offset,
+					   &img[count_img])) {
+			debug("%s: Cannot load '%s'\n", __func__, name);
+			return -EINVAL;
+		}
+		img[count_img].id = BOOTSTAGE_ID_ALLOC;
+		img[count_img++].dst = (void *)load;
+	}
 
 #ifdef CONFIG_SPL_FIT_IMAGE_POST_PROCESS
-	board_fit_image_post_process((void **)&src, (size_t *)&data_size);
-#endif
-
-	memcpy(dst, src, data_size);
-
-	/* Figure out which device tree the board wants to use */
-	fdt_len = spl_fit_select_fdt(fit, images, &fdt_offset);
-	if (fdt_len < 0)
-		return fdt_len;
-
 	/*
-	 * Read the device tree and place it after the image. There may be
-	 * some extra data before it since we can only read entire blocks.
-	 * And also align the destination address to ARCH_DMA_MINALIGN.
+	 * The device tree follows the image as post-processing leaves it, so
+	 * we only know where it goes once the image is processed.
 	 */
-	dst = (void *)((load + data_size + align_len) & ~align_len);
-	fdt_offset += base_offset;
-	sectors = get_aligned_image_size(info, fdt_len, fdt_offset);
-	src_sector = sector + get_aligned_image_offset(info, fdt_offset);
-	count = info->read(info, src_sector, sectors, dst);
-	debug("Aligned fdt read: dst %p, src_sector = %x, sectors %x\n",
-	      dst, src_sector, sectors);
-	if (count != sectors)
-		return -EIO;
+	merge = false;
+#endif
 
 	/*
-	 * Copy the device tree so that it starts immediately after the image.
-	 * After this we will have the U-Boot image and its device tree ready
-	 * for us to start.
+	 * Now place the images in order of load address, which means the
+	 * part block and scratch space read after an image only overwrite
+	 * memory which is yet to be filled. Images which keep their FIT
+	 * layout in memory, typically U-Boot and its device tree, are placed
+	 * by a single read.
 	 */
-	debug("fdt: dst=%p, data_offset=%x, size=%x\n", dst, fdt_offset,
-	      fdt_len);
-	src = dst + get_aligned_image_overhead(info, fdt_offset);
-	dst = load_ptr + data_size;
+	spl_fit_sort_images(img, count_img);
+	for (i = 0; i < count_img; i = j) {
+		for (j = i + 1; j < count_img; j++) {
+			if (!merge || !spl_fit_same_read(info, &img[j - 1],
+							 &img[j]))
+				break;
+		}
+		ret = spl_fit_read(info, sector, &img[i], &img[j]);
+		if (ret)
+			return ret;
 
+		for (end = &img[i]; end < &img[j]; end++) {
 #ifdef CONFIG_SPL_FIT_IMAGE_POST_PROCESS
-	board_fit_image_post_process((void **)&src, (size_t *)&fdt_len);
+			void *src = end->dst;
+			size_t len = end->size;
+
+			board_fit_image_post_process(&src, &len);
+			end->size = len;
+			if (src != end->dst)
+				memmove(end->dst, src, end->size);
+			if (end->id == BOOTSTAGE_ID_SPL_FIT_FIRMWARE) {
+				for (fdt = img; fdt < img + count_img; fdt++) {
+					if (fdt->id == BOOTSTAGE_ID_SPL_FIT_FDT)
+						fdt->dst = end->dst + end->size;
+				}
+			}
 #endif
-
-	memcpy(dst, src, fdt_len);
+			bootstage_mark_name(end->id, end->name);
+		}
+	}
 
 	return 0;
 }
@@ -13,6 +13,7 @@
 #include <spi.h>
 #include <spi_flash.h>
 #include <errno.h>
+#include <mapmem.h>
 #include <spl.h>
 
 #ifdef CONFIG_SPL_OS_BOOT
@@ -61,6 +62,30 @@ static ulong spl_spi_fit_read(struct spl_load_info *load, ulong sector,
 	else
 		return 0;
 }
+
+/*
+ * Check whether the image at @offs is linked to run from the controller's
+ * memory-mapped window. If so there is nothing to copy: leave the
+ * controller in memory-mapped mode so that the image can execute in place.
+ */
+static bool spl_spi_image_in_place(struct spi_flash *flash, u32 offs,
+				   struct spl_image_info *spl_image)
+{
+	struct spi_slave *spi = flash->spi;
+
+	if (!flash->memory_map ||
+	    spl_image->load_addr != map_to_sysmem(flash->memory_map + offs))
+		return false;
+
+	if (spi_claim_bus(spi))
+		return false;
+	spi_xfer(spi, 0, NULL, NULL, SPI_XFER_MMAP);
+	debug("%s: executing in place at %lx\n", __func__,
+	      spl_image->load_addr);
+
+	return true;
+}
+
 /*
  * The main entry for SPI booting. It's necessary that SDRAM is already
  * configured and available since this code loads the main U-Boot image
@@ -119,6 +144,10 @@ static int spl_spi_load_image(struct spl_image_info *spl_image,
 			err = spl_parse_image_header(spl_image, header);
 			if (err)
 				return err;
+			if (spl_spi_image_in_place(flash,
+						   CONFIG_SYS_SPI_U_BOOT_OFFS,
+						   spl_image))
+				return 0;
 			err = spi_flash_read(flash, CONFIG_SYS_SPI_U_BOOT_OFFS,
 					     spl_image->size,
 					     (void *)spl_image->load_addr);
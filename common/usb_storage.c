@@ -35,6 +35,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <div64.h>
 #include <dm.h>
 #include <errno.h>
 #include <inttypes.h>
@@ -42,6 +43,7 @@
 #include <memalign.h>
 #include <asm/byteorder.h>
 #include <asm/processor.h>
+#include <asm/unaligned.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 
@@ -58,11 +60,15 @@
 static const unsigned char us_direction[256/8] = {
 	0x28, 0x81, 0x14, 0x14, 0x20, 0x01, 0x90, 0x77,
 	0x0C, 0x20, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01,
+	0x00, 0x01, 0x00, 0x40, 0x00, 0x01, 0x00, 0x01,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
 #define US_DIRECTION(x) ((us_direction[x>>3] >> (x & 7)) & 1)
 
+/* SCSI_READ16 in scsi.h is an AHCI driver internal code, not the opcode */
+#define US_SCSI_READ16		0x88
+#define US_SCSI_WRITE16		0x8a
+
 static ccb usb_ccb __attribute__((aligned(ARCH_DMA_MINALIGN)));
 static __u32 CBWTag;
 
@@ -81,6 +87,7 @@ struct us_data {
 
 	unsigned int	flags;			/* from filter initially */
 #	define USB_READY	(1 << 0)
+#	define USB_CMD16	(1 << 1)	/* needs 16 byte CDBs */
 	unsigned char	ifnum;			/* interface number */
 	unsigned char	ep_in;			/* in endpoint */
 	unsigned char	ep_out;			/* out ....... */
@@ -98,6 +105,13 @@ struct us_data {
 	ccb		*srb;			/* current srb */
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
+	size_t		max_xfer_size;		/* per bulk transfer, or 0 */
+
+	/* totals for the throughput shown by "usb storage" */
+	u64		read_bytes;
+	u64		read_us;
+	u64		write_bytes;
+	u64		write_us;
 };
 
 #ifdef CONFIG_USB_EHCI
@@ -111,6 +125,15 @@ struct us_data {
 #define USB_MAX_XFER_BLK	20
 #endif
 
+/* Blocks one READ(10)/WRITE(10) command can transfer */
+#define USB_MAX_XFER_BLK10	65535
+
+/*
+ * Bytes moved by one command of any size, so that it completes well within
+ * USB_TIMEOUT_MS and the host controller needs no huge descriptor list
+ */
+#define USB_MAX_XFER_BYTES	(32 << 20)
+
 #ifndef CONFIG_BLK
 static struct us_data usb_stor[USB_MAX_STOR_DEV];
 #endif
@@ -141,6 +164,23 @@ static void usb_show_progress(void)
 	debug(".");
 }
 
+static void usb_stor_show_rate(struct usb_device *udev)
+{
+	struct us_data *ss = udev ? udev->privptr : NULL;
+
+	if (!ss)
+		return;
+
+	if (ss->read_us)
+		printf("            Read: %llu KiB at %llu KiB/s\n",
+		       ss->read_bytes >> 10,
+		       lldiv((ss->read_bytes >> 10) * 1000000, ss->read_us));
+	if (ss->write_us)
+		printf("            Written: %llu KiB at %llu KiB/s\n",
+		       ss->write_bytes >> 10,
+		       lldiv((ss->write_bytes >> 10) * 1000000, ss->write_us));
+}
+
 /*******************************************************************************
  * show info on storage devices; 'usb start/init' must be invoked earlier
  * as we only retrieve structures populated during devices initialization
@@ -158,6 +198,7 @@ int usb_stor_info(void)
 
 		printf("  Device %d: ", desc->devnum);
 		dev_print(desc);
+		usb_stor_show_rate(dev_get_parent_priv(dev_get_parent(dev)));
 		count++;
 	}
 #else
@@ -167,6 +208,7 @@ int usb_stor_info(void)
 		for (i = 0; i < usb_max_devs; i++) {
 			printf("  Device %d: ", i);
 			dev_print(&usb_dev_desc[i]);
+			usb_stor_show_rate(usb_dev_desc[i].priv);
 		}
 		return 0;
 	}
@@ -1043,6 +1085,27 @@ static int usb_read_capacity(ccb *srb, struct us_data *ss)
 	return -1;
 }
 
+#ifdef CONFIG_SYS_64BIT_LBA
+static int usb_read_capacity16(ccb *srb, struct us_data *ss)
+{
+	int retry;
+	/* XXX retries */
+	retry = 3;
+	do {
+		memset(&srb->cmd[0], 0, 16);
+		srb->cmd[0] = SCSI_RD_CAPAC16;
+		srb->cmd[1] = 0x10;	/* service action */
+		srb->cmd[13] = 32;	/* allocation length */
+		srb->datalen = 32;
+		srb->cmdlen = 16;
+		if (ss->transport(srb, ss) == USB_STOR_TRANSPORT_GOOD)
+			return 0;
+	} while (retry--);
+
+	return -1;
+}
+#endif
+
 static int usb_read_10(ccb *srb, struct us_data *ss, unsigned long start,
 		       unsigned short blocks)
 {
@@ -1077,6 +1140,53 @@ static int usb_write_10(ccb *srb, struct us_data *ss, unsigned long start,
 	return ss->transport(srb, ss);
 }
 
+/* READ(16)/WRITE(16), for devices with more than 2^32 blocks */
+static int usb_rw_16(ccb *srb, struct us_data *ss, unsigned char opcode,
+		     lbaint_t start, lbaint_t blocks)
+{
+	memset(&srb->cmd[0], 0, 16);
+	srb->cmd[0] = opcode;
+	put_unaligned_be64(start, &srb->cmd[2]);
+	put_unaligned_be32(blocks, &srb->cmd[10]);
+	srb->cmdlen = 16;
+	debug("rw16: op %x start " LBAF " blocks " LBAF "\n", opcode, start,
+	      blocks);
+	return ss->transport(srb, ss);
+}
+
+static int usb_stor_rw(ccb *srb, struct us_data *ss, bool write,
+		       lbaint_t start, lbaint_t blocks)
+{
+	if (ss->flags & USB_CMD16)
+		return usb_rw_16(srb, ss, write ? US_SCSI_WRITE16 :
+				 US_SCSI_READ16, start, blocks);
+	if (write)
+		return usb_write_10(srb, ss, start, blocks);
+
+	return usb_read_10(srb, ss, start, blocks);
+}
+
+/*
+ * Blocks moved by one command: as many as the host controller takes in one
+ * bulk transfer, as far as the command can express it, up to
+ * USB_MAX_XFER_BYTES.
+ */
+static lbaint_t usb_stor_max_xfer_blk(struct us_data *ss,
+				      struct blk_desc *block_dev)
+{
+	lbaint_t blks;
+
+	if (!ss->max_xfer_size)
+		return USB_MAX_XFER_BLK;
+
+	blks = min_t(size_t, ss->max_xfer_size, USB_MAX_XFER_BYTES) /
+		block_dev->blksz;
+	if (!(ss->flags & USB_CMD16))
+		blks = min_t(lbaint_t, blks, USB_MAX_XFER_BLK10);
+
+	return max_t(lbaint_t, blks, 1);
+}
+
 
 #ifdef CONFIG_USB_BIN_FIXUP
 /*
@@ -1109,11 +1219,11 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 				   lbaint_t blkcnt, void *buffer)
 #endif
 {
-	lbaint_t start, blks;
+	lbaint_t start, blks, smallblks, max_blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
 	struct usb_device *udev;
 	struct us_data *ss;
+	unsigned long time_us;
 	int retry;
 	ccb *srb = &usb_ccb;
 #ifdef CONFIG_BLK
@@ -1142,6 +1252,8 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 	buf_addr = (uintptr_t)buffer;
 	start = blknr;
 	blks = blkcnt;
+	max_blks = usb_stor_max_xfer_blk(ss, block_dev);
+	time_us = timer_get_us();
 
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF " buffer %"
 	      PRIxPTR "\n", block_dev->devnum, start, blks, buf_addr);
@@ -1150,35 +1262,40 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > max_blks)
+			smallblks = max_blks;
 		else
-			smallblks = (unsigned short) blks;
+			smallblks = blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == max_blks)
 			usb_show_progress();
 		srb->datalen = block_dev->blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (usb_read_10(srb, ss, start, smallblks)) {
+		if (usb_stor_rw(srb, ss, false, start, smallblks)) {
 			debug("Read ERROR\n");
+			ss->flags &= ~USB_READY;
 			usb_request_sense(srb, ss);
 			if (retry--)
 				goto retry_it;
 			blkcnt -= blks;
 			break;
 		}
+		/* the device is known to be ready, skip the CBW delay */
+		ss->flags |= USB_READY;
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
 	} while (blks != 0);
-	ss->flags &= ~USB_READY;
+
+	ss->read_us += timer_get_us() - time_us;
+	ss->read_bytes += (u64)blkcnt * block_dev->blksz;
 
 	debug("usb_read: end startblk " LBAF
-	      ", blccnt %x buffer %" PRIxPTR "\n",
+	      ", blccnt " LBAF " buffer %" PRIxPTR "\n",
 	      start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= max_blks)
 		debug("\n");
 	return blkcnt;
 }
@@ -1191,11 +1308,11 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 				    lbaint_t blkcnt, const void *buffer)
 #endif
 {
-	lbaint_t start, blks;
+	lbaint_t start, blks, smallblks, max_blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
 	struct usb_device *udev;
 	struct us_data *ss;
+	unsigned long time_us;
 	int retry;
 	ccb *srb = &usb_ccb;
 #ifdef CONFIG_BLK
@@ -1226,6 +1343,8 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 	buf_addr = (uintptr_t)buffer;
 	start = blknr;
 	blks = blkcnt;
+	max_blks = usb_stor_max_xfer_blk(ss, block_dev);
+	time_us = timer_get_us();
 
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF " buffer %"
 	      PRIxPTR "\n", block_dev->devnum, start, blks, buf_addr);
@@ -1236,34 +1355,39 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 		 */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > max_blks)
+			smallblks = max_blks;
 		else
-			smallblks = (unsigned short) blks;
+			smallblks = blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == max_blks)
 			usb_show_progress();
 		srb->datalen = block_dev->blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (usb_write_10(srb, ss, start, smallblks)) {
+		if (usb_stor_rw(srb, ss, true, start, smallblks)) {
 			debug("Write ERROR\n");
+			ss->flags &= ~USB_READY;
 			usb_request_sense(srb, ss);
 			if (retry--)
 				goto retry_it;
 			blkcnt -= blks;
 			break;
 		}
+		/* the device is known to be ready, skip the CBW delay */
+		ss->flags |= USB_READY;
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
 	} while (blks != 0);
-	ss->flags &= ~USB_READY;
 
-	debug("usb_write: end startblk " LBAF ", blccnt %x buffer %"
+	ss->write_us += timer_get_us() - time_us;
+	ss->write_bytes += (u64)blkcnt * block_dev->blksz;
+
+	debug("usb_write: end startblk " LBAF ", blccnt " LBAF " buffer %"
 	      PRIxPTR "\n", start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= max_blks)
 		debug("\n");
 	return blkcnt;
 
@@ -1375,6 +1499,10 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		printf("Sorry, protocol %d not yet supported.\n", ss->subclass);
 		return 0;
 	}
+#ifdef CONFIG_DM_USB
+	if (usb_get_max_xfer_size(dev, &ss->max_xfer_size))
+		ss->max_xfer_size = 0;
+#endif
 	if (ss->ep_int) {
 		/* we had found an interrupt endpoint, prepare irq pipe
 		 * set up the IRQ pipe and handler
@@ -1394,7 +1522,8 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 	unsigned char perq, modi;
 	ALLOC_CACHE_ALIGN_BUFFER(u32, cap, 2);
 	ALLOC_CACHE_ALIGN_BUFFER(u8, usb_stor_buf, 36);
-	u32 capacity, blksz;
+	lbaint_t capacity;
+	u32 blksz;
 	ccb *pccb = &usb_ccb;
 
 	pccb->pdata = usb_stor_buf;
@@ -1463,10 +1592,26 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 	cap[1] = cpu_to_be32(cap[1]);
 #endif
 
-	capacity = be32_to_cpu(cap[0]) + 1;
+	capacity = (lbaint_t)be32_to_cpu(cap[0]) + 1;
 	blksz = be32_to_cpu(cap[1]);
 
-	debug("Capacity = 0x%08x, blocksz = 0x%08x\n", capacity, blksz);
+#ifdef CONFIG_SYS_64BIT_LBA
+	/* too large for READ CAPACITY(10), and for READ(10) too */
+	if (be32_to_cpu(cap[0]) == 0xffffffff) {
+		ALLOC_CACHE_ALIGN_BUFFER(u8, cap16, 32);
+
+		pccb->pdata = cap16;
+		memset(cap16, 0, 32);
+		if (usb_read_capacity16(pccb, ss) == 0) {
+			capacity = get_unaligned_be64(cap16) + 1;
+			blksz = get_unaligned_be32(cap16 + 8);
+			ss->flags |= USB_CMD16;
+		}
+		ss->flags &= ~USB_READY;
+	}
+#endif
+
+	debug("Capacity = " LBAF ", blocksz = 0x%08x\n", capacity, blksz);
 	dev_desc->lba = capacity;
 	dev_desc->blksz = blksz;
 	dev_desc->log2blksz = LOG2(dev_desc->blksz);
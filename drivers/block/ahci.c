@@ -45,6 +45,9 @@ u16 *ataid[AHCI_MAX_PORTS];
 #define WAIT_MS_FLUSH	5000
 #define WAIT_MS_LINKUP	200
 
+/* Length of a host to device register FIS, in bytes */
+#define AHCI_CMD_FIS_LEN	20
+
 __weak void __iomem *ahci_port_base(void __iomem *base, u32 port)
 {
 	return base + 0x100 + (port * 0x80);
@@ -86,14 +89,24 @@ static void ahci_dcache_invalidate_range(unsigned long begin, unsigned long len)
 	invalidate_dcache_range(start, end);
 }
 
+/*
+ * Each command slot has its own command table, laid out one after the other
+ * starting with the slot 0 table at pp->cmd_tbl.
+ */
+static ulong ahci_slot_tbl(struct ahci_ioports *pp, int slot)
+{
+	return pp->cmd_tbl + slot * AHCI_CMD_TBL_SZ;
+}
+
 /*
  * Ensure data for SATA controller is flushed out of dcache and
  * written to physical memory.
  */
-static void ahci_dcache_flush_sata_cmd(struct ahci_ioports *pp)
+static void ahci_dcache_flush_sata_cmd(struct ahci_ioports *pp, int slot)
 {
 	ahci_dcache_flush_range((unsigned long)pp->cmd_slot,
-				AHCI_PORT_PRIV_DMA_SZ);
+				AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT);
+	ahci_dcache_flush_range(ahci_slot_tbl(pp, slot), AHCI_CMD_TBL_SZ);
 }
 
 static int waiting_for_cmd_completed(void __iomem *offset,
@@ -187,7 +200,7 @@ static int ahci_host_init(struct ahci_probe_ent *probe_ent)
 	debug("ahci_host_init: start\n");
 
 	cap_save = readl(mmio + HOST_CAP);
-	cap_save &= ((1 << 28) | (1 << 17));
+	cap_save &= ((1 << 28) | (1 << 17) | HOST_CAP_NCQ | HOST_CAP_NCS_MASK);
 	cap_save |= (1 << 27);  /* Staggered Spin-up. Not needed. */
 
 	ret = ahci_reset(probe_ent->mmio_base);
@@ -500,13 +513,14 @@ static int ahci_init_one(pci_dev_t dev)
 
 #define MAX_DATA_BYTE_COUNT  (4*1024*1024)
 
-static int ahci_fill_sg(u8 port, unsigned char *buf, int buf_len)
+static int ahci_fill_sg(u8 port, int slot, unsigned char *buf, int buf_len)
 {
 	struct ahci_ioports *pp = &(probe_ent->port[port]);
-	struct ahci_sg *ahci_sg = pp->cmd_tbl_sg;
+	struct ahci_sg *ahci_sg;
 	u32 sg_count;
 	int i;
 
+	ahci_sg = (struct ahci_sg *)(ahci_slot_tbl(pp, slot) + AHCI_CMD_TBL_HDR);
 	sg_count = ((buf_len - 1) / MAX_DATA_BYTE_COUNT) + 1;
 	if (sg_count > AHCI_MAX_SG) {
 		printf("Error:Too much sg!\n");
@@ -514,9 +528,10 @@ static int ahci_fill_sg(u8 port, unsigned char *buf, int buf_len)
 	}
 
 	for (i = 0; i < sg_count; i++) {
-		ahci_sg->addr =
-		    cpu_to_le32((unsigned long) buf + i * MAX_DATA_BYTE_COUNT);
-		ahci_sg->addr_hi = 0;
+		ulong addr = (ulong)buf + i * MAX_DATA_BYTE_COUNT;
+
+		ahci_sg->addr = cpu_to_le32(lower_32_bits(addr));
+		ahci_sg->addr_hi = cpu_to_le32(upper_32_bits(addr));
 		ahci_sg->flags_size = cpu_to_le32(0x3fffff &
 					  (buf_len < MAX_DATA_BYTE_COUNT
 					   ? (buf_len - 1)
@@ -529,15 +544,15 @@ static int ahci_fill_sg(u8 port, unsigned char *buf, int buf_len)
 }
 
 
-static void ahci_fill_cmd_slot(struct ahci_ioports *pp, u32 opts)
+static void ahci_fill_cmd_slot(struct ahci_ioports *pp, int slot, u32 opts)
 {
-	pp->cmd_slot->opts = cpu_to_le32(opts);
-	pp->cmd_slot->status = 0;
-	pp->cmd_slot->tbl_addr = cpu_to_le32((u32)pp->cmd_tbl & 0xffffffff);
-#ifdef CONFIG_PHYS_64BIT
-	pp->cmd_slot->tbl_addr_hi =
-	    cpu_to_le32((u32)(((pp->cmd_tbl) >> 16) >> 16));
-#endif
+	struct ahci_cmd_hdr *cmd_slot = pp->cmd_slot + slot;
+	ulong cmd_tbl = ahci_slot_tbl(pp, slot);
+
+	cmd_slot->opts = cpu_to_le32(opts);
+	cmd_slot->status = 0;
+	cmd_slot->tbl_addr = cpu_to_le32(lower_32_bits(cmd_tbl));
+	cmd_slot->tbl_addr_hi = cpu_to_le32(upper_32_bits(cmd_tbl));
 }
 
 static int wait_spinup(void __iomem *port_mmio)
@@ -570,16 +585,13 @@ static int ahci_port_start(u8 port)
 		return -1;
 	}
 
-	mem = malloc(AHCI_PORT_PRIV_DMA_SZ + 2048);
+	/* Aligned to 2048-bytes */
+	mem = memalign(2048, AHCI_PORT_PRIV_NCQ_DMA_SZ);
 	if (!mem) {
-		free(pp);
 		printf("%s: No mem for table!\n", __func__);
 		return -ENOMEM;
 	}
-
-	/* Aligned to 2048-bytes */
-	mem = memalign(2048, AHCI_PORT_PRIV_DMA_SZ);
-	memset(mem, 0, AHCI_PORT_PRIV_DMA_SZ);
+	memset(mem, 0, AHCI_PORT_PRIV_NCQ_DMA_SZ);
 
 	/*
 	 * First item in chunk of DMA memory: 32-slot command table,
@@ -588,7 +600,7 @@ static int ahci_port_start(u8 port)
 	pp->cmd_slot =
 		(struct ahci_cmd_hdr *)(uintptr_t)virt_to_phys((void *)mem);
 	debug("cmd_slot = %p\n", pp->cmd_slot);
-	mem += (AHCI_CMD_SLOT_SZ + 224);
+	mem += AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT;
 
 	/*
 	 * Second item: Received-FIS area
@@ -597,8 +609,8 @@ static int ahci_port_start(u8 port)
 	mem += AHCI_RX_FIS_SZ;
 
 	/*
-	 * Third item: data area for storing a single command
-	 * and its scatter-gather table
+	 * Third item: data area for storing one command and its
+	 * scatter-gather table per slot
 	 */
 	pp->cmd_tbl = virt_to_phys((void *)mem);
 	debug("cmd_tbl_dma = %lx\n", pp->cmd_tbl);
@@ -607,10 +619,14 @@ static int ahci_port_start(u8 port)
 	pp->cmd_tbl_sg =
 			(struct ahci_sg *)(uintptr_t)virt_to_phys((void *)mem);
 
-	writel_with_flush((unsigned long)pp->cmd_slot,
+	writel_with_flush(lower_32_bits((ulong)pp->cmd_slot),
 			  port_mmio + PORT_LST_ADDR);
+	writel_with_flush(upper_32_bits((ulong)pp->cmd_slot),
+			  port_mmio + PORT_LST_ADDR_HI);
 
-	writel_with_flush(pp->rx_fis, port_mmio + PORT_FIS_ADDR);
+	writel_with_flush(lower_32_bits(pp->rx_fis), port_mmio + PORT_FIS_ADDR);
+	writel_with_flush(upper_32_bits(pp->rx_fis),
+			  port_mmio + PORT_FIS_ADDR_HI);
 
 #ifdef CONFIG_SUNXI_AHCI
 	sunxi_dma_init(port_mmio);
@@ -655,11 +671,11 @@ static int ahci_device_data_io(u8 port, u8 *fis, int fis_len, u8 *buf,
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, fis_len);
 
-	sg_count = ahci_fill_sg(port, buf, buf_len);
+	sg_count = ahci_fill_sg(port, 0, buf, buf_len);
 	opts = (fis_len >> 2) | (sg_count << 16) | (is_write << 6);
-	ahci_fill_cmd_slot(pp, opts);
+	ahci_fill_cmd_slot(pp, 0, opts);
 
-	ahci_dcache_flush_sata_cmd(pp);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	ahci_dcache_flush_range((unsigned long)buf, (unsigned long)buf_len);
 
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
@@ -739,6 +755,18 @@ static int ata_scsiop_inquiry(ccb *pccb)
 	memcpy(idbuf, tmpid, ATA_ID_WORDS * 2);
 	ata_swap_buf_le16(idbuf, ATA_ID_WORDS);
 
+	/* Use queued commands if both the HBA and the device support them */
+	probe_ent->port[port].ncq_depth = 0;
+	if ((probe_ent->cap & HOST_CAP_NCQ) && ata_id_has_ncq(idbuf)) {
+		u32 slots = ((probe_ent->cap & HOST_CAP_NCS_MASK) >>
+			     HOST_CAP_NCS_SHIFT) + 1;
+
+		probe_ent->port[port].ncq_depth =
+			min_t(u32, slots, ata_id_queue_depth(idbuf));
+		debug("scsi_ahci: port %d NCQ depth %d\n", port,
+		      probe_ent->port[port].ncq_depth);
+	}
+
 	memcpy(&pccb->pdata[8], "ATA     ", 8);
 	ata_id_strcpy((u16 *)&pccb->pdata[16], &idbuf[ATA_ID_PROD], 16);
 	ata_id_strcpy((u16 *)&pccb->pdata[32], &idbuf[ATA_ID_FW_REV], 4);
@@ -750,6 +778,141 @@ static int ata_scsiop_inquiry(ccb *pccb)
 }
 
 
+/*
+ * Stop and restart the port DMA engine. This is the only way to clear
+ * PORT_CMD_ISSUE and PORT_SCR_ACT after a failed queued command.
+ */
+static int ahci_port_restart(void __iomem *port_mmio)
+{
+	u32 tmp;
+
+	tmp = readl(port_mmio + PORT_CMD);
+	writel_with_flush(tmp & ~PORT_CMD_START, port_mmio + PORT_CMD);
+	if (waiting_for_cmd_completed(port_mmio + PORT_CMD, 500,
+				      PORT_CMD_LIST_ON))
+		return -ETIMEDOUT;
+
+	writel(readl(port_mmio + PORT_SCR_ERR), port_mmio + PORT_SCR_ERR);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+	writel_with_flush(tmp | PORT_CMD_START, port_mmio + PORT_CMD);
+
+	return 0;
+}
+
+/*
+ * Queue one READ/WRITE FPDMA QUEUED command in the given slot. The tag
+ * is the slot number.
+ */
+static int ahci_ncq_issue(u8 port, int slot, lbaint_t lba, u16 blocks,
+			  u8 *buf, u8 is_write)
+{
+	struct ahci_ioports *pp = &(probe_ent->port[port]);
+	void __iomem *port_mmio = pp->port_mmio;
+	u8 *fis = (u8 *)ahci_slot_tbl(pp, slot);
+	int sg_count;
+
+	memset(fis, 0, AHCI_CMD_FIS_LEN);
+	fis[0] = 0x27;		/* Host to device FIS. */
+	fis[1] = 1 << 7;	/* Command FIS. */
+	fis[2] = is_write ? ATA_CMD_FPDMA_WRITE : ATA_CMD_FPDMA_READ;
+	fis[3] = (blocks >> 0) & 0xff;	/* count lives in the features */
+	fis[11] = (blocks >> 8) & 0xff;
+	fis[4] = (lba >> 0) & 0xff;
+	fis[5] = (lba >> 8) & 0xff;
+	fis[6] = (lba >> 16) & 0xff;
+	fis[7] = 1 << 6;	/* device reg: set LBA mode */
+	fis[8] = (lba >> 24) & 0xff;
+#ifdef CONFIG_SYS_64BIT_LBA
+	fis[9] = (lba >> 32) & 0xff;
+	fis[10] = (lba >> 40) & 0xff;
+#endif
+	fis[12] = slot << 3;	/* tag */
+
+	sg_count = ahci_fill_sg(port, slot, buf, blocks * ATA_SECT_SIZE);
+	if (sg_count < 0)
+		return -EINVAL;
+	ahci_fill_cmd_slot(pp, slot, (AHCI_CMD_FIS_LEN >> 2) |
+			   (sg_count << 16) | (is_write ? AHCI_CMD_WRITE : 0));
+	ahci_dcache_flush_sata_cmd(pp, slot);
+
+	/* SActive must be set before the command is issued */
+	writel(1 << slot, port_mmio + PORT_SCR_ACT);
+	writel_with_flush(1 << slot, port_mmio + PORT_CMD_ISSUE);
+
+	return 0;
+}
+
+/*
+ * Transfer a range of blocks with native command queuing. The range is
+ * split into MAX_SATA_BLOCKS_READ_WRITE sized commands and up to
+ * pp->ncq_depth of them are kept outstanding; as soon as one completes its
+ * slot is reused for the next part of the range, so the device always has
+ * work queued.
+ */
+static int ahci_ncq_read_write(u8 port, lbaint_t lba, u32 blocks, u8 *buf,
+			       u8 is_write)
+{
+	struct ahci_ioports *pp = &(probe_ent->port[port]);
+	void __iomem *port_mmio = pp->port_mmio;
+	u32 slot_mask = (pp->ncq_depth == 32) ? ~0U : (1U << pp->ncq_depth) - 1;
+	unsigned long len = (unsigned long)blocks * ATA_SECT_SIZE;
+	u8 *start_buf = buf;
+	u32 busy = 0;
+	ulong start;
+	int ret = 0;
+
+	ahci_dcache_flush_range((unsigned long)buf, len);
+
+	while (blocks || busy) {
+		u32 done, irq;
+
+		while (blocks && (~busy & slot_mask)) {
+			int slot = ffs(~busy & slot_mask) - 1;
+			u16 now_blocks = min_t(u32, MAX_SATA_BLOCKS_READ_WRITE,
+					       blocks);
+
+			ret = ahci_ncq_issue(port, slot, lba, now_blocks, buf,
+					     is_write);
+			if (ret)
+				goto err;
+			busy |= 1 << slot;
+			buf += now_blocks * ATA_SECT_SIZE;
+			lba += now_blocks;
+			blocks -= now_blocks;
+		}
+
+		start = get_timer(0);
+		do {
+			irq = readl(port_mmio + PORT_IRQ_STAT);
+			if (irq & (PORT_IRQ_FATAL)) {
+				printf("scsi_ahci: NCQ error on port %d, status %#x, tfd %#x\n",
+				       port, irq, readl(port_mmio + PORT_TFDATA));
+				ret = -EIO;
+				goto err;
+			}
+			done = busy & ~(readl(port_mmio + PORT_SCR_ACT) |
+					readl(port_mmio + PORT_CMD_ISSUE));
+		} while (!done && get_timer(start) < WAIT_MS_DATAIO);
+
+		if (!done) {
+			printf("scsi_ahci: NCQ timeout on port %d\n", port);
+			ret = -ETIMEDOUT;
+			goto err;
+		}
+		writel(irq, port_mmio + PORT_IRQ_STAT);
+		busy &= ~done;
+	}
+
+	if (!is_write)
+		ahci_dcache_invalidate_range((unsigned long)start_buf, len);
+
+	return 0;
+
+err:
+	ahci_port_restart(port_mmio);
+	return ret;
+}
+
 /*
  * SCSI READ10/WRITE10 command operation.
  */
@@ -790,6 +953,20 @@ static int ata_scsiop_read_write(ccb *pccb, u8 is_write)
 	debug("scsi_ahci: %s %u blocks starting from lba 0x" LBAFU "\n",
 	      is_write ?  "write" : "read", blocks, lba);
 
+	if (probe_ent->port[pccb->target].ncq_depth) {
+		if (ATA_SECT_SIZE * blocks > user_buffer_size) {
+			printf("scsi_ahci: Error: buffer too small.\n");
+			return -EIO;
+		}
+		if (ahci_ncq_read_write(pccb->target, lba, blocks,
+					user_buffer, is_write))
+			return -EIO;
+		/* One flush covers every queued write */
+		if (is_write)
+			return ata_io_flush(pccb->target);
+		return 0;
+	}
+
 	/* Preset the FIS */
 	memset(fis, 0, sizeof(fis));
 	fis[0] = 0x27;		 /* Host to device FIS. */
@@ -930,6 +1107,10 @@ int scsi_exec(ccb *pccb)
 {
 	int ret;
 
+	/* No controller has been set up */
+	if (!probe_ent)
+		return false;
+
 	switch (pccb->cmd[0]) {
 	case SCSI_READ16:
 	case SCSI_READ10:
@@ -1074,8 +1255,8 @@ static int ata_io_flush(u8 port)
 	fis[2] = ATA_CMD_FLUSH_EXT;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, 20);
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
-	ahci_dcache_flush_sata_cmd(pp);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
 
 	if (waiting_for_cmd_completed(port_mmio + PORT_CMD_ISSUE,
@@ -0,0 +1,434 @@
+/*
+ * Emulated AHCI controller with one port and a disk held in RAM
+ *
+ * The controller is driven through sandbox's memory-mapped I/O hooks, so
+ * the real AHCI driver can be tested against it. Queued (NCQ) commands are
+ * accepted at once but only complete one at a time, highest tag first,
+ * each time SActive is read. This keeps several commands outstanding and
+ * completes them out of order, as a real device may.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <ahci.h>
+#include <libata.h>
+#include <malloc.h>
+#include <asm/io.h>
+#include <asm/test.h>
+
+#define SANDBOX_AHCI_PORT	0x100
+#define SANDBOX_AHCI_SIZE	(SANDBOX_AHCI_PORT + 0x80)
+
+/* Device status after a command, with and without an error */
+#define SANDBOX_AHCI_TF_OK	ATA_DRDY
+#define SANDBOX_AHCI_TF_ERR	(ATA_ABORTED << 8 | ATA_DRDY | ATA_ERR)
+
+/**
+ * struct sandbox_ahci - state of the emulated controller
+ *
+ * @disk:	Disk contents
+ * @blocks:	Size of the disk in blocks
+ * @depth:	NCQ queue depth of the disk, 0 if it has no NCQ
+ * @fail_lba:	Fail the next command which touches this block
+ * @fail:	true if @fail_lba is set
+ * @cap:	HOST_CAP register
+ * @ctl:	HOST_CTL register
+ * @irq:	HOST_IRQ_STAT register
+ * @clb:	Command list address
+ * @fb:		Received FIS address
+ * @is:		PORT_IRQ_STAT register
+ * @ie:		PORT_IRQ_MASK register
+ * @cmd:	PORT_CMD register
+ * @tfd:	PORT_TFDATA register
+ * @serr:	PORT_SCR_ERR register
+ * @sact:	PORT_SCR_ACT register
+ * @ci:		PORT_CMD_ISSUE register
+ * @pending:	Queued commands which have been issued but not completed
+ * @stats:	What the controller has seen
+ */
+struct sandbox_ahci {
+	u8 *disk;
+	ulong blocks;
+	uint depth;
+	ulong fail_lba;
+	bool fail;
+	u32 cap;
+	u32 ctl;
+	u32 irq;
+	u64 clb;
+	u64 fb;
+	u32 is;
+	u32 ie;
+	u32 cmd;
+	u32 tfd;
+	u32 serr;
+	u32 sact;
+	u32 ci;
+	u32 pending;
+	struct sandbox_ahci_stats stats;
+};
+
+static void *sandbox_ahci_dma(u32 lo, u32 hi)
+{
+	return (void *)(uintptr_t)((u64)hi << 32 | lo);
+}
+
+static void sandbox_ahci_port_reset(struct sandbox_ahci *priv)
+{
+	priv->cmd = 0;
+	priv->is = 0;
+	priv->sact = 0;
+	priv->ci = 0;
+	priv->pending = 0;
+	priv->tfd = SANDBOX_AHCI_TF_OK;
+}
+
+static void sandbox_ahci_put_string(u16 *id, const char *str, int words)
+{
+	char *dst = (char *)id;
+	int i;
+
+	/* Each word holds two characters, first one in the high byte */
+	for (i = 0; i < words * 2; i++)
+		dst[i ^ 1] = *str ? *str++ : ' ';
+}
+
+static void sandbox_ahci_identify(struct sandbox_ahci *priv, u16 *id)
+{
+	ulong lba28 = min(priv->blocks, 0x0fffffffUL);
+
+	memset(id, '\0', ATA_ID_WORDS * 2);
+	sandbox_ahci_put_string(id + ATA_ID_SERNO, "0123456789", 10);
+	sandbox_ahci_put_string(id + ATA_ID_FW_REV, "1.0", 4);
+	sandbox_ahci_put_string(id + ATA_ID_PROD, "sandbox ahci disk", 20);
+	id[49] = 1 << 9;			/* LBA */
+	id[ATA_ID_LBA_SECTORS] = lba28 & 0xffff;
+	id[ATA_ID_LBA_SECTORS + 1] = lba28 >> 16;
+	id[83] = 0x4000 | 1 << 10;		/* LBA48 */
+	id[ATA_ID_LBA48_SECTORS] = priv->blocks & 0xffff;
+	id[ATA_ID_LBA48_SECTORS + 1] = (priv->blocks >> 16) & 0xffff;
+	if (priv->depth) {
+		id[75] = priv->depth - 1;
+		id[76] = 1 << 8;		/* NCQ */
+	}
+}
+
+/* Copy data between a buffer and the memory described by a PRD table */
+static int sandbox_ahci_xfer(struct ahci_sg *sg, int prdtl, u8 *data,
+			     ulong len, bool to_host)
+{
+	for (; len && prdtl; sg++, prdtl--) {
+		ulong now = min(len, (ulong)(le32_to_cpu(sg->flags_size) &
+					     0x3fffff) + 1);
+		u8 *mem = sandbox_ahci_dma(le32_to_cpu(sg->addr),
+					   le32_to_cpu(sg->addr_hi));
+
+		if (to_host)
+			memcpy(mem, data, now);
+		else
+			memcpy(data, mem, now);
+		data += now;
+		len -= now;
+	}
+
+	return len ? -EINVAL : 0;
+}
+
+/* Run the command in a slot, returning -ve if the device reports an error */
+static int sandbox_ahci_exec(struct sandbox_ahci *priv, int slot)
+{
+	struct ahci_cmd_hdr *hdr = sandbox_ahci_dma(priv->clb,
+						    priv->clb >> 32);
+	u8 *fis, *data;
+	struct ahci_sg *sg;
+	lbaint_t lba;
+	ulong count;
+	bool write;
+	int prdtl;
+	u16 id[ATA_ID_WORDS];
+
+	hdr += slot;
+	fis = sandbox_ahci_dma(le32_to_cpu(hdr->tbl_addr),
+			       le32_to_cpu(hdr->tbl_addr_hi));
+	sg = (struct ahci_sg *)(fis + AHCI_CMD_TBL_HDR);
+	prdtl = le32_to_cpu(hdr->opts) >> 16;
+
+	lba = fis[4] | fis[5] << 8 | fis[6] << 16 | (lbaint_t)fis[8] << 24;
+#ifdef CONFIG_SYS_64BIT_LBA
+	lba |= (lbaint_t)fis[9] << 32 | (lbaint_t)fis[10] << 40;
+#endif
+	switch (fis[2]) {
+	case ATA_CMD_ID_ATA:
+		priv->stats.unqueued++;
+		sandbox_ahci_identify(priv, id);
+		return sandbox_ahci_xfer(sg, prdtl, (u8 *)id, sizeof(id),
+					 true);
+	case ATA_CMD_FLUSH_EXT:
+		priv->stats.unqueued++;
+		priv->stats.flushes++;
+		return 0;
+	case ATA_CMD_READ_EXT:
+	case ATA_CMD_WRITE_EXT:
+		priv->stats.unqueued++;
+		write = fis[2] == ATA_CMD_WRITE_EXT;
+		count = fis[12] | fis[13] << 8;
+		break;
+	case ATA_CMD_FPDMA_READ:
+	case ATA_CMD_FPDMA_WRITE:
+		priv->stats.queued++;
+		write = fis[2] == ATA_CMD_FPDMA_WRITE;
+		count = fis[3] | fis[11] << 8;
+		if ((fis[12] >> 3) != slot)
+			return -EINVAL;
+		break;
+	default:
+		return -ENOSYS;
+	}
+
+	if (!count)
+		count = 0x10000;
+	if (lba + count > priv->blocks)
+		return -EINVAL;
+	if (priv->fail && priv->fail_lba >= lba &&
+	    priv->fail_lba < lba + count) {
+		priv->fail = false;
+		priv->stats.errors++;
+		return -EIO;
+	}
+	data = priv->disk + lba * ATA_SECT_SIZE;
+
+	return sandbox_ahci_xfer(sg, prdtl, data, count * ATA_SECT_SIZE,
+				 !write);
+}
+
+static void sandbox_ahci_error(struct sandbox_ahci *priv)
+{
+	priv->tfd = SANDBOX_AHCI_TF_ERR;
+	priv->is |= PORT_IRQ_TF_ERR;
+	priv->irq |= 1;
+}
+
+static bool sandbox_ahci_queued(struct sandbox_ahci *priv, int slot)
+{
+	struct ahci_cmd_hdr *hdr = sandbox_ahci_dma(priv->clb,
+						    priv->clb >> 32);
+	u8 *fis;
+
+	hdr += slot;
+	fis = sandbox_ahci_dma(le32_to_cpu(hdr->tbl_addr),
+			       le32_to_cpu(hdr->tbl_addr_hi));
+
+	return fis[2] == ATA_CMD_FPDMA_READ || fis[2] == ATA_CMD_FPDMA_WRITE;
+}
+
+static void sandbox_ahci_issue(struct sandbox_ahci *priv, u32 slots)
+{
+	int slot;
+
+	if (!(priv->cmd & PORT_CMD_START))
+		return;
+
+	while (slots) {
+		slot = ffs(slots) - 1;
+		slots &= ~(1 << slot);
+
+		/* The device accepts a queued command and runs it later */
+		if (sandbox_ahci_queued(priv, slot)) {
+			uint active;
+
+			priv->pending |= 1 << slot;
+			active = hweight32(priv->pending);
+			if (active > priv->stats.max_active)
+				priv->stats.max_active = active;
+			continue;
+		}
+		if (sandbox_ahci_exec(priv, slot))
+			sandbox_ahci_error(priv);
+		else
+			priv->is |= PORT_IRQ_D2H_REG_FIS;
+	}
+}
+
+/* Complete the outstanding queued command with the highest tag */
+static void sandbox_ahci_complete(struct sandbox_ahci *priv)
+{
+	int slot;
+
+	if (!priv->pending || (priv->tfd & ATA_ERR))
+		return;
+
+	slot = fls(priv->pending) - 1;
+	if (sandbox_ahci_exec(priv, slot)) {
+		sandbox_ahci_error(priv);
+		return;
+	}
+	priv->pending &= ~(1 << slot);
+	priv->sact &= ~(1 << slot);
+	priv->is |= PORT_IRQ_SDB_FIS;
+}
+
+static uint sandbox_ahci_read(void *ctx, ulong offset, int size)
+{
+	struct sandbox_ahci *priv = ctx;
+	u32 cmd;
+
+	switch (offset) {
+	case HOST_CAP:
+		return priv->cap;
+	case HOST_CTL:
+		return priv->ctl;
+	case HOST_IRQ_STAT:
+		return priv->irq;
+	case HOST_PORTS_IMPL:
+		return 1;
+	case HOST_VERSION:
+		return 0x10300;
+	case SANDBOX_AHCI_PORT + PORT_LST_ADDR:
+		return priv->clb;
+	case SANDBOX_AHCI_PORT + PORT_LST_ADDR_HI:
+		return priv->clb >> 32;
+	case SANDBOX_AHCI_PORT + PORT_FIS_ADDR:
+		return priv->fb;
+	case SANDBOX_AHCI_PORT + PORT_FIS_ADDR_HI:
+		return priv->fb >> 32;
+	case SANDBOX_AHCI_PORT + PORT_IRQ_STAT:
+		return priv->is;
+	case SANDBOX_AHCI_PORT + PORT_IRQ_MASK:
+		return priv->ie;
+	case SANDBOX_AHCI_PORT + PORT_CMD:
+		/* The engines run while they are enabled */
+		cmd = priv->cmd;
+		if (cmd & PORT_CMD_START)
+			cmd |= PORT_CMD_LIST_ON;
+		if (cmd & PORT_CMD_FIS_RX)
+			cmd |= PORT_CMD_FIS_ON;
+		return cmd;
+	case SANDBOX_AHCI_PORT + PORT_TFDATA:
+		return priv->tfd;
+	case SANDBOX_AHCI_PORT + PORT_SIG:
+		return 0x101;
+	case SANDBOX_AHCI_PORT + PORT_SCR_STAT:
+		return 0x123;	/* Gen 2 link up, device present */
+	case SANDBOX_AHCI_PORT + PORT_SCR_ERR:
+		return priv->serr;
+	case SANDBOX_AHCI_PORT + PORT_SCR_ACT:
+		sandbox_ahci_complete(priv);
+		return priv->sact;
+	case SANDBOX_AHCI_PORT + PORT_CMD_ISSUE:
+		return priv->ci;
+	}
+
+	return 0;
+}
+
+static void sandbox_ahci_write(void *ctx, ulong offset, uint val, int size)
+{
+	struct sandbox_ahci *priv = ctx;
+
+	switch (offset) {
+	case HOST_CAP:
+		priv->cap = val;
+		break;
+	case HOST_CTL:
+		if (val & HOST_RESET) {
+			priv->ctl = 0;
+			priv->irq = 0;
+			sandbox_ahci_port_reset(priv);
+		} else {
+			priv->ctl = val;
+		}
+		break;
+	case HOST_IRQ_STAT:
+		priv->irq &= ~val;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_LST_ADDR:
+		priv->clb = (priv->clb & ~0xffffffffULL) | val;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_LST_ADDR_HI:
+		priv->clb = (priv->clb & 0xffffffff) | (u64)val << 32;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_FIS_ADDR:
+		priv->fb = (priv->fb & ~0xffffffffULL) | val;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_FIS_ADDR_HI:
+		priv->fb = (priv->fb & 0xffffffff) | (u64)val << 32;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_IRQ_STAT:
+		priv->is &= ~val;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_IRQ_MASK:
+		priv->ie = val;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_CMD:
+		/* Stopping the port drops all commands and clears errors */
+		if (!(val & PORT_CMD_START)) {
+			priv->sact = 0;
+			priv->ci = 0;
+			priv->pending = 0;
+			priv->tfd = SANDBOX_AHCI_TF_OK;
+		}
+		priv->cmd = val & ~(PORT_CMD_LIST_ON | PORT_CMD_FIS_ON);
+		break;
+	case SANDBOX_AHCI_PORT + PORT_SCR_ERR:
+		priv->serr &= ~val;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_SCR_ACT:
+		priv->sact |= val;
+		break;
+	case SANDBOX_AHCI_PORT + PORT_CMD_ISSUE:
+		/* Commands are fetched from the list as soon as they arrive */
+		sandbox_ahci_issue(priv, val & ~priv->ci);
+		break;
+	}
+}
+
+static const struct sandbox_mmio_ops sandbox_ahci_ops = {
+	.read	= sandbox_ahci_read,
+	.write	= sandbox_ahci_write,
+};
+
+void *sandbox_ahci_add(u8 *disk, ulong blocks, uint depth)
+{
+	struct sandbox_ahci *priv;
+
+	priv = calloc(1, sizeof(*priv));
+	if (!priv)
+		return NULL;
+	priv->disk = disk;
+	priv->blocks = blocks;
+	priv->depth = depth;
+	priv->cap = HOST_CAP_NCQ | (31 << HOST_CAP_NCS_SHIFT);
+	sandbox_ahci_port_reset(priv);
+
+	/* The registers sit at the address of the state, which is unique */
+	if (sandbox_mmio_add(priv, SANDBOX_AHCI_SIZE, &sandbox_ahci_ops,
+			     priv)) {
+		free(priv);
+		return NULL;
+	}
+
+	return priv;
+}
+
+void sandbox_ahci_remove(void *mmio)
+{
+	sandbox_mmio_remove(mmio);
+	free(mmio);
+}
+
+void sandbox_ahci_fail_lba(void *mmio, ulong lba)
+{
+	struct sandbox_ahci *priv = mmio;
+
+	priv->fail_lba = lba;
+	priv->fail = true;
+}
+
+void sandbox_ahci_get_stats(void *mmio, struct sandbox_ahci_stats *stats)
+{
+	struct sandbox_ahci *priv = mmio;
+
+	*stats = priv->stats;
+	memset(&priv->stats, '\0', sizeof(priv->stats));
+}
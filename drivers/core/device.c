@@ -268,6 +268,7 @@ int device_probe(struct udevice *dev)
 {
 	const struct driver *drv;
 	int size = 0;
+	int span = -1;
 	int ret;
 	int seq;
 
@@ -335,6 +336,8 @@ int device_probe(struct udevice *dev)
 	dev->seq = seq;
 
 	dev->flags |= DM_FLAG_ACTIVATED;
+	/* Only first probes get a span, active devices returned above */
+	span = bootstage_span_begin(dev->name);
 
 	/*
 	 * Process pinctrl for everything except the root device, and
@@ -375,6 +378,7 @@ int device_probe(struct udevice *dev)
 
 	if (dev->parent && device_get_uclass_id(dev) == UCLASS_PINCTRL)
 		pinctrl_select_state(dev, "default");
+	bootstage_span_end(span);
 
 	return 0;
 fail_uclass:
@@ -383,6 +387,7 @@ fail_uclass:
 			__func__, dev->name);
 	}
 fail:
+	bootstage_span_end(span);
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
 	dev->seq = -1;
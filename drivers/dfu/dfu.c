@@ -16,11 +16,17 @@
 #include <hash.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
+#include <linux/sizes.h>
 
 static LIST_HEAD(dfu_list);
 static int dfu_alt_num;
 static int alt_num_cnt;
 static struct hash_algo *dfu_hash_algo;
+static bool dfu_async_drain;
+struct dfu_entity *dfu_defer_drain;
+
+/* Most data written by one dfu_drain() call, between two USB polls */
+#define DFU_DRAIN_CHUNK		SZ_64K
 
 /*
  * The purpose of the dfu_usb_get_reset() function is to
@@ -90,6 +96,11 @@ unsigned long dfu_get_buf_size(void)
 	return dfu_buf_size;
 }
 
+void dfu_set_async_drain(bool enable)
+{
+	dfu_async_drain = enable;
+}
+
 unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 {
 	char *s;
@@ -132,33 +143,124 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
-static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+/*
+ * Point the write buffer at the place for the data at dfu->offset: the
+ * backend's own memory if it offers it, else the DFU buffer or, when
+ * draining asynchronously, the half of it which is not being drained.
+ */
+static int dfu_write_buffer_setup(struct dfu_entity *dfu)
+{
+	unsigned char *buf = NULL;
+	long len = 0;
+
+	if (dfu->get_write_buf)
+		buf = dfu->get_write_buf(dfu, dfu->offset, &len);
+
+	dfu->banked = 0;
+	if (!buf) {
+		buf = dfu_get_buf(dfu);
+		if (!buf)
+			return -ENOMEM;
+		len = dfu_buf_size;
+
+		/*
+		 * Only media taking writes of any size at any offset can
+		 * be drained in pieces: NAND and SPI flash erase whole
+		 * blocks on each write, so they get the full buffer.
+		 */
+		if (dfu_async_drain && dfu->partial_write &&
+		    !dfu->max_buf_size && dfu_buf_size >= 2 * DFU_DRAIN_CHUNK) {
+			len = rounddown(dfu_buf_size / 2, DFU_DRAIN_CHUNK);
+			if (dfu->d_buf == buf)
+				buf += len;
+			dfu->banked = 1;
+		}
+	}
+
+	dfu->i_buf_start = buf;
+	dfu->i_buf_end = buf + len;
+	dfu->i_buf = buf;
+
+	return 0;
+}
+
+int dfu_drain(struct dfu_entity *dfu)
+{
+	long w_size = dfu->d_left;
+	int ret;
+
+	if (dfu->banked)
+		w_size = min_t(long, w_size, DFU_DRAIN_CHUNK);
+
+	if (!w_size)
+		return 0;
+
+	ret = dfu->write_medium(dfu, dfu->d_offset, dfu->d_pos, &w_size);
+	if (ret) {
+		debug("%s: Write error!\n", __func__);
+		dfu->d_err = ret;
+		w_size = dfu->d_left;
+	}
+
+	dfu->d_pos += w_size;
+	dfu->d_offset += w_size;
+	dfu->d_left -= w_size;
+
+	if (!dfu->d_left) {
+		if (dfu_defer_drain == dfu)
+			dfu_defer_drain = NULL;
+		if (!ret)
+			puts("#");
+	}
+
+	return ret;
+}
+
+static int dfu_drain_finish(struct dfu_entity *dfu)
+{
+	int ret;
+
+	while (dfu->d_left)
+		dfu_drain(dfu);
+
+	ret = dfu->d_err;
+	dfu->d_err = 0;
+
+	return ret;
+}
+
+static int dfu_write_buffer_drain(struct dfu_entity *dfu, bool defer)
 {
 	long w_size;
 	int ret;
 
+	/* the other half must be on the medium before this one goes */
+	ret = dfu_drain_finish(dfu);
+	if (ret)
+		return ret;
+
 	/* flush size? */
 	w_size = dfu->i_buf - dfu->i_buf_start;
 	if (w_size == 0)
 		return 0;
 
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
-
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
-	if (ret)
-		debug("%s: Write error!\n", __func__);
-
-	/* point back */
-	dfu->i_buf = dfu->i_buf_start;
+	dfu->d_buf = dfu->i_buf_start;
+	dfu->d_pos = dfu->i_buf_start;
+	dfu->d_left = w_size;
+	dfu->d_offset = dfu->offset;
 
 	/* update offset */
 	dfu->offset += w_size;
 
-	puts("#");
+	if (defer && dfu->banked) {
+		dfu_defer_drain = dfu;
+	} else {
+		ret = dfu_drain_finish(dfu);
+		if (ret)
+			return ret;
+	}
 
-	return ret;
+	return dfu_write_buffer_setup(dfu);
 }
 
 void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
@@ -170,6 +272,12 @@ void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
 	dfu->i_buf_start = dfu_buf;
 	dfu->i_buf_end = dfu_buf;
 	dfu->i_buf = dfu->i_buf_start;
+	dfu->d_buf = NULL;
+	dfu->d_pos = NULL;
+	dfu->d_left = 0;
+	dfu->d_err = 0;
+	if (dfu_defer_drain == dfu)
+		dfu_defer_drain = NULL;
 	dfu->inited = 0;
 }
 
@@ -177,7 +285,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
 	int ret = 0;
 
-	ret = dfu_write_buffer_drain(dfu);
+	ret = dfu_write_buffer_drain(dfu, false);
 	if (ret)
 		return ret;
 
@@ -193,6 +301,23 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	return ret;
 }
 
+/*
+ * Return where dfu_write() is going to put the next block of @size bytes,
+ * so that the caller can receive it there and save the copy. NULL when
+ * that is not known yet, the buffer has to be drained first or the place
+ * is not suitably aligned for DMA.
+ */
+void *dfu_get_write_ptr(struct dfu_entity *dfu, int size)
+{
+	if (!dfu->inited || size <= 0 ||
+	    dfu->i_buf + size > dfu->i_buf_end ||
+	    !IS_ALIGNED((unsigned long)dfu->i_buf, ARCH_DMA_MINALIGN) ||
+	    !IS_ALIGNED(size, ARCH_DMA_MINALIGN))
+		return NULL;
+
+	return dfu->i_buf;
+}
+
 int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
 	int ret;
@@ -207,11 +332,12 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		dfu->offset = 0;
 		dfu->bad_skip = 0;
 		dfu->i_blk_seq_num = 0;
-		dfu->i_buf_start = dfu_get_buf(dfu);
-		if (dfu->i_buf_start == NULL)
-			return -ENOMEM;
-		dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
-		dfu->i_buf = dfu->i_buf_start;
+		dfu->d_buf = NULL;
+		dfu->d_left = 0;
+		dfu->d_err = 0;
+		ret = dfu_write_buffer_setup(dfu);
+		if (ret)
+			return ret;
 
 		dfu->inited = 1;
 	}
@@ -239,9 +365,16 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* handle rollover */
 	dfu->i_blk_seq_num = (dfu->i_blk_seq_num + 1) & 0xffff;
 
+	/* a failed deferred write is reported with the next block */
+	if (dfu->d_err) {
+		ret = dfu->d_err;
+		dfu_write_transaction_cleanup(dfu);
+		return ret;
+	}
+
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_drain(dfu, false);
 		if (ret) {
 			dfu_write_transaction_cleanup(dfu);
 			return ret;
@@ -256,12 +389,19 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		return -1;
 	}
 
-	memcpy(dfu->i_buf, buf, size);
+	/* the block may have been received in place already */
+	if (buf != dfu->i_buf)
+		memcpy(dfu->i_buf, buf, size);
+
+	/* hash it while it is still in the cache */
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
+					   dfu->i_buf, size, 0);
 	dfu->i_buf += size;
 
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_drain(dfu, size != 0);
 		if (ret) {
 			dfu_write_transaction_cleanup(dfu);
 			return ret;
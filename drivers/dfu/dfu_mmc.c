@@ -99,8 +99,9 @@ static int mmc_file_buffer(struct dfu_entity *dfu, void *buf, long *len)
 		return -EINVAL;
 	}
 
-	/* Add to the current buffer. */
-	memcpy(dfu_file_buf + dfu_file_buf_len, buf, *len);
+	/* Add to the current buffer, unless it was received there. */
+	if (buf != dfu_file_buf + dfu_file_buf_len)
+		memcpy(dfu_file_buf + dfu_file_buf_len, buf, *len);
 	dfu_file_buf_len += *len;
 
 	return 0;
@@ -209,6 +210,18 @@ int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 	return ret;
 }
 
+/* Files are collected in dfu_file_buf anyway, so receive them there */
+static void *dfu_get_write_buf_mmc(struct dfu_entity *dfu, u64 offset,
+				   long *len)
+{
+	if (dfu->layout == DFU_RAW_ADDR || offset != dfu_file_buf_len)
+		return NULL;
+
+	*len = CONFIG_SYS_DFU_MAX_FILE_SIZE - dfu_file_buf_len;
+
+	return dfu_file_buf + dfu_file_buf_len;
+}
+
 long dfu_get_medium_size_mmc(struct dfu_entity *dfu)
 {
 	int ret;
@@ -389,6 +402,8 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 	dfu->read_medium = dfu_read_medium_mmc;
 	dfu->write_medium = dfu_write_medium_mmc;
 	dfu->flush_medium = dfu_flush_medium_mmc;
+	dfu->get_write_buf = dfu_get_write_buf_mmc;
+	dfu->partial_write = 1;
 	dfu->inited = 0;
 	dfu->free_entity = dfu_free_entity_mmc;
 
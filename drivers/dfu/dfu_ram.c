@@ -27,6 +27,10 @@ static int dfu_transfer_medium_ram(enum dfu_op op, struct dfu_entity *dfu,
 		return -EINVAL;
 	}
 
+	/* data received through dfu_get_write_buf_ram() is in place */
+	if (buf == dfu->data.ram.start + offset)
+		return 0;
+
 	if (op == DFU_OP_WRITE)
 		memcpy(dfu->data.ram.start + offset, buf, *len);
 	else
@@ -35,6 +39,17 @@ static int dfu_transfer_medium_ram(enum dfu_op op, struct dfu_entity *dfu,
 	return 0;
 }
 
+static void *dfu_get_write_buf_ram(struct dfu_entity *dfu, u64 offset,
+				   long *len)
+{
+	if (offset > dfu->data.ram.size)
+		return NULL;
+
+	*len = dfu->data.ram.size - offset;
+
+	return dfu->data.ram.start + offset;
+}
+
 static int dfu_write_medium_ram(struct dfu_entity *dfu, u64 offset,
 				void *buf, long *len)
 {
@@ -76,6 +91,8 @@ int dfu_fill_entity_ram(struct dfu_entity *dfu, char *devstr, char *s)
 	dfu->data.ram.size = simple_strtoul(argv[2], NULL, 16);
 
 	dfu->write_medium = dfu_write_medium_ram;
+	dfu->get_write_buf = dfu_get_write_buf_ram;
+	dfu->partial_write = 1;
 	dfu->get_medium_size = dfu_get_medium_size_ram;
 	dfu->read_medium = dfu_read_medium_ram;
 
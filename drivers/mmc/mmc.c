@@ -925,6 +925,7 @@ retry_scr:
 
 	mmc->scr[0] = __be32_to_cpu(scr[0]);
 	mmc->scr[1] = __be32_to_cpu(scr[1]);
+	mmc->erased_val = mmc->scr[0] & SD_DATA_STAT_AFTER_ERASE ? 0xff : 0;
 
 	switch ((mmc->scr[0] >> 24) & 0xf) {
 	case 0:
@@ -1263,12 +1264,14 @@ static int mmc_startup(struct mmc *mmc)
 	 * For SD, its erase group is always one sector
 	 */
 	mmc->erase_grp_size = 1;
+	mmc->erased_val = -1;
 	mmc->part_config = MMCPART_NOAVAILABLE;
 	if (!IS_SD(mmc) && (mmc->version >= MMC_VERSION_4)) {
 		/* check  ext_csd version and capacity */
 		err = mmc_send_ext_csd(mmc, ext_csd);
 		if (err)
 			return err;
+		mmc->erased_val = ext_csd[EXT_CSD_ERASED_MEM_CONT] ? 0xff : 0;
 		if (ext_csd[EXT_CSD_REV] >= 2) {
 			/*
 			 * According to the JEDEC Standard, the value of
@@ -1500,6 +1500,53 @@ static int nand_setup_read_retry(struct mtd_info *mtd, int retry_mode)
 	return chip->setup_read_retry(mtd, retry_mode);
 }
 
+/**
+ * nand_can_cache_read - [INTERN] Check if a read can use sequential cache reads
+ * @mtd: MTD device structure
+ * @ops: oob ops structure
+ *
+ * Cache reads are only used with the generic large page command function,
+ * which passes READCACHESEQ/READCACHEEND through like any other read command,
+ * and only for plain page reads: subpage, OOB-first and read-retry handling all
+ * need to issue their own READ0 for a given page.
+ */
+static bool nand_can_cache_read(struct mtd_info *mtd, struct mtd_oob_ops *ops)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+
+	if (!NAND_HAS_CACHE_READ(chip) || chip->cmdfunc != nand_command_lp)
+		return false;
+	if (ops->oobbuf || chip->read_retries > 1 ||
+	    (chip->options & NAND_NEED_READRDY))
+		return false;
+
+	return ops->mode == MTD_OPS_RAW ||
+	       chip->ecc.mode != NAND_ECC_HW_OOB_FIRST;
+}
+
+/**
+ * nand_cache_read_last - [INTERN] Get the last page of a cache read sequence
+ * @mtd: MTD device structure
+ * @realpage: first page of the sequence
+ * @readlen: number of bytes left to read, starting at @realpage
+ *
+ * A sequence covers whole pages only and stops at the end of the eraseblock.
+ * Returns the last page, or -1 if fewer than two pages would be read.
+ */
+static int nand_cache_read_last(struct mtd_info *mtd, int realpage,
+				uint32_t readlen)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+	int ppb = 1 << (chip->phys_erase_shift - chip->page_shift);
+	int pages = readlen >> chip->page_shift;
+
+	pages = min(pages, ppb - (realpage & (ppb - 1)));
+	if (pages < 2)
+		return -1;
+
+	return realpage + pages - 1;
+}
+
 /**
  * nand_do_read_ops - [INTERN] Read data with ECC
  * @mtd: MTD device structure
@@ -1523,6 +1570,9 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	unsigned int max_bitflips = 0;
 	int retry_mode = 0;
 	bool ecc_fail = false;
+	bool cache_read = nand_can_cache_read(mtd, ops);
+	int cache_last = -1;
+	ulong start = timer_get_us();
 
 	chipnr = (int)(from >> chip->chip_shift);
 	chip->select_chip(mtd, chipnr);
@@ -1557,7 +1607,31 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 						 __func__, buf);
 
 read_retry:
-			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+			if (realpage <= cache_last) {
+				/*
+				 * This page is already being loaded by the
+				 * previous READCACHESEQ: move it to the cache
+				 * register and, unless it is the last one,
+				 * start loading the next page meanwhile.
+				 */
+				chip->cmdfunc(mtd, realpage == cache_last ?
+					      NAND_CMD_READCACHEEND :
+					      NAND_CMD_READCACHESEQ, -1, -1);
+			} else {
+				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+				if (cache_read && aligned)
+					cache_last = nand_cache_read_last(mtd,
+							realpage, readlen);
+				if (cache_last > realpage) {
+					/* Every page must come from the chip */
+					if (chip->pagebuf > realpage &&
+					    chip->pagebuf <= cache_last)
+						chip->pagebuf = -1;
+					chip->cmdfunc(mtd,
+						      NAND_CMD_READCACHESEQ,
+						      -1, -1);
+				}
+			}
 
 			/*
 			 * Now read the page into the buffer.  Absent an error,
@@ -1667,12 +1741,20 @@ read_retry:
 			chip->select_chip(mtd, chipnr);
 		}
 	}
+
+	/* Terminate a sequence that was cut short by an error */
+	if (realpage < cache_last)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+
 	chip->select_chip(mtd, -1);
 
 	ops->retlen = ops->len - (size_t) readlen;
 	if (oob)
 		ops->oobretlen = ops->ooblen - oobreadlen;
 
+	chip->read_bytes += ops->retlen;
+	chip->read_us += timer_get_us() - start;
+
 	if (ret < 0)
 		return ret;
 
@@ -3196,6 +3278,9 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 		pr_warn("Could not retrieve ONFI ECC requirements\n");
 	}
 
+	if (le16_to_cpu(p->opt_cmd) & ONFI_OPT_CMD_READ_CACHE)
+		chip->options |= NAND_CACHERD;
+
 	if (p->jedec_id == NAND_MFR_MICRON)
 		nand_onfi_detect_micron(chip, p);
 
@@ -59,6 +59,8 @@
 
 #include <common.h>
 #include <malloc.h>
+#include <mapmem.h>
+#include <u-boot/crc.h>
 #include <linux/compat.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/bbm.h>
@@ -1058,6 +1060,108 @@ static void verify_bbt_descr(struct mtd_info *mtd, struct nand_bbt_descr *bd)
 	BUG_ON(table_size > (1 << this->bbt_erase_shift));
 }
 
+#ifdef CONFIG_NAND_BBT_STASH
+#define NAND_BBT_STASH_MAGIC	0x54424253	/* "SBBT" */
+
+/*
+ * RAM copy of a memory-based bad block table, kept across warm resets. There
+ * is a single slot, and blocks marked bad by the OS do not update it.
+ */
+struct nand_bbt_stash {
+	u32 magic;
+	u32 id;		/* identifies the device the table belongs to */
+	u32 len;	/* length of @bbt in bytes */
+	u32 crc;	/* crc32 of @bbt */
+	u8 bbt[];
+};
+
+static u32 nand_bbt_stash_id(struct mtd_info *mtd)
+{
+	u32 geo[4] = {
+		lower_32_bits(mtd->size), upper_32_bits(mtd->size),
+		mtd->erasesize, mtd->writesize,
+	};
+	u32 id = crc32(0, (u8 *)geo, sizeof(geo));
+
+	if (mtd->name)
+		id = crc32(id, (const u8 *)mtd->name, strlen(mtd->name));
+
+	return id;
+}
+
+/**
+ * nand_bbt_stash_load - [GENERIC] Restore the bad block table from RAM
+ * @mtd: MTD device structure
+ * @len: length of the bad block table
+ *
+ * Returns 0 if this->bbt was filled from a valid stash, -ENOENT otherwise.
+ */
+static int nand_bbt_stash_load(struct mtd_info *mtd, int len)
+{
+	struct nand_chip *this = mtd_to_nand(mtd);
+	struct nand_bbt_stash *stash;
+
+	stash = map_sysmem(CONFIG_NAND_BBT_STASH_ADDR, sizeof(*stash) + len);
+	if (stash->magic != NAND_BBT_STASH_MAGIC || stash->len != len ||
+	    stash->id != nand_bbt_stash_id(mtd) ||
+	    stash->crc != crc32(0, stash->bbt, len)) {
+		unmap_sysmem(stash);
+		return -ENOENT;
+	}
+
+	memcpy(this->bbt, stash->bbt, len);
+	unmap_sysmem(stash);
+	pr_debug("nand_bbt: using stashed bad block table\n");
+
+	return 0;
+}
+
+/**
+ * nand_bbt_stash_save - [GENERIC] Save the bad block table to RAM
+ * @mtd: MTD device structure
+ */
+static void nand_bbt_stash_save(struct mtd_info *mtd)
+{
+	struct nand_chip *this = mtd_to_nand(mtd);
+	struct nand_bbt_stash *stash;
+	int len = (mtd->size >> (this->bbt_erase_shift + 2)) ? : 1;
+
+	if (!this->bbt || this->bbt_td)
+		return;
+
+	stash = map_sysmem(CONFIG_NAND_BBT_STASH_ADDR, sizeof(*stash) + len);
+	memcpy(stash->bbt, this->bbt, len);
+	stash->len = len;
+	stash->id = nand_bbt_stash_id(mtd);
+	stash->crc = crc32(0, stash->bbt, len);
+	stash->magic = NAND_BBT_STASH_MAGIC;
+	unmap_sysmem(stash);
+}
+
+/**
+ * nand_bbt_stash_drop - [NAND Interface] Invalidate the stashed bad block table
+ * @mtd: MTD device structure
+ *
+ * Must be called when the bad block markers on the flash are changed behind
+ * the table's back, e.g. by a scrub.
+ */
+void nand_bbt_stash_drop(struct mtd_info *mtd)
+{
+	struct nand_bbt_stash *stash;
+
+	stash = map_sysmem(CONFIG_NAND_BBT_STASH_ADDR, sizeof(*stash));
+	stash->magic = 0;
+	unmap_sysmem(stash);
+}
+#else
+static inline int nand_bbt_stash_load(struct mtd_info *mtd, int len)
+{
+	return -ENOENT;
+}
+
+static inline void nand_bbt_stash_save(struct mtd_info *mtd) {}
+#endif /* CONFIG_NAND_BBT_STASH */
+
 /**
  * nand_scan_bbt - [NAND Interface] scan, find, read and maybe create bad block table(s)
  * @mtd: MTD device structure
@@ -1092,10 +1196,13 @@ static int nand_scan_bbt(struct mtd_info *mtd, struct nand_bbt_descr *bd)
 	 * memory based bad block table.
 	 */
 	if (!td) {
+		if (!nand_bbt_stash_load(mtd, len))
+			return 0;
 		if ((res = nand_memory_bbt(mtd, bd))) {
 			pr_err("nand_bbt: can't scan flash and build the RAM-based BBT\n");
 			goto err;
 		}
+		nand_bbt_stash_save(mtd);
 		return 0;
 	}
 	verify_bbt_descr(mtd, td);
@@ -1368,6 +1475,8 @@ int nand_markbad_bbt(struct mtd_info *mtd, loff_t offs)
 	/* Update flash-based bad block table */
 	if (this->bbt_options & NAND_BBT_USE_FLASH)
 		ret = nand_update_bbt(mtd, offs);
+	else
+		nand_bbt_stash_save(mtd);
 
 	return ret;
 }
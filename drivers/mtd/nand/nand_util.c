@@ -94,6 +94,7 @@ int nand_erase_opts(struct mtd_info *mtd,
 		}
 		chip->bbt = NULL;
 		chip->options &= ~NAND_BBT_SCANNED;
+		nand_bbt_stash_drop(mtd);
 	}
 
 	for (erased_length = 0;
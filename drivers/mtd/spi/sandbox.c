@@ -41,13 +41,14 @@ enum sandbox_sf_state {
 	SF_READ_STATUS, /* read the flash's status register */
 	SF_READ_STATUS1, /* read the flash's status register upper 8 bits*/
 	SF_WRITE_STATUS, /* write the flash's status register */
+	SF_READ_SFDP, /* read the flash's SFDP tables */
 };
 
 static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 {
 	static const char * const states[] = {
 		"CMD", "ID", "ADDR", "READ", "WRITE", "ERASE", "READ_STATUS",
-		"READ_STATUS1", "WRITE_STATUS",
+		"READ_STATUS1", "WRITE_STATUS", "READ_SFDP",
 	};
 	return states[state];
 }
@@ -56,11 +57,15 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 #define STAT_WIP	(1 << 0)
 #define STAT_WEL	(1 << 1)
 
-/* Assume all SPI flashes have 3 byte addresses since they do atm */
+/* Address length of the regular commands; 4-byte opcodes use one more */
 #define SF_ADDR_LEN	3
 
 #define IDCODE_LEN 3
 
+/* SFDP header, one parameter header and a JESD216 (9 dword) BFPT */
+#define SFDP_BFPT_DWORDS	9
+#define SFDP_LEN		(16 + SFDP_BFPT_DWORDS * 4)
+
 /* Used to quickly bulk erase backing store */
 static u8 sandbox_sf_0xff[0x1000];
 
@@ -83,14 +88,16 @@ struct sandbox_spi_flash {
 	uint erase_size;
 	/* Current position in the flash; used when reading/writing/etc... */
 	uint off;
-	/* How many address bytes we've consumed */
-	uint addr_bytes, pad_addr_bytes;
+	/* How many address bytes we've consumed, and how many to expect */
+	uint addr_bytes, pad_addr_bytes, addr_len;
 	/* The current flash status (see STAT_XXX defines above) */
 	u16 status;
 	/* Data describing the flash we're emulating */
 	const struct spi_flash_info *data;
 	/* The file on disk to serv up data from */
 	int fd;
+	/* SFDP tables describing the flash */
+	u8 sfdp[SFDP_LEN];
 };
 
 struct sandbox_spi_flash_plat_data {
@@ -100,6 +107,58 @@ struct sandbox_spi_flash_plat_data {
 	int cs;
 };
 
+static void sandbox_sf_put_le32(u8 *buf, u32 val)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		buf[i] = val >> (8 * i);
+}
+
+/* Describe the emulated flash in SFDP tables, as a real part would */
+static void sandbox_sf_build_sfdp(const struct spi_flash_info *data, u8 *sfdp)
+{
+	u64 bits = (u64)data->sector_size * data->n_sectors * 8;
+	u32 bfpt[SFDP_BFPT_DWORDS];
+	int i;
+
+	memset(bfpt, '\0', sizeof(bfpt));
+	if (data->flags & SECT_4K)
+		bfpt[0] = 0x1 | CMD_ERASE_4K << 8;
+	else
+		bfpt[0] = 0x3 | 0xff << 8;
+	if (data->flags & RD_DUAL) {
+		bfpt[0] |= BIT(16);
+		bfpt[3] = 8 | CMD_READ_DUAL_OUTPUT_FAST << 8;
+	}
+	if (data->flags & RD_QUAD) {
+		bfpt[0] |= BIT(22);
+		bfpt[2] = (8 | CMD_READ_QUAD_OUTPUT_FAST << 8) << 16;
+	}
+	if (bits > 1ULL << 32)
+		bfpt[1] = BIT(31) | __ffs64(bits);
+	else
+		bfpt[1] = bits - 1;
+	bfpt[7] = __ffs(data->sector_size) | CMD_ERASE_64K << 8;
+	if (data->flags & SECT_4K)
+		bfpt[7] |= (12 | CMD_ERASE_4K << 8) << 16;
+
+	/* Header: signature, v1.0, one parameter header */
+	sandbox_sf_put_le32(sfdp, 0x50444653);
+	sfdp[4] = 0;
+	sfdp[5] = 1;
+	sfdp[6] = 0;
+	sfdp[7] = 0xff;
+	/* BFPT parameter header: v1.0 at offset 16 */
+	sfdp[8] = 0x00;
+	sfdp[9] = 0;
+	sfdp[10] = 1;
+	sfdp[11] = SFDP_BFPT_DWORDS;
+	sandbox_sf_put_le32(sfdp + 12, 16 | 0xff << 24);
+	for (i = 0; i < SFDP_BFPT_DWORDS; i++)
+		sandbox_sf_put_le32(sfdp + 16 + i * 4, bfpt[i]);
+}
+
 /**
  * This is a very strange probe function. If it has platform data (which may
  * have come from the device tree) then this function gets the filename and
@@ -195,6 +254,7 @@ static int sandbox_sf_probe(struct udevice *dev)
 
 	sbsf->data = data;
 	sbsf->cs = cs;
+	sandbox_sf_build_sfdp(data, sbsf->sfdp);
 
 	return 0;
 
@@ -222,6 +282,7 @@ static void sandbox_sf_cs_activate(struct udevice *dev)
 	sbsf->off = 0;
 	sbsf->addr_bytes = 0;
 	sbsf->pad_addr_bytes = 0;
+	sbsf->addr_len = SF_ADDR_LEN;
 	sbsf->state = SF_CMD;
 	sbsf->cmd = SF_CMD;
 }
@@ -260,6 +321,23 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		sbsf->state = SF_ID;
 		sbsf->cmd = SF_ID;
 		break;
+	case CMD_READ_ARRAY_FAST_4B:
+		sbsf->cmd = CMD_READ_ARRAY_FAST;
+		sbsf->addr_len = SF_ADDR_LEN + 1;
+		sbsf->pad_addr_bytes = 1;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_READ_ARRAY_SLOW_4B:
+		sbsf->cmd = CMD_READ_ARRAY_SLOW;
+		sbsf->addr_len = SF_ADDR_LEN + 1;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_PAGE_PROGRAM_4B:
+		sbsf->cmd = CMD_PAGE_PROGRAM;
+		sbsf->addr_len = SF_ADDR_LEN + 1;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_READ_SFDP:
 	case CMD_READ_ARRAY_FAST:
 		sbsf->pad_addr_bytes = 1;
 	case CMD_READ_ARRAY_SLOW:
@@ -287,13 +365,19 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		int flags = sbsf->data->flags;
 
 		/* we only support erase here */
+		if (sbsf->cmd == CMD_ERASE_4K_4B ||
+		    sbsf->cmd == CMD_ERASE_64K_4B) {
+			sbsf->cmd = sbsf->cmd == CMD_ERASE_4K_4B ?
+				CMD_ERASE_4K : CMD_ERASE_64K;
+			sbsf->addr_len = SF_ADDR_LEN + 1;
+		}
 		if (sbsf->cmd == CMD_ERASE_CHIP) {
 			sbsf->erase_size = sbsf->data->sector_size *
 				sbsf->data->n_sectors;
 		} else if (sbsf->cmd == CMD_ERASE_4K && (flags & SECT_4K)) {
 			sbsf->erase_size = 4 << 10;
-		} else if (sbsf->cmd == CMD_ERASE_64K && !(flags & SECT_4K)) {
-			sbsf->erase_size = 64 << 10;
+		} else if (sbsf->cmd == CMD_ERASE_64K) {
+			sbsf->erase_size = sbsf->data->sector_size;
 		} else {
 			debug(" cmd unknown: %#x\n", sbsf->cmd);
 			return -EIO;
@@ -374,7 +458,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			debug(" addr: bytes:%u rx:%02x ", sbsf->addr_bytes,
 			      rx[pos]);
 
-			if (sbsf->addr_bytes++ < SF_ADDR_LEN)
+			if (sbsf->addr_bytes++ < sbsf->addr_len)
 				sbsf->off = (sbsf->off << 8) | rx[pos];
 			debug("addr:%06x\n", sbsf->off);
 
@@ -384,7 +468,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 
 			/* See if we're done processing */
 			if (sbsf->addr_bytes <
-					SF_ADDR_LEN + sbsf->pad_addr_bytes)
+					sbsf->addr_len + sbsf->pad_addr_bytes)
 				break;
 
 			/* Next state! */
@@ -400,6 +484,9 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			case CMD_PAGE_PROGRAM:
 				sbsf->state = SF_WRITE;
 				break;
+			case CMD_READ_SFDP:
+				sbsf->state = SF_READ_SFDP;
+				break;
 			default:
 				/* assume erase state ... */
 				sbsf->state = SF_ERASE;
@@ -424,6 +511,14 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			}
 			pos += ret;
 			break;
+		case SF_READ_SFDP:
+			debug(" sfdp: off:%u\n", sbsf->off);
+			while (pos < bytes) {
+				tx[pos++] = sbsf->off < SFDP_LEN ?
+					sbsf->sfdp[sbsf->off] : 0xff;
+				sbsf->off++;
+			}
+			break;
 		case SF_READ_STATUS:
 			debug(" read status: %#x\n", sbsf->status);
 			cnt = bytes - pos;
@@ -22,12 +22,19 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
-static void spi_flash_addr(u32 addr, u8 *cmd)
+/* Fill in the address after cmd[0], returning the total command length */
+static int spi_flash_addr(struct spi_flash *flash, u32 addr, u8 *cmd)
 {
+	int i = 1;
+
 	/* cmd[0] is actual command */
-	cmd[1] = addr >> 16;
-	cmd[2] = addr >> 8;
-	cmd[3] = addr >> 0;
+	if (flash->addr_width == SPI_FLASH_4B_ADDR_LEN)
+		cmd[i++] = addr >> 24;
+	cmd[i++] = addr >> 16;
+	cmd[i++] = addr >> 8;
+	cmd[i++] = addr >> 0;
+
+	return i;
 }
 
 static int read_sr(struct spi_flash *flash, u8 *rs)
@@ -291,10 +298,31 @@ int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+/*
+ * Pick the largest erase block that starts at offset and fits in len,
+ * falling back to the smallest erase size of the flash
+ */
+static const struct spi_flash_erase_type *
+spi_flash_erase_type(struct spi_flash *flash, u32 offset, size_t len)
+{
+	const struct spi_flash_erase_type *type;
+	int i;
+
+	for (i = SPI_FLASH_MAX_ERASE_TYPES - 1; i >= 0; i--) {
+		type = &flash->erase_types[i];
+		if (type->size && !(offset % type->size) && len >= type->size)
+			return type;
+	}
+
+	return NULL;
+}
+
 int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 {
+	const struct spi_flash_erase_type *type;
 	u32 erase_size, erase_addr;
-	u8 cmd[SPI_FLASH_CMD_LEN];
+	u8 cmd[SPI_FLASH_MAX_CMD_LEN];
+	int cmd_len;
 	int ret = -1;
 
 	erase_size = flash->erase_size;
@@ -311,25 +339,34 @@ int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 		}
 	}
 
-	cmd[0] = flash->erase_cmd;
 	while (len) {
 		erase_addr = offset;
+		type = spi_flash_erase_type(flash, offset, len);
+		if (type) {
+			cmd[0] = type->cmd;
+			erase_size = type->size;
+		} else {
+			cmd[0] = flash->erase_cmd;
+			erase_size = flash->erase_size;
+		}
 
 #ifdef CONFIG_SF_DUAL_FLASH
 		if (flash->dual_flash > SF_SINGLE_FLASH)
 			spi_flash_dual(flash, &erase_addr);
 #endif
 #ifdef CONFIG_SPI_FLASH_BAR
-		ret = write_bar(flash, erase_addr);
-		if (ret < 0)
-			return ret;
+		if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN) {
+			ret = write_bar(flash, erase_addr);
+			if (ret < 0)
+				return ret;
+		}
 #endif
-		spi_flash_addr(erase_addr, cmd);
+		cmd_len = spi_flash_addr(flash, erase_addr, cmd);
 
-		debug("SF: erase %2x %2x %2x %2x (%x)\n", cmd[0], cmd[1],
-		      cmd[2], cmd[3], erase_addr);
+		debug("SF: erase %2x %2x %2x %2x (%x, %#x)\n", cmd[0], cmd[1],
+		      cmd[2], cmd[3], erase_addr, erase_size);
 
-		ret = spi_flash_write_common(flash, cmd, sizeof(cmd), NULL, 0);
+		ret = spi_flash_write_common(flash, cmd, cmd_len, NULL, 0);
 		if (ret < 0) {
 			debug("SF: erase failed\n");
 			break;
@@ -349,7 +386,8 @@ int spi_flash_cmd_write_ops(struct spi_flash *flash, u32 offset,
 	unsigned long byte_addr, page_size;
 	u32 write_addr;
 	size_t chunk_len, actual;
-	u8 cmd[SPI_FLASH_CMD_LEN];
+	u8 cmd[SPI_FLASH_MAX_CMD_LEN];
+	int cmd_len;
 	int ret = -1;
 
 	page_size = flash->page_size;
@@ -371,9 +409,11 @@ int spi_flash_cmd_write_ops(struct spi_flash *flash, u32 offset,
 			spi_flash_dual(flash, &write_addr);
 #endif
 #ifdef CONFIG_SPI_FLASH_BAR
-		ret = write_bar(flash, write_addr);
-		if (ret < 0)
-			return ret;
+		if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN) {
+			ret = write_bar(flash, write_addr);
+			if (ret < 0)
+				return ret;
+		}
 #endif
 		byte_addr = offset % page_size;
 		chunk_len = min(len - actual, (size_t)(page_size - byte_addr));
@@ -382,12 +422,12 @@ int spi_flash_cmd_write_ops(struct spi_flash *flash, u32 offset,
 			chunk_len = min(chunk_len,
 					(size_t)spi->max_write_size);
 
-		spi_flash_addr(write_addr, cmd);
+		cmd_len = spi_flash_addr(flash, write_addr, cmd);
 
 		debug("SF: 0x%p => cmd = { 0x%02x 0x%02x%02x%02x } chunk_len = %zu\n",
 		      buf + actual, cmd[0], cmd[1], cmd[2], cmd[3], chunk_len);
 
-		ret = spi_flash_write_common(flash, cmd, sizeof(cmd),
+		ret = spi_flash_write_common(flash, cmd, cmd_len,
 					buf + actual, chunk_len);
 		if (ret < 0) {
 			debug("SF: write failed\n");
@@ -459,7 +499,7 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		return 0;
 	}
 
-	cmdsz = SPI_FLASH_CMD_LEN + flash->dummy_byte;
+	cmdsz = 1 + flash->addr_width + flash->dummy_byte;
 	cmd = calloc(1, cmdsz);
 	if (!cmd) {
 		debug("SF: Failed to allocate cmd\n");
@@ -474,20 +514,35 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		if (flash->dual_flash > SF_SINGLE_FLASH)
 			spi_flash_dual(flash, &read_addr);
 #endif
+		/*
+		 * With 4-byte addressing the whole request goes out as a
+		 * single transfer, except that stacked parts must still stop
+		 * at the die boundary; otherwise stop at each 16MiB bank.
+		 */
+		if (flash->addr_width == SPI_FLASH_4B_ADDR_LEN) {
+			read_len = len;
+#ifdef CONFIG_SF_DUAL_FLASH
+			remain_len = (flash->size >> 1) - offset;
+			if (flash->dual_flash == SF_DUAL_STACKED_FLASH &&
+			    offset < (flash->size >> 1) && len > remain_len)
+				read_len = remain_len;
+#endif
+		} else {
 #ifdef CONFIG_SPI_FLASH_BAR
-		ret = write_bar(flash, read_addr);
-		if (ret < 0)
-			return ret;
-		bank_sel = flash->bank_curr;
+			ret = write_bar(flash, read_addr);
+			if (ret < 0)
+				return ret;
+			bank_sel = flash->bank_curr;
 #endif
-		remain_len = ((SPI_FLASH_16MB_BOUN << flash->shift) *
-				(bank_sel + 1)) - offset;
-		if (len < remain_len)
-			read_len = len;
-		else
-			read_len = remain_len;
+			remain_len = ((SPI_FLASH_16MB_BOUN << flash->shift) *
+					(bank_sel + 1)) - offset;
+			if (len < remain_len)
+				read_len = len;
+			else
+				read_len = remain_len;
+		}
 
-		spi_flash_addr(read_addr, cmd);
+		spi_flash_addr(flash, read_addr, cmd);
 
 		ret = spi_flash_read_common(flash, cmd, cmdsz, data, read_len);
 		if (ret < 0) {
@@ -863,10 +918,10 @@ static int spansion_quad_enable(struct spi_flash *flash)
 }
 #endif
 
-static const struct spi_flash_info *spi_flash_read_id(struct spi_flash *flash)
+static const struct spi_flash_info *spi_flash_read_id(struct spi_flash *flash,
+							u8 *id)
 {
 	int				tmp;
-	u8				id[SPI_FLASH_MAX_ID_LEN];
 	const struct spi_flash_info	*info;
 
 	tmp = spi_flash_cmd(flash->spi, CMD_READ_ID, id, SPI_FLASH_MAX_ID_LEN);
@@ -883,8 +938,6 @@ static const struct spi_flash_info *spi_flash_read_id(struct spi_flash *flash)
 		}
 	}
 
-	printf("SF: unrecognized JEDEC id bytes: %02x, %02x, %02x\n",
-	       id[0], id[1], id[2]);
 	return ERR_PTR(-ENODEV);
 }
 
@@ -938,15 +991,457 @@ int spi_flash_decode_fdt(const void *blob, struct spi_flash *flash)
 }
 #endif /* CONFIG_IS_ENABLED(OF_CONTROL) */
 
+#ifdef CONFIG_DM_SPI
+/*
+ * Ask the SPI controller for a memory-mapped window onto the flash. This
+ * is only used when the window starts at flash offset 0 and covers the
+ * whole device, so that reads can be done with a plain (DMA) copy and
+ * images can be executed in place.
+ */
+static void spi_flash_get_mmap(struct spi_flash *flash)
+{
+	ulong map_base;
+	uint map_size, offset;
+
+	if (flash->dual_flash != SF_SINGLE_FLASH)
+		return;
+	if (dm_spi_get_mmap(flash->spi->dev, &map_base, &map_size, &offset))
+		return;
+	if (offset || map_size < flash->size) {
+		debug("SF: mmap window %lx+%x at offset %x not usable\n",
+		      map_base, map_size, offset);
+		return;
+	}
+
+	flash->memory_map = map_sysmem(map_base, map_size);
+}
+#endif
+
+/* Erase types described by SFDP, and their 4-byte opcodes in the 4BAIT */
+#define SFDP_ERASE_TYPES	4
+
+/* 4BAIT 1st dword, which says which 4-byte address opcodes a part has */
+#define SFDP_4BAIT_READ		BIT(0)
+#define SFDP_4BAIT_READ_FAST	BIT(1)
+#define SFDP_4BAIT_READ_1_1_2	BIT(2)
+#define SFDP_4BAIT_READ_1_2_2	BIT(3)
+#define SFDP_4BAIT_READ_1_1_4	BIT(4)
+#define SFDP_4BAIT_READ_1_4_4	BIT(5)
+#define SFDP_4BAIT_PP		BIT(6)
+#define SFDP_4BAIT_PP_1_1_4	BIT(7)
+#define SFDP_4BAIT_ERASE(type)	BIT(9 + (type))
+/* Used for parts without a 4BAIT, which are trusted to have every opcode */
+#define SFDP_4BAIT_ALL		(~0U)
+
+#ifdef CONFIG_SPI_FLASH_SFDP
+#define SFDP_SIGNATURE		0x50444653	/* "SFDP", little endian */
+#define SFDP_BFPT_ID		0xff00	/* Basic Flash Parameter Table */
+#define SFDP_4BAIT_ID		0xff84	/* 4-byte Address Instruction Table */
+#define SFDP_MAX_HEADERS	8
+#define SFDP_BFPT_DWORDS	16
+#define SFDP_4BAIT_DWORDS	2
+
+/* BFPT 1st dword */
+#define BFPT_DW1_ERASE_4K	0x1
+#define BFPT_DW1_ERASE_4K_MASK	0x3
+#define BFPT_DW1_READ_1_1_2	BIT(16)
+#define BFPT_DW1_ADDR_MASK	(0x3 << 17)
+#define BFPT_DW1_READ_1_1_4	BIT(22)
+/* BFPT 2nd dword */
+#define BFPT_DW2_DENSITY_LOG2	BIT(31)
+
+struct sfdp_header {
+	u32 signature;
+	u8 minor;
+	u8 major;
+	u8 nph;			/* number of parameter headers - 1 */
+	u8 unused;
+};
+
+struct sfdp_param_header {
+	u8 id_lsb;
+	u8 minor;
+	u8 major;
+	u8 length;		/* in dwords */
+	u8 ptp[3];		/* parameter table pointer */
+	u8 id_msb;
+};
+
+/**
+ * struct sfdp_params - flash parameters described by the SFDP tables
+ *
+ * @size:	Flash size in bytes
+ * @page_size:	Page program size in bytes
+ * @flags:	RD_QUAD, RD_DUAL, SECT_4K and OPS_4B, as in spi_flash_info
+ * @quad_dummy:	Dummy bytes for CMD_READ_QUAD_OUTPUT_FAST
+ * @dual_dummy:	Dummy bytes for CMD_READ_DUAL_OUTPUT_FAST
+ * @erase_size:	Size of each erase type, 0 if the type is not used
+ * @erase_cmd:	Opcode of each erase type
+ * @erase_cmd_4b: 4-byte address opcode of each erase type, 0 if it has none
+ * @bait:	4BAIT support bits, 0 if the part has no 4BAIT
+ */
+struct sfdp_params {
+	u64 size;
+	u32 page_size;
+	u16 flags;
+	u8 quad_dummy;
+	u8 dual_dummy;
+	u32 erase_size[SFDP_ERASE_TYPES];
+	u8 erase_cmd[SFDP_ERASE_TYPES];
+	u8 erase_cmd_4b[SFDP_ERASE_TYPES];
+	u32 bait;
+};
+
+static int spi_flash_read_sfdp(struct spi_flash *flash, u32 addr, void *buf,
+			       size_t len)
+{
+	u8 cmd[SPI_FLASH_CMD_LEN + 1];
+
+	cmd[0] = CMD_READ_SFDP;
+	cmd[1] = addr >> 16;
+	cmd[2] = addr >> 8;
+	cmd[3] = addr >> 0;
+	cmd[4] = 0;	/* 8 dummy cycles */
+
+	return spi_flash_read_common(flash, cmd, sizeof(cmd), buf, len);
+}
+
+static u32 sfdp_param_ptr(const struct sfdp_param_header *phdr)
+{
+	return phdr->ptp[2] << 16 | phdr->ptp[1] << 8 | phdr->ptp[0];
+}
+
+/*
+ * Decode the dummy bytes of a 1-1-x fast read from its 16-bit BFPT entry.
+ * The address goes out on a single line, so the dummy and mode clocks must
+ * add up to whole bytes.
+ */
+static int sfdp_read_dummy(u16 entry, u8 opcode)
+{
+	int clocks = (entry & 0x1f) + ((entry >> 5) & 0x7);
+
+	if ((entry >> 8) != opcode || clocks % 8)
+		return -EINVAL;
+
+	return clocks / 8;
+}
+
+static int spi_flash_parse_sfdp(struct spi_flash *flash,
+				struct sfdp_params *params)
+{
+	struct sfdp_param_header phdr, bfpt_hdr, bait_hdr;
+	struct sfdp_header hdr;
+	u32 bfpt[SFDP_BFPT_DWORDS];
+	u32 bait[SFDP_4BAIT_DWORDS];
+	int i, nph, len, dummy;
+	int ret;
+
+	memset(params, '\0', sizeof(*params));
+	ret = spi_flash_read_sfdp(flash, 0, &hdr, sizeof(hdr));
+	if (ret)
+		return ret;
+	if (le32_to_cpu(hdr.signature) != SFDP_SIGNATURE || hdr.major != 1)
+		return -ENOENT;
+
+	/* Use the most recent BFPT revision and the 4BAIT, if present */
+	memset(&bfpt_hdr, '\0', sizeof(bfpt_hdr));
+	memset(&bait_hdr, '\0', sizeof(bait_hdr));
+	nph = min(hdr.nph + 1, SFDP_MAX_HEADERS);
+	for (i = 0; i < nph; i++) {
+		ret = spi_flash_read_sfdp(flash, sizeof(hdr) + i * sizeof(phdr),
+					  &phdr, sizeof(phdr));
+		if (ret)
+			return ret;
+
+		switch (phdr.id_msb << 8 | phdr.id_lsb) {
+		case SFDP_BFPT_ID:
+			if (phdr.major == 1 && (!bfpt_hdr.length ||
+						phdr.minor >= bfpt_hdr.minor))
+				bfpt_hdr = phdr;
+			break;
+		case SFDP_4BAIT_ID:
+			bait_hdr = phdr;
+			break;
+		}
+	}
+	if (!bfpt_hdr.length)
+		return -ENOENT;
+
+	memset(bfpt, '\0', sizeof(bfpt));
+	len = min_t(int, bfpt_hdr.length, SFDP_BFPT_DWORDS) * sizeof(u32);
+	ret = spi_flash_read_sfdp(flash, sfdp_param_ptr(&bfpt_hdr), bfpt, len);
+	if (ret)
+		return ret;
+	for (i = 0; i < SFDP_BFPT_DWORDS; i++)
+		bfpt[i] = le32_to_cpu(bfpt[i]);
+
+	/* Density is in bits, either as (size - 1) or as a power of two */
+	if (bfpt[1] & BFPT_DW2_DENSITY_LOG2)
+		params->size = 1ULL << ((bfpt[1] & ~BFPT_DW2_DENSITY_LOG2) - 3);
+	else
+		params->size = ((u64)bfpt[1] + 1) >> 3;
+
+	if ((bfpt[0] & BFPT_DW1_ERASE_4K_MASK) == BFPT_DW1_ERASE_4K &&
+	    ((bfpt[0] >> 8) & 0xff) == CMD_ERASE_4K)
+		params->flags |= SECT_4K;
+
+	if (bfpt[0] & BFPT_DW1_READ_1_1_4) {
+		dummy = sfdp_read_dummy(bfpt[2] >> 16,
+					CMD_READ_QUAD_OUTPUT_FAST);
+		if (dummy >= 0) {
+			params->flags |= RD_QUAD;
+			params->quad_dummy = dummy;
+		}
+	}
+	if (bfpt[0] & BFPT_DW1_READ_1_1_2) {
+		dummy = sfdp_read_dummy(bfpt[3] & 0xffff,
+					CMD_READ_DUAL_OUTPUT_FAST);
+		if (dummy >= 0) {
+			params->flags |= RD_DUAL;
+			params->dual_dummy = dummy;
+		}
+	}
+
+	/* Erase types 1-4, as (log2 size, opcode) pairs in dwords 8 and 9 */
+	for (i = 0; i < SFDP_ERASE_TYPES; i++) {
+		u16 type = bfpt[7 + i / 2] >> (16 * (i % 2));
+
+		if (type & 0xff) {
+			params->erase_size[i] = 1U << (type & 0xff);
+			params->erase_cmd[i] = type >> 8;
+		}
+	}
+
+	params->page_size = 256;
+	if (bfpt_hdr.length >= 11)
+		params->page_size = 1U << ((bfpt[10] >> 4) & 0xf);
+
+	/*
+	 * 4-byte address opcodes are only used if all of read, program and
+	 * the erase types are available; drop the multi-line reads that
+	 * lack a 4-byte variant on parts that will need it. The 2nd dword
+	 * gives the 4-byte opcode of each erase type.
+	 */
+	if ((bfpt[0] & BFPT_DW1_ADDR_MASK) && bait_hdr.length) {
+		memset(bait, '\0', sizeof(bait));
+		len = min_t(int, bait_hdr.length, SFDP_4BAIT_DWORDS) *
+			sizeof(u32);
+		ret = spi_flash_read_sfdp(flash, sfdp_param_ptr(&bait_hdr),
+					  bait, len);
+		if (ret)
+			return ret;
+		params->bait = le32_to_cpu(bait[0]);
+		for (i = 0; bait_hdr.length >= 2 && i < SFDP_ERASE_TYPES; i++) {
+			u8 cmd = le32_to_cpu(bait[1]) >> (8 * i);
+
+			if ((params->bait & SFDP_4BAIT_ERASE(i)) && cmd != 0xff)
+				params->erase_cmd_4b[i] = cmd;
+		}
+	}
+	if ((params->bait & SFDP_4BAIT_READ_FAST) &&
+	    (params->bait & SFDP_4BAIT_PP)) {
+		params->flags |= OPS_4B;
+		for (i = 0; i < SFDP_ERASE_TYPES; i++) {
+			if (params->erase_size[i] && !params->erase_cmd_4b[i])
+				params->flags &= ~OPS_4B;
+		}
+	}
+	if ((params->flags & OPS_4B) && params->size > SPI_FLASH_16MB_BOUN) {
+		if (!(params->bait & SFDP_4BAIT_READ_1_1_4))
+			params->flags &= ~RD_QUAD;
+		if (!(params->bait & SFDP_4BAIT_READ_1_1_2))
+			params->flags &= ~RD_DUAL;
+	}
+
+	debug("SF: SFDP size %#llx page %u flags %#x\n", params->size,
+	      params->page_size, params->flags);
+
+	return 0;
+}
+
+/*
+ * Combine the ID table entry, if there is one, with the SFDP parameters.
+ * Table entries only gain read modes and 4-byte opcodes; parts missing from
+ * the table are described by SFDP alone.
+ */
+static int spi_flash_sfdp_info(const struct spi_flash_info *entry,
+			       const u8 *id, const struct sfdp_params *params,
+			       struct spi_flash_info *info)
+{
+	u32 sector_size = 0;
+	int i;
+
+	if (entry) {
+		*info = *entry;
+		info->flags |= params->flags & (RD_QUAD | RD_DUAL | OPS_4B);
+		return 0;
+	}
+
+	for (i = 0; i < SFDP_ERASE_TYPES; i++) {
+		if (params->erase_cmd[i] == CMD_ERASE_64K)
+			sector_size = params->erase_size[i];
+	}
+	if (!sector_size || !params->size || params->size > U32_MAX)
+		return -EINVAL;
+
+	memset(info, '\0', sizeof(*info));
+	info->name = "SFDP";
+	memcpy(info->id, id, SPI_FLASH_MAX_ID_LEN);
+	info->id_len = 3;
+	info->sector_size = sector_size;
+	info->n_sectors = params->size / sector_size;
+	info->page_size = params->page_size;
+	info->flags = params->flags;
+
+	return 0;
+}
+#endif /* CONFIG_SPI_FLASH_SFDP */
+
+/* Add an erase block size, keeping the list sorted by size */
+static void spi_flash_add_erase_type(struct spi_flash *flash, u32 size, u8 cmd)
+{
+	struct spi_flash_erase_type *types = flash->erase_types;
+	int i, j;
+
+	if (size < flash->erase_size || size % flash->erase_size)
+		return;
+	for (i = 0; i < SPI_FLASH_MAX_ERASE_TYPES && types[i].size; i++) {
+		if (types[i].size == size)
+			return;
+		if (types[i].size > size)
+			break;
+	}
+	if (i == SPI_FLASH_MAX_ERASE_TYPES ||
+	    types[SPI_FLASH_MAX_ERASE_TYPES - 1].size)
+		return;
+
+	for (j = SPI_FLASH_MAX_ERASE_TYPES - 1; j > i; j--)
+		types[j] = types[j - 1];
+	types[i].size = size;
+	types[i].cmd = cmd;
+}
+
+/*
+ * Map a 3-byte address opcode to its 4-byte address equivalent, if the 4BAIT
+ * support bits in @bait say the part has it. SFDP erase types carry their
+ * own 4-byte opcodes in @erase_cmd_4b; the table only covers erase opcodes
+ * of parts without a 4BAIT.
+ */
+static int spi_flash_convert_4b_opcode(u8 opcode, u32 bait,
+				       const u8 *erase_cmd,
+				       const u8 *erase_cmd_4b)
+{
+	static const struct {
+		u8 cmd;
+		u8 cmd_4b;
+		u32 bait;
+	} table[] = {
+		{ CMD_READ_ARRAY_SLOW, CMD_READ_ARRAY_SLOW_4B,
+		  SFDP_4BAIT_READ },
+		{ CMD_READ_ARRAY_FAST, CMD_READ_ARRAY_FAST_4B,
+		  SFDP_4BAIT_READ_FAST },
+		{ CMD_READ_DUAL_OUTPUT_FAST, CMD_READ_DUAL_OUTPUT_FAST_4B,
+		  SFDP_4BAIT_READ_1_1_2 },
+		{ CMD_READ_DUAL_IO_FAST, CMD_READ_DUAL_IO_FAST_4B,
+		  SFDP_4BAIT_READ_1_2_2 },
+		{ CMD_READ_QUAD_OUTPUT_FAST, CMD_READ_QUAD_OUTPUT_FAST_4B,
+		  SFDP_4BAIT_READ_1_1_4 },
+		{ CMD_READ_QUAD_IO_FAST, CMD_READ_QUAD_IO_FAST_4B,
+		  SFDP_4BAIT_READ_1_4_4 },
+		{ CMD_PAGE_PROGRAM, CMD_PAGE_PROGRAM_4B, SFDP_4BAIT_PP },
+		{ CMD_QUAD_PAGE_PROGRAM, CMD_QUAD_PAGE_PROGRAM_4B,
+		  SFDP_4BAIT_PP_1_1_4 },
+		{ CMD_ERASE_4K, CMD_ERASE_4K_4B, 0 },
+		{ CMD_ERASE_32K, CMD_ERASE_32K_4B, 0 },
+		{ CMD_ERASE_64K, CMD_ERASE_64K_4B, 0 },
+	};
+	int i;
+
+	for (i = 0; erase_cmd && i < SFDP_ERASE_TYPES; i++) {
+		if (erase_cmd_4b[i] && erase_cmd[i] == opcode)
+			return erase_cmd_4b[i];
+	}
+
+	for (i = 0; i < ARRAY_SIZE(table); i++) {
+		if (table[i].cmd != opcode)
+			continue;
+		if (bait != SFDP_4BAIT_ALL && !(bait & table[i].bait))
+			break;
+		return table[i].cmd_4b;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * Switch to 4-byte addresses if every read, program and erase opcode in use
+ * has a 4-byte address form. Otherwise the part stays in 3-byte mode, with
+ * the bank register if it has one.
+ */
+static int spi_flash_set_4b_opcodes(struct spi_flash *flash, u32 bait,
+				    const u8 *erase_cmd, const u8 *erase_cmd_4b)
+{
+	int cmd[3 + SPI_FLASH_MAX_ERASE_TYPES];
+	int i;
+
+	cmd[0] = flash->read_cmd;
+	cmd[1] = flash->write_cmd;
+	cmd[2] = flash->erase_cmd;
+	for (i = 0; i < SPI_FLASH_MAX_ERASE_TYPES; i++)
+		cmd[3 + i] = flash->erase_types[i].cmd;
+
+	for (i = 0; i < ARRAY_SIZE(cmd); i++) {
+		if (i >= 3 && !flash->erase_types[i - 3].size)
+			continue;
+		cmd[i] = spi_flash_convert_4b_opcode(cmd[i], bait, erase_cmd,
+						     erase_cmd_4b);
+		if (cmd[i] < 0) {
+			debug("SF: no 4-byte address opcode, using 3-byte\n");
+			return cmd[i];
+		}
+	}
+
+	flash->read_cmd = cmd[0];
+	flash->write_cmd = cmd[1];
+	flash->erase_cmd = cmd[2];
+	for (i = 0; i < SPI_FLASH_MAX_ERASE_TYPES; i++)
+		flash->erase_types[i].cmd = cmd[3 + i];
+	flash->addr_width = SPI_FLASH_4B_ADDR_LEN;
+
+	return 0;
+}
+
 int spi_flash_scan(struct spi_flash *flash)
 {
 	struct spi_slave *spi = flash->spi;
 	const struct spi_flash_info *info = NULL;
-	int ret;
-
-	info = spi_flash_read_id(flash);
-	if (IS_ERR_OR_NULL(info))
+	u8 id[SPI_FLASH_MAX_ID_LEN];
+#ifdef CONFIG_SPI_FLASH_SFDP
+	struct spi_flash_info sfdp_info;
+	struct sfdp_params params;
+	bool have_sfdp = false;
+	u16 table_flags = 0;
+#endif
+	int i, ret;
+
+	info = spi_flash_read_id(flash, id);
+#ifdef CONFIG_SPI_FLASH_SFDP
+	if ((!IS_ERR(info) || PTR_ERR(info) == -ENODEV) &&
+	    flash->dual_flash == SF_SINGLE_FLASH &&
+	    !spi_flash_parse_sfdp(flash, &params) &&
+	    !spi_flash_sfdp_info(IS_ERR(info) ? NULL : info, id, &params,
+				 &sfdp_info)) {
+		table_flags = IS_ERR(info) ? 0 : info->flags;
+		info = &sfdp_info;
+		have_sfdp = true;
+	}
+#endif
+	if (IS_ERR_OR_NULL(info)) {
+		if (PTR_ERR(info) == -ENODEV)
+			printf("SF: unrecognized JEDEC id bytes: %02x, %02x, %02x\n",
+			       id[0], id[1], id[2]);
 		return -ENOENT;
+	}
 
 	/* Flash powers up read-only, so clear BP# bits */
 	if (JEDEC_MFR(info) == SPI_FLASH_CFI_MFR_ATMEL ||
@@ -1018,6 +1513,20 @@ int spi_flash_scan(struct spi_flash *flash)
 		flash->erase_size = flash->sector_size;
 	}
 
+	/*
+	 * Larger erase blocks let erase operations use fewer commands: the
+	 * sector erase, plus anything else SFDP describes
+	 */
+	spi_flash_add_erase_type(flash, flash->erase_size, flash->erase_cmd);
+	spi_flash_add_erase_type(flash, flash->sector_size, CMD_ERASE_64K);
+#ifdef CONFIG_SPI_FLASH_SFDP
+	if (have_sfdp) {
+		for (i = 0; i < SFDP_ERASE_TYPES; i++)
+			spi_flash_add_erase_type(flash, params.erase_size[i],
+						 params.erase_cmd[i]);
+	}
+#endif
+
 	/* Now erase size becomes valid sector size */
 	flash->sector_size = flash->erase_size;
 
@@ -1042,6 +1551,17 @@ int spi_flash_scan(struct spi_flash *flash)
 	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST) ||
 	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)) {
 		ret = set_quad_mode(flash, info);
+#ifdef CONFIG_SPI_FLASH_SFDP
+		/*
+		 * If only SFDP offered the quad read and the quad enable bit
+		 * cannot be set, stay with the fast read
+		 */
+		if (ret && !(table_flags & RD_QUAD) &&
+		    flash->write_cmd != CMD_QUAD_PAGE_PROGRAM) {
+			flash->read_cmd = CMD_READ_ARRAY_FAST;
+			ret = 0;
+		}
+#endif
 		if (ret) {
 			debug("SF: Fail to set QEB for %02x\n",
 			      JEDEC_MFR(info));
@@ -1068,6 +1588,37 @@ int spi_flash_scan(struct spi_flash *flash)
 		flash->dummy_byte = 1;
 	}
 
+#ifdef CONFIG_SPI_FLASH_SFDP
+	/* SFDP knows the actual dummy cycles of the multi-line reads */
+	if (have_sfdp) {
+		if (flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST &&
+		    (params.flags & RD_QUAD))
+			flash->dummy_byte = params.quad_dummy;
+		else if (flash->read_cmd == CMD_READ_DUAL_OUTPUT_FAST &&
+			 (params.flags & RD_DUAL))
+			flash->dummy_byte = params.dual_dummy;
+	}
+#endif
+
+	/*
+	 * Parts above 16MiB that have dedicated 4-byte address opcodes can
+	 * reach the whole array without going through the bank register,
+	 * which also lets reads cross the 16MiB boundaries in one transfer.
+	 */
+	flash->addr_width = SPI_FLASH_3B_ADDR_LEN;
+	if ((info->flags & OPS_4B) &&
+	    (flash->size >> flash->shift) > SPI_FLASH_16MB_BOUN) {
+#ifdef CONFIG_SPI_FLASH_SFDP
+		if (have_sfdp && params.bait)
+			spi_flash_set_4b_opcodes(flash, params.bait,
+						 params.erase_cmd,
+						 params.erase_cmd_4b);
+		else
+#endif
+			spi_flash_set_4b_opcodes(flash, SFDP_4BAIT_ALL, NULL,
+						 NULL);
+	}
+
 #ifdef CONFIG_SPI_FLASH_STMICRO
 	if (info->flags & E_FSR)
 		flash->flags |= SNOR_F_USE_FSR;
@@ -1075,9 +1626,11 @@ int spi_flash_scan(struct spi_flash *flash)
 
 	/* Configure the BAR - discover bank cmds and read current bank */
 #ifdef CONFIG_SPI_FLASH_BAR
-	ret = read_bar(flash, info);
-	if (ret < 0)
-		return ret;
+	if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN) {
+		ret = read_bar(flash, info);
+		if (ret < 0)
+			return ret;
+	}
 #endif
 
 #if CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)
@@ -1088,6 +1641,11 @@ int spi_flash_scan(struct spi_flash *flash)
 	}
 #endif
 
+#ifdef CONFIG_DM_SPI
+	if (!flash->memory_map)
+		spi_flash_get_mmap(flash);
+#endif
+
 #ifndef CONFIG_SPL_BUILD
 	printf("SF: Detected %s with page size ", flash->name);
 	print_size(flash->page_size, ", erase size ");
@@ -1099,10 +1657,11 @@ int spi_flash_scan(struct spi_flash *flash)
 #endif
 
 #ifndef CONFIG_SPI_FLASH_BAR
-	if (((flash->dual_flash == SF_SINGLE_FLASH) &&
-	     (flash->size > SPI_FLASH_16MB_BOUN)) ||
+	if ((flash->addr_width == SPI_FLASH_3B_ADDR_LEN) &&
+	    (((flash->dual_flash == SF_SINGLE_FLASH) &&
+	      (flash->size > SPI_FLASH_16MB_BOUN)) ||
 	     ((flash->dual_flash > SF_SINGLE_FLASH) &&
-	     (flash->size > SPI_FLASH_16MB_BOUN << 1))) {
+	      (flash->size > SPI_FLASH_16MB_BOUN << 1)))) {
 		puts("SF: Warning - Only lower 16MiB accessible,");
 		puts(" Full access #define CONFIG_SPI_FLASH_BAR\n");
 	}
@@ -829,6 +829,8 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_prefetch_hdrs(ubi, pnum);
+
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1239,15 +1241,30 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!vidh)
 		goto out_ech;
 
+	/*
+	 * Read both headers at once where they share a min. I/O unit. Not
+	 * fatal if this fails, headers are then read one by one.
+	 */
+	ubi->hdr_buf_len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+	if (ubi->hdr_buf_len <= ubi->min_io_size)
+		ubi->hdr_buf = kmalloc(ubi->hdr_buf_len, GFP_KERNEL);
+	ubi->hdr_buf_pnum = -1;
+
+	err = 0;
 	for (pnum = start; pnum < ubi->peb_count; pnum++) {
 		cond_resched();
 
 		dbg_gen("process PEB %d", pnum);
 		err = scan_peb(ubi, ai, pnum, NULL, NULL);
 		if (err < 0)
-			goto out_vidh;
+			break;
 	}
 
+	kfree(ubi->hdr_buf);
+	ubi->hdr_buf = NULL;
+	if (err < 0)
+		goto out_vidh;
+
 	ubi_msg(ubi, "scanning is finished");
 
 	/* Calculate mean erase counter */
@@ -1399,6 +1416,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+	ulong start = get_timer(0), scan_end, vtbl_end, wl_end;
 
 	ai = alloc_ai();
 	if (!ai)
@@ -1433,6 +1451,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 #endif
 	if (err)
 		goto out_ai;
+	scan_end = get_timer(0);
 
 	ubi->bad_peb_count = ai->bad_peb_count;
 	ubi->good_peb_count = ubi->peb_count - ubi->bad_peb_count;
@@ -1444,15 +1463,21 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	err = ubi_read_volume_table(ubi, ai);
 	if (err)
 		goto out_ai;
+	vtbl_end = get_timer(0);
 
 	err = ubi_wl_init(ubi, ai);
 	if (err)
 		goto out_vtbl;
+	wl_end = get_timer(0);
 
 	err = ubi_eba_init(ubi, ai);
 	if (err)
 		goto out_wl;
 
+	ubi_msg(ubi, "attached in %lu ms (scan %lu, volume table %lu, wear-leveling %lu, EBA %lu)",
+		get_timer(start), scan_end - start, vtbl_end - scan_end,
+		wl_end - vtbl_end, get_timer(wl_end));
+
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	if (ubi->fm && ubi_dbg_chk_fastmap(ubi)) {
 		struct ubi_attach_info *scan_ai;
@@ -154,6 +154,18 @@ int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
 	 */
 	*((uint8_t *)buf) ^= 0xFF;
 
+	if (ubi->hdr_buf && pnum == ubi->hdr_buf_pnum &&
+	    offset + len <= ubi->hdr_buf_len) {
+		memcpy(buf, ubi->hdr_buf + offset, len);
+		err = ubi->hdr_buf_err;
+		if (mtd_is_eccerr(err))
+			ubi_err(ubi, "error %d (ECC error) while reading %d bytes from PEB %d:%d",
+				err, len, pnum, offset);
+		else if (!err && ubi_dbg_is_bitflip(ubi))
+			err = UBI_IO_BITFLIPS;
+		return err;
+	}
+
 	addr = (loff_t)pnum * ubi->peb_size + offset;
 retry:
 	err = mtd_read(ubi->mtd, addr, len, &read, buf);
@@ -207,6 +219,47 @@ retry:
 	return err;
 }
 
+/**
+ * ubi_io_prefetch_hdrs - read the EC and VID headers of a PEB at once.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock number to prefetch
+ *
+ * When attaching, the EC header of every PEB is read, followed by its VID
+ * header unless the PEB is empty or broken. If both headers sit in the same
+ * min. I/O unit, @ubi->hdr_buf is allocated and this function reads that unit
+ * once: reading just the EC header would cost the same page read, and the VID
+ * header then comes for free. Following ubi_io_read() calls within that area
+ * of @pnum are served from @ubi->hdr_buf, with the result of this read, so a
+ * bit-flip or an ECC error is reported for both headers without reading the
+ * page again. Only if the driver fails in some other way, the headers are
+ * read one by one.
+ */
+void ubi_io_prefetch_hdrs(struct ubi_device *ubi, int pnum)
+{
+	int err, retries = 0;
+	size_t read;
+
+	ubi->hdr_buf_pnum = -1;
+	if (!ubi->hdr_buf || self_check_not_bad(ubi, pnum))
+		return;
+
+	do {
+		err = mtd_read(ubi->mtd, (loff_t)pnum * ubi->peb_size,
+			       ubi->hdr_buf_len, &read, ubi->hdr_buf);
+	} while (mtd_is_eccerr(err) && retries++ < UBI_IO_RETRIES);
+
+	if (read != ubi->hdr_buf_len ||
+	    (err && !mtd_is_bitflip(err) && !mtd_is_eccerr(err)))
+		return;
+
+	if (mtd_is_bitflip(err)) {
+		ubi_msg(ubi, "fixable bit-flip detected at PEB %d", pnum);
+		err = UBI_IO_BITFLIPS;
+	}
+	ubi->hdr_buf_err = err;
+	ubi->hdr_buf_pnum = pnum;
+}
+
 /**
  * ubi_io_write - write data to a physical eraseblock.
  * @ubi: UBI device description object
@@ -524,6 +524,10 @@ struct ubi_debug_info {
  * @peb_buf: a buffer of PEB size used for different purposes
  * @buf_mutex: protects @peb_buf
  * @ckvol_mutex: serializes static volume checking when opening
+ * @hdr_buf: headers of PEB @hdr_buf_pnum, prefetched while attaching
+ * @hdr_buf_len: size of @hdr_buf, covers the EC and VID headers
+ * @hdr_buf_pnum: PEB held in @hdr_buf, %-1 if none
+ * @hdr_buf_err: result of reading @hdr_buf, as returned by ubi_io_read()
  *
  * @dbg: debugging information for this UBI device
  */
@@ -623,6 +627,10 @@ struct ubi_device {
 	void *peb_buf;
 	struct mutex buf_mutex;
 	struct mutex ckvol_mutex;
+	void *hdr_buf;
+	int hdr_buf_len;
+	int hdr_buf_pnum;
+	int hdr_buf_err;
 
 	struct ubi_debug_info dbg;
 };
@@ -882,6 +890,7 @@ int ubi_ensure_anchor_pebs(struct ubi_device *ubi);
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
 		int len);
+void ubi_io_prefetch_hdrs(struct ubi_device *ubi, int pnum);
 int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 		 int len);
 int ubi_io_sync_erase(struct ubi_device *ubi, int pnum, int torture);
@@ -12,6 +12,7 @@
 #include <errno.h>
 #include <ubispl.h>
 
+#include <asm/unaligned.h>
 #include <linux/crc32.h>
 
 #include "ubispl.h"
@@ -245,7 +246,9 @@ static int assign_aeb_to_av(struct ubi_scan_info *ubi, u32 pnum, u32 lnum,
 	return ubi_scan_vid_hdr(ubi, vh, pnum);
 }
 
-static int scan_pool(struct ubi_scan_info *ubi, __be32 *pebs, int pool_size)
+/* @pebs points into the packed fastmap pool, so it may be unaligned */
+static int scan_pool(struct ubi_scan_info *ubi, const void *pebs,
+		     int pool_size)
 {
 	struct ubi_vid_hdr *vh;
 	u32 pnum;
@@ -254,7 +257,7 @@ static int scan_pool(struct ubi_scan_info *ubi, __be32 *pebs, int pool_size)
 	ubi_dbg("Scanning pool size: %d", pool_size);
 
 	for (i = 0; i < pool_size; i++) {
-		pnum = be32_to_cpu(pebs[i]);
+		pnum = get_unaligned_be32(pebs + i * sizeof(__be32));
 
 		if (ubi_io_is_bad(ubi, pnum)) {
 			ubi_err("FM: Bad PEB in fastmap pool! %u", pnum);
@@ -575,19 +578,20 @@ static int ubi_scan_fastmap(struct ubi_scan_info *ubi,
 			goto free_hdr;
 		}
 #endif
-		ret = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		/*
+		 * Mainline code rescans the anchor header. We've done
+		 * that already, so read into the block info, which
+		 * returns the cached header for scanned blocks and
+		 * keeps it valid for a later full scan, and copy it
+		 * over.
+		 */
+		ret = ubi_io_read_vid_hdr(ubi, pnum, ubi->blockinfo + pnum, 0);
 		if (ret && ret != UBI_IO_BITFLIPS) {
 			ubi_err("unable to read fastmap block# %i (PEB: %i)",
 				i, pnum);
 			goto free_hdr;
 		}
-
-		/*
-		 * Mainline code rescans the anchor header. We've done
-		 * that already so we merily copy it over.
-		 */
-		if (pnum == fm_anchor)
-			memcpy(vh, ubi->blockinfo + pnum, sizeof(*fm));
+		memcpy(vh, ubi->blockinfo + pnum, sizeof(*vh));
 
 		if (i == 0) {
 			if (be32_to_cpu(vh->vol_id) != UBI_FM_SB_VOLUME_ID) {
@@ -870,14 +874,39 @@ static int ipl_load(struct ubi_scan_info *ubi, const u32 vol_id, uint8_t *laddr)
 	return len;
 }
 
+/*
+ * Blocks are also marked corrupt when their data or block count does not
+ * match what a stale fastmap claims. Unmark the blocks with an intact VID
+ * header, so that the full scan checks them again against its own view of
+ * the volume. Blocks which could not be read or have a bad header stay
+ * marked, as rereading them would give the same result.
+ */
+static void ubi_forget_fm_corrupt(struct ubi_scan_info *ubi)
+{
+	struct ubi_vid_hdr *vh;
+	int pnum;
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		if (!test_bit(pnum, ubi->corrupt))
+			continue;
+
+		vh = ubi->blockinfo + pnum;
+		if (be32_to_cpu(vh->magic) != UBI_VID_HDR_MAGIC ||
+		    crc32(UBI_CRC32_INIT, vh, UBI_VID_HDR_SIZE_CRC) !=
+		    be32_to_cpu(vh->hdr_crc))
+			continue;
+
+		generic_clear_bit(pnum, ubi->corrupt);
+	}
+}
+
 int ubispl_load_volumes(struct ubispl_info *info, struct ubispl_load *lvols,
 			int nrvols)
 {
 	struct ubi_scan_info *ubi = info->ubi;
-	int res, i, fastmap = info->fastmap;
+	int res, i;
 	u32 fsize;
 
-retry:
 	/*
 	 * We do a partial initializiation of @ubi. Cleaning fm_buf is
 	 * not necessary.
@@ -898,7 +927,7 @@ retry:
 
 	/* Fastmap init */
 	ubi->fm_size = ubi_calc_fm_size(ubi);
-	ubi->fm_enabled = fastmap;
+	ubi->fm_enabled = info->fastmap;
 
 	for (i = 0; i < nrvols; i++) {
 		struct ubispl_load *lv = lvols + i;
@@ -906,6 +935,7 @@ retry:
 		generic_set_bit(lv->vol_id, ubi->toload);
 	}
 
+rescan:
 	ipl_scan(ubi);
 
 	for (i = 0; i < nrvols; i++) {
@@ -914,9 +944,20 @@ retry:
 		ubi_msg("Loading VolId #%d", lv->vol_id);
 		res = ipl_load(ubi, lv->vol_id, lv->load_addr);
 		if (res < 0) {
-			if (fastmap) {
-				fastmap = 0;
-				goto retry;
+			if (ubi->fm_enabled) {
+				/*
+				 * The fastmap did not describe the
+				 * volume correctly. Drop the volume
+				 * information, but keep the VID headers
+				 * we have read already, so the full scan
+				 * only reads the blocks which were not
+				 * covered by the fastmap.
+				 */
+				ubi_forget_fm_corrupt(ubi);
+				memset(ubi->volinfo, 0, sizeof(ubi->volinfo));
+				ubi->fm_enabled = 0;
+				ubi->fm = NULL;
+				goto rescan;
 			}
 			ubi_warn("Failed");
 			return res;
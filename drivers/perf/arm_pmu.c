@@ -0,0 +1,271 @@
+/*
+ * ARMv7 and ARMv8 Performance Monitors Unit
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <perf.h>
+#include <asm/system.h>
+
+#define PMCR_E		(1 << 0)	/* Enable all counters */
+#define PMCR_P		(1 << 1)	/* Reset event counters */
+#define PMCR_C		(1 << 2)	/* Reset cycle counter */
+#define PMCR_D		(1 << 3)	/* Count every 64th cycle */
+#define PMCR_LC		(1 << 6)	/* 64-bit cycle counter (ARMv8) */
+#define PMCR_N_SHIFT	11		/* Number of event counters */
+#define PMCR_N_MASK	0x1f
+
+#define PMU_CYCLE_COUNTER	31	/* Bit for the cycle counter */
+
+/*
+ * Accessors for the PMU registers, which are in CP15 c9 on ARMv7 and are
+ * system registers on ARMv8. PMOVSR on ARMv7 behaves like PMOVSCLR_EL0.
+ */
+#ifdef CONFIG_ARM64
+#define PMU_REG(name, crm, op2)						\
+static inline ulong read_##name(void)					\
+{									\
+	ulong val;							\
+									\
+	asm volatile("mrs %0, " #name "_el0" : "=r" (val));		\
+	return val;							\
+}									\
+									\
+static inline void write_##name(ulong val)				\
+{									\
+	asm volatile("msr " #name "_el0, %0" : : "r" (val));		\
+}
+
+/* Count in EL2 as well as EL1 and EL3 */
+#define PMU_FILTER	(1 << 27)
+/* Let the cycle counter use all 64 bits instead of overflowing at 32 */
+#define PMU_PMCR	PMCR_LC
+#else
+#define PMU_REG(name, crm, op2)						\
+static inline ulong read_##name(void)					\
+{									\
+	ulong val;							\
+									\
+	asm volatile("mrc p15, 0, %0, c9, " #crm ", " #op2 : "=r" (val)); \
+	return val;							\
+}									\
+									\
+static inline void write_##name(ulong val)				\
+{									\
+	asm volatile("mcr p15, 0, %0, c9, " #crm ", " #op2 : : "r" (val)); \
+}
+
+#define PMU_FILTER	0
+#define PMU_PMCR	0
+#endif
+
+PMU_REG(pmcr, c12, 0)
+PMU_REG(pmcntenset, c12, 1)
+PMU_REG(pmcntenclr, c12, 2)
+PMU_REG(pmovsclr, c12, 3)
+PMU_REG(pmselr, c12, 5)
+PMU_REG(pmccntr, c13, 0)
+PMU_REG(pmxevtyper, c13, 1)
+PMU_REG(pmxevcntr, c13, 2)
+
+/*
+ * Hardware event numbers for each event, 0 if not supported. Cycles use
+ * the cycle counter.
+ */
+struct arm_pmu_events {
+	u8 event[PERF_EVENT_COUNT];
+};
+
+#ifdef CONFIG_ARM64
+static const struct arm_pmu_events armv8_events = {
+	.event = {
+		[PERF_EVENT_INSTRUCTIONS]	= 0x08,	/* INST_RETIRED */
+		[PERF_EVENT_CACHE_REFS]		= 0x04,	/* L1D_CACHE */
+		[PERF_EVENT_CACHE_MISSES]	= 0x03,	/* L1D_CACHE_REFILL */
+		[PERF_EVENT_BRANCHES]		= 0x12,	/* BR_PRED */
+		[PERF_EVENT_BRANCH_MISSES]	= 0x10,	/* BR_MIS_PRED */
+	},
+};
+#else
+static const struct arm_pmu_events armv7_events = {
+	.event = {
+		[PERF_EVENT_INSTRUCTIONS]	= 0x08,	/* INST_RETIRED */
+		[PERF_EVENT_CACHE_REFS]		= 0x04,	/* L1D_CACHE */
+		[PERF_EVENT_CACHE_MISSES]	= 0x03,	/* L1D_CACHE_REFILL */
+		[PERF_EVENT_BRANCHES]		= 0x0c,	/* PC_WRITE */
+		[PERF_EVENT_BRANCH_MISSES]	= 0x10,	/* BR_MIS_PRED */
+	},
+};
+
+/* The Cortex-A9 does not count retired instructions */
+static const struct arm_pmu_events cortex_a9_events = {
+	.event = {
+		[PERF_EVENT_INSTRUCTIONS]	= 0x68,	/* Renamed instrs */
+		[PERF_EVENT_CACHE_REFS]		= 0x04,	/* L1D_CACHE */
+		[PERF_EVENT_CACHE_MISSES]	= 0x03,	/* L1D_CACHE_REFILL */
+		[PERF_EVENT_BRANCHES]		= 0x0c,	/* PC_WRITE */
+		[PERF_EVENT_BRANCH_MISSES]	= 0x10,	/* BR_MIS_PRED */
+	},
+};
+#endif
+
+/**
+ * struct arm_pmu_priv - private data for the PMU
+ *
+ * @events:	Hardware event numbers for this CPU
+ * @counter:	Counter used for each event being counted
+ * @enabled:	Mask of counters enabled
+ * @wraps:	Counts lost to wraps of each event's 32-bit counter
+ */
+struct arm_pmu_priv {
+	const struct arm_pmu_events *events;
+	uint counter[PERF_EVENT_COUNT];
+	ulong enabled;
+	u64 wraps[PERF_EVENT_COUNT];
+};
+
+static int arm_pmu_start(struct udevice *dev, uint events)
+{
+	struct arm_pmu_priv *priv = dev_get_priv(dev);
+	int event, counter = 0;
+
+	write_pmcntenclr(~0UL);
+	write_pmovsclr(~0UL);
+	priv->enabled = 0;
+	memset(priv->wraps, '\0', sizeof(priv->wraps));
+	for (event = 0; event < PERF_EVENT_COUNT; event++) {
+		if (!(events & (1 << event)))
+			continue;
+		if (event == PERF_EVENT_CYCLES) {
+			priv->counter[event] = PMU_CYCLE_COUNTER;
+		} else {
+			write_pmselr(counter);
+			isb();
+			write_pmxevtyper(priv->events->event[event] |
+					 PMU_FILTER);
+			priv->counter[event] = counter++;
+		}
+		priv->enabled |= 1UL << priv->counter[event];
+	}
+#ifdef CONFIG_ARM64
+	asm volatile("msr pmccfiltr_el0, %0" : : "r" ((ulong)PMU_FILTER));
+#endif
+	write_pmcr((read_pmcr() & ~PMCR_D) | PMCR_E | PMCR_P | PMCR_C |
+		   PMU_PMCR);
+	isb();
+	write_pmcntenset(priv->enabled);
+
+	return 0;
+}
+
+static int arm_pmu_stop(struct udevice *dev)
+{
+	struct arm_pmu_priv *priv = dev_get_priv(dev);
+
+	write_pmcntenclr(priv->enabled);
+	isb();
+
+	return 0;
+}
+
+static u64 arm_pmu_read_counter(uint counter)
+{
+	if (counter == PMU_CYCLE_COUNTER)
+		return read_pmccntr();
+	write_pmselr(counter);
+	isb();
+
+	return (u32)read_pmxevcntr();
+}
+
+/*
+ * The event counters, and the cycle counter on ARMv7, are 32 bits wide and
+ * wrap after a few seconds. Each wrap sets the counter's overflow flag,
+ * which is turned into 2^32 more counts when the counter is read. Only one
+ * wrap is seen between two reads, so counts are exact as long as a counter
+ * is read at least once per 2^32 events, about 4 seconds of cycles at 1GHz.
+ */
+static int arm_pmu_read(struct udevice *dev, enum perf_event_id event,
+			u64 *countp)
+{
+	struct arm_pmu_priv *priv = dev_get_priv(dev);
+	uint counter = priv->counter[event];
+	ulong bit = 1UL << counter;
+	u64 count;
+
+	/* The ARMv8 cycle counter has 64 bits, see PMCR_LC */
+	if (IS_ENABLED(CONFIG_ARM64) && counter == PMU_CYCLE_COUNTER) {
+		*countp = read_pmccntr();
+		return 0;
+	}
+
+	/* Read again if the counter wrapped while it was read */
+	do {
+		if (read_pmovsclr() & bit) {
+			write_pmovsclr(bit);
+			priv->wraps[event] += 1ULL << 32;
+		}
+		count = arm_pmu_read_counter(counter);
+		isb();
+	} while (read_pmovsclr() & bit);
+	*countp = priv->wraps[event] + count;
+
+	return 0;
+}
+
+static int arm_pmu_probe(struct udevice *dev)
+{
+	struct perf_uc_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct arm_pmu_priv *priv = dev_get_priv(dev);
+	uint counters;
+	int event;
+
+	priv->events = (const struct arm_pmu_events *)dev_get_driver_data(dev);
+	counters = (read_pmcr() >> PMCR_N_SHIFT) & PMCR_N_MASK;
+
+	uc_priv->events = 1 << PERF_EVENT_CYCLES;
+	if (counters) {
+		for (event = 0; event < PERF_EVENT_COUNT; event++) {
+			if (priv->events->event[event])
+				uc_priv->events |= 1 << event;
+		}
+	}
+	uc_priv->counters = counters;
+	uc_priv->cycle_counter = true;
+
+	return 0;
+}
+
+static const struct perf_ops arm_pmu_ops = {
+	.start	= arm_pmu_start,
+	.stop	= arm_pmu_stop,
+	.read	= arm_pmu_read,
+};
+
+static const struct udevice_id arm_pmu_ids[] = {
+#ifdef CONFIG_ARM64
+	{ .compatible = "arm,armv8-pmuv3", .data = (ulong)&armv8_events },
+	{ .compatible = "arm,cortex-a53-pmu", .data = (ulong)&armv8_events },
+	{ .compatible = "arm,cortex-a57-pmu", .data = (ulong)&armv8_events },
+	{ .compatible = "arm,cortex-a72-pmu", .data = (ulong)&armv8_events },
+#else
+	{ .compatible = "arm,cortex-a5-pmu", .data = (ulong)&armv7_events },
+	{ .compatible = "arm,cortex-a7-pmu", .data = (ulong)&armv7_events },
+	{ .compatible = "arm,cortex-a8-pmu", .data = (ulong)&armv7_events },
+	{ .compatible = "arm,cortex-a9-pmu", .data = (ulong)&cortex_a9_events },
+	{ .compatible = "arm,cortex-a15-pmu", .data = (ulong)&armv7_events },
+#endif
+	{ }
+};
+
+U_BOOT_DRIVER(arm_pmu) = {
+	.name	= "arm_pmu",
+	.id	= UCLASS_PERF,
+	.of_match = arm_pmu_ids,
+	.probe	= arm_pmu_probe,
+	.ops	= &arm_pmu_ops,
+	.priv_auto_alloc_size = sizeof(struct arm_pmu_priv),
+};
@@ -0,0 +1,93 @@
+/*
+ * Performance counter uclass
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <perf.h>
+
+static const char *const perf_event_name[PERF_EVENT_COUNT] = {
+	[PERF_EVENT_CYCLES]		= "cycles",
+	[PERF_EVENT_INSTRUCTIONS]	= "instructions",
+	[PERF_EVENT_CACHE_REFS]		= "cache-references",
+	[PERF_EVENT_CACHE_MISSES]	= "cache-misses",
+	[PERF_EVENT_BRANCHES]		= "branches",
+	[PERF_EVENT_BRANCH_MISSES]	= "branch-misses",
+};
+
+const char *perf_get_event_name(enum perf_event_id event)
+{
+	if (event < 0 || event >= PERF_EVENT_COUNT)
+		return "unknown";
+
+	return perf_event_name[event];
+}
+
+int perf_start(struct udevice *dev, uint events)
+{
+	struct perf_uc_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct perf_ops *ops = perf_get_ops(dev);
+	uint counting = 0;
+	int event, ret;
+	uint count;
+
+	if (!ops->start)
+		return -ENOSYS;
+
+	/*
+	 * Keep the first events which the device can count at once. Cycles
+	 * do not take up a counter on devices with a cycle counter.
+	 */
+	events &= uc_priv->events;
+	for (event = count = 0; event < PERF_EVENT_COUNT; event++) {
+		if (!(events & (1 << event)))
+			continue;
+		if (event == PERF_EVENT_CYCLES && uc_priv->cycle_counter) {
+			counting |= 1 << event;
+		} else if (count < uc_priv->counters) {
+			counting |= 1 << event;
+			count++;
+		}
+	}
+
+	uc_priv->counting = 0;
+	ret = ops->start(dev, counting);
+	if (ret)
+		return ret;
+	uc_priv->counting = counting;
+
+	return counting;
+}
+
+int perf_stop(struct udevice *dev)
+{
+	struct perf_ops *ops = perf_get_ops(dev);
+
+	if (!ops->stop)
+		return -ENOSYS;
+
+	return ops->stop(dev);
+}
+
+int perf_read(struct udevice *dev, enum perf_event_id event, u64 *countp)
+{
+	struct perf_uc_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct perf_ops *ops = perf_get_ops(dev);
+
+	if (event < 0 || event >= PERF_EVENT_COUNT ||
+	    !(uc_priv->counting & (1 << event)))
+		return -ENOENT;
+	if (!ops->read)
+		return -ENOSYS;
+
+	return ops->read(dev, event, countp);
+}
+
+UCLASS_DRIVER(perf) = {
+	.id		= UCLASS_PERF,
+	.name		= "perf",
+	.per_device_auto_alloc_size = sizeof(struct perf_uc_priv),
+};
@@ -0,0 +1,145 @@
+/*
+ * Sandbox performance counters, using the host's counters
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <os.h>
+#include <perf.h>
+
+/* Linux PERF_COUNT_HW_... values for each event */
+static const uint sandbox_perf_hw_event[PERF_EVENT_COUNT] = {
+	[PERF_EVENT_CYCLES]		= 0,	/* CPU_CYCLES */
+	[PERF_EVENT_INSTRUCTIONS]	= 1,	/* INSTRUCTIONS */
+	[PERF_EVENT_CACHE_REFS]		= 2,	/* CACHE_REFERENCES */
+	[PERF_EVENT_CACHE_MISSES]	= 3,	/* CACHE_MISSES */
+	[PERF_EVENT_BRANCHES]		= 4,	/* BRANCH_INSTRUCTIONS */
+	[PERF_EVENT_BRANCH_MISSES]	= 5,	/* BRANCH_MISSES */
+};
+
+/**
+ * struct sandbox_perf_priv - private data for the sandbox counters
+ *
+ * If the host does not allow access to its cycle counter, cycles are
+ * emulated with the host time, as if the CPU ran at 1GHz.
+ *
+ * @fd:		Host file descriptor for each event, -ve if not available
+ * @start_ns:	Host time when counting started, for emulated cycles
+ * @stop_ns:	Host time when counting stopped, or 0 if still counting
+ */
+struct sandbox_perf_priv {
+	int fd[PERF_EVENT_COUNT];
+	u64 start_ns;
+	u64 stop_ns;
+};
+
+static int sandbox_perf_start(struct udevice *dev, uint events)
+{
+	struct sandbox_perf_priv *priv = dev_get_priv(dev);
+	int event, ret;
+
+	for (event = 0; event < PERF_EVENT_COUNT; event++) {
+		if (!(events & (1 << event)) || priv->fd[event] < 0)
+			continue;
+		ret = os_perf_enable(priv->fd[event], 1);
+		if (ret)
+			return ret;
+	}
+	priv->stop_ns = 0;
+	priv->start_ns = os_get_nsec();
+
+	return 0;
+}
+
+static int sandbox_perf_stop(struct udevice *dev)
+{
+	struct sandbox_perf_priv *priv = dev_get_priv(dev);
+	int event;
+
+	priv->stop_ns = os_get_nsec();
+	for (event = 0; event < PERF_EVENT_COUNT; event++) {
+		if (priv->fd[event] >= 0)
+			os_perf_enable(priv->fd[event], 0);
+	}
+
+	return 0;
+}
+
+static int sandbox_perf_read(struct udevice *dev, enum perf_event_id event,
+			     u64 *countp)
+{
+	struct sandbox_perf_priv *priv = dev_get_priv(dev);
+
+	if (priv->fd[event] >= 0)
+		return os_perf_read(priv->fd[event], countp);
+
+	/* Emulated cycle counter */
+	*countp = (priv->stop_ns ? priv->stop_ns : os_get_nsec()) -
+		priv->start_ns;
+
+	return 0;
+}
+
+static int sandbox_perf_probe(struct udevice *dev)
+{
+	struct perf_uc_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct sandbox_perf_priv *priv = dev_get_priv(dev);
+	int event;
+
+	for (event = 0; event < PERF_EVENT_COUNT; event++) {
+		priv->fd[event] = os_perf_open(sandbox_perf_hw_event[event]);
+		if (priv->fd[event] >= 0)
+			uc_priv->events |= 1 << event;
+	}
+	if (priv->fd[PERF_EVENT_CYCLES] < 0)
+		debug("%s: Host cycle counter not available, emulating\n",
+		      __func__);
+	uc_priv->events |= 1 << PERF_EVENT_CYCLES;
+
+	/* The host multiplexes its counters, so we can count everything */
+	uc_priv->counters = PERF_EVENT_COUNT;
+
+	return 0;
+}
+
+static int sandbox_perf_remove(struct udevice *dev)
+{
+	struct sandbox_perf_priv *priv = dev_get_priv(dev);
+	int event;
+
+	for (event = 0; event < PERF_EVENT_COUNT; event++) {
+		if (priv->fd[event] >= 0)
+			os_close(priv->fd[event]);
+	}
+
+	return 0;
+}
+
+static const struct perf_ops sandbox_perf_ops = {
+	.start	= sandbox_perf_start,
+	.stop	= sandbox_perf_stop,
+	.read	= sandbox_perf_read,
+};
+
+static const struct udevice_id sandbox_perf_ids[] = {
+	{ .compatible = "sandbox,perf" },
+	{ }
+};
+
+U_BOOT_DRIVER(sandbox_perf) = {
+	.name	= "sandbox_perf",
+	.id	= UCLASS_PERF,
+	.of_match = sandbox_perf_ids,
+	.probe	= sandbox_perf_probe,
+	.remove	= sandbox_perf_remove,
+	.ops	= &sandbox_perf_ops,
+	.priv_auto_alloc_size = sizeof(struct sandbox_perf_priv),
+};
+
+/* This is here in case we don't have a device tree */
+U_BOOT_DEVICE(sandbox_perf_non_fdt) = {
+	.name = "sandbox_perf",
+};
@@ -0,0 +1,148 @@
+/*
+ * x86 architectural performance monitoring
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <perf.h>
+#include <asm/cpu.h>
+#include <asm/msr.h>
+#include <asm/msr-index.h>
+
+#define EVENTSEL_USR		(1 << 16)
+#define EVENTSEL_OS		(1 << 17)
+#define EVENTSEL_EN		(1 << 22)
+
+#define CPUID_PERFMON		0xa
+
+/**
+ * struct x86_pmu_event - an architectural event
+ *
+ * @event:	Event select value, including the unit mask
+ * @cpuid_bit:	Bit in CPUID leaf 0xa EBX which is set if not available
+ */
+struct x86_pmu_event {
+	u16 event;
+	u8 cpuid_bit;
+};
+
+static const struct x86_pmu_event x86_pmu_events[PERF_EVENT_COUNT] = {
+	[PERF_EVENT_CYCLES]		= { 0x003c, 0 },
+	[PERF_EVENT_INSTRUCTIONS]	= { 0x00c0, 1 },
+	[PERF_EVENT_CACHE_REFS]		= { 0x4f2e, 3 },
+	[PERF_EVENT_CACHE_MISSES]	= { 0x412e, 4 },
+	[PERF_EVENT_BRANCHES]		= { 0x00c4, 5 },
+	[PERF_EVENT_BRANCH_MISSES]	= { 0x00c5, 6 },
+};
+
+/**
+ * struct x86_pmu_priv - private data for the PMU
+ *
+ * @version:	Architectural performance monitoring version
+ * @width_mask:	Mask of valid bits in a counter
+ * @counter:	Counter used for each event being counted
+ * @used:	Number of counters in use
+ */
+struct x86_pmu_priv {
+	uint version;
+	u64 width_mask;
+	uint counter[PERF_EVENT_COUNT];
+	uint used;
+};
+
+static int x86_pmu_start(struct udevice *dev, uint events)
+{
+	struct x86_pmu_priv *priv = dev_get_priv(dev);
+	int event, counter = 0;
+
+	for (event = 0; event < PERF_EVENT_COUNT; event++) {
+		if (!(events & (1 << event)))
+			continue;
+		wrmsrl(MSR_ARCH_PERFMON_EVENTSEL0 + counter, 0);
+		wrmsrl(MSR_ARCH_PERFMON_PERFCTR0 + counter, 0);
+		wrmsrl(MSR_ARCH_PERFMON_EVENTSEL0 + counter,
+		       x86_pmu_events[event].event | EVENTSEL_USR |
+		       EVENTSEL_OS | EVENTSEL_EN);
+		priv->counter[event] = counter++;
+	}
+	priv->used = counter;
+
+	/* Later versions also have a global enable for each counter */
+	if (priv->version >= 2)
+		msr_setbits_64(MSR_CORE_PERF_GLOBAL_CTRL, (1 << counter) - 1);
+
+	return 0;
+}
+
+static int x86_pmu_stop(struct udevice *dev)
+{
+	struct x86_pmu_priv *priv = dev_get_priv(dev);
+	int counter;
+
+	for (counter = 0; counter < priv->used; counter++)
+		msr_clrbits_64(MSR_ARCH_PERFMON_EVENTSEL0 + counter,
+			       EVENTSEL_EN);
+
+	return 0;
+}
+
+static int x86_pmu_read(struct udevice *dev, enum perf_event_id event,
+			u64 *countp)
+{
+	struct x86_pmu_priv *priv = dev_get_priv(dev);
+
+	*countp = native_read_msr(MSR_ARCH_PERFMON_PERFCTR0 +
+				  priv->counter[event]) & priv->width_mask;
+
+	return 0;
+}
+
+static int x86_pmu_probe(struct udevice *dev)
+{
+	struct perf_uc_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct x86_pmu_priv *priv = dev_get_priv(dev);
+	uint eax, ebx, length;
+	int event;
+
+	if (cpuid_eax(0) < CPUID_PERFMON)
+		return -ENODEV;
+	eax = cpuid_eax(CPUID_PERFMON);
+	ebx = cpuid_ebx(CPUID_PERFMON);
+	priv->version = eax & 0xff;
+	uc_priv->counters = (eax >> 8) & 0xff;
+	priv->width_mask = (1ULL << ((eax >> 16) & 0xff)) - 1;
+	length = (eax >> 24) & 0xff;
+	if (!priv->version || !uc_priv->counters)
+		return -ENODEV;
+
+	for (event = 0; event < PERF_EVENT_COUNT; event++) {
+		uint bit = x86_pmu_events[event].cpuid_bit;
+
+		if (bit < length && !(ebx & (1 << bit)))
+			uc_priv->events |= 1 << event;
+	}
+
+	return 0;
+}
+
+static const struct perf_ops x86_pmu_ops = {
+	.start	= x86_pmu_start,
+	.stop	= x86_pmu_stop,
+	.read	= x86_pmu_read,
+};
+
+U_BOOT_DRIVER(x86_pmu) = {
+	.name	= "x86_pmu",
+	.id	= UCLASS_PERF,
+	.probe	= x86_pmu_probe,
+	.ops	= &x86_pmu_ops,
+	.priv_auto_alloc_size = sizeof(struct x86_pmu_priv),
+};
+
+/* The PMU is part of the CPU, so has no device tree node */
+U_BOOT_DEVICE(x86_pmu) = {
+	.name = "x86_pmu",
+};
@@ -15,6 +15,7 @@
 #include <asm/io.h>
 #include <dm.h>
 #include <errno.h>
+#include <linux/sizes.h>
 #include <asm/arch/stm32.h>
 #include <asm/arch/stm32_defs.h>
 
@@ -159,6 +160,7 @@ enum STM32_QSPI_CCR_FMODE {
 struct stm32_qspi_platdata {
 	u32 base;
 	u32 memory_map;
+	u32 memory_map_size;
 	u32 max_hz;
 };
 
@@ -432,6 +434,7 @@ static int stm32_qspi_ofdata_to_platdata(struct udevice *bus)
 
 	plat->base = res_regs.start;
 	plat->memory_map = res_mem.start;
+	plat->memory_map_size = res_mem.end - res_mem.start + 1;
 
 	debug("%s: regs=<0x%x> mapped=<0x%x>, max-frequency=%d\n",
 	      __func__,
@@ -602,12 +605,29 @@ static int stm32_qspi_set_mode(struct udevice *bus, uint mode)
 	return 0;
 }
 
+static int stm32_qspi_get_mmap(struct udevice *dev, ulong *map_basep,
+			       uint *map_sizep, uint *offsetp)
+{
+	struct stm32_qspi_platdata *plat = dev_get_platdata(dev->parent);
+
+	*map_basep = plat->memory_map;
+	/*
+	 * Memory-mapped reads are always issued with a 24-bit address (see
+	 * _stm32_qspi_gen_ccr()), so only the first 16MiB can be reached
+	 */
+	*map_sizep = min_t(uint, plat->memory_map_size, SZ_16M);
+	*offsetp = 0;
+
+	return 0;
+}
+
 static const struct dm_spi_ops stm32_qspi_ops = {
 	.claim_bus	= stm32_qspi_claim_bus,
 	.release_bus	= stm32_qspi_release_bus,
 	.xfer		= stm32_qspi_xfer,
 	.set_speed	= stm32_qspi_set_speed,
 	.set_mode	= stm32_qspi_set_mode,
+	.get_mmap	= stm32_qspi_get_mmap,
 };
 
 static const struct udevice_id stm32_qspi_ids[] = {
@@ -10,6 +10,7 @@
 #include <os.h>
 #include <scsi.h>
 #include <usb.h>
+#include <asm/test.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -52,6 +53,8 @@ enum {
  * @status_buff:	Data buffer for outgoing status
  * @buff_used:	Number of bytes ready to transfer back to host
  * @buff:	Data buffer for outgoing data
+ * @read_cmds:	Number of read commands received
+ * @max_read_len: Largest number of blocks requested by one read command
  */
 struct sandbox_flash_priv {
 	bool error;
@@ -65,6 +68,8 @@ struct sandbox_flash_priv {
 	struct umass_bbb_csw status;
 	int buff_used;
 	u8 buff[512];
+	uint read_cmds;
+	uint max_read_len;
 };
 
 struct sandbox_flash_plat {
@@ -230,6 +235,8 @@ static void handle_read(struct sandbox_flash_priv *priv, ulong lba,
 			ulong transfer_len)
 {
 	debug("%s: lba=%lx, transfer_len=%lx\n", __func__, lba, transfer_len);
+	priv->read_cmds++;
+	priv->max_read_len = max_t(uint, priv->max_read_len, transfer_len);
 	if (priv->fd != -1) {
 		os_lseek(priv->fd, lba * SANDBOX_FLASH_BLOCK_LEN, OS_SEEK_SET);
 		priv->read_len = transfer_len;
@@ -408,6 +415,18 @@ static int sandbox_flash_probe(struct udevice *dev)
 	return 0;
 }
 
+uint sandbox_usb_flash_get_reads(struct udevice *dev, uint *max_len)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+	uint reads = priv->read_cmds;
+
+	*max_len = priv->max_read_len;
+	priv->read_cmds = 0;
+	priv->max_read_len = 0;
+
+	return reads;
+}
+
 static const struct dm_usb_ops sandbox_usb_flash_ops = {
 	.control	= sandbox_flash_control,
 	.bulk		= sandbox_flash_bulk,
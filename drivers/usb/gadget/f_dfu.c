@@ -42,6 +42,9 @@ struct f_dfu {
 	/* Send/received block number is handy for data integrity check */
 	int                             blk_seq_num;
 	unsigned int                    poll_timeout;
+
+	/* ep0 buffer, while a block is received straight into the DFU one */
+	void				*req_buf;
 };
 
 struct dfu_entity *dfu_defer_flush;
@@ -153,12 +156,22 @@ static void dfu_set_poll_timeout(struct dfu_status *dstat, unsigned int ms)
 
 /*-------------------------------------------------------------------------*/
 
+static void dnload_restore_buf(struct f_dfu *f_dfu, struct usb_request *req)
+{
+	if (f_dfu->req_buf) {
+		req->buf = f_dfu->req_buf;
+		f_dfu->req_buf = NULL;
+	}
+}
+
 static void dnload_request_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct f_dfu *f_dfu = req->context;
+	void *buf = req->buf;
 	int ret;
 
-	ret = dfu_write(dfu_get_entity(f_dfu->altsetting), req->buf,
+	dnload_restore_buf(f_dfu, req);
+	ret = dfu_write(dfu_get_entity(f_dfu->altsetting), buf,
 			req->actual, f_dfu->blk_seq_num);
 	if (ret) {
 		f_dfu->dfu_status = DFU_STATUS_errUNKNOWN;
@@ -250,10 +263,18 @@ static int handle_dnload(struct usb_gadget *gadget, u16 len)
 	struct usb_composite_dev *cdev = get_gadget_data(gadget);
 	struct usb_request *req = cdev->req;
 	struct f_dfu *f_dfu = req->context;
+	void *buf;
 
 	if (len == 0)
 		f_dfu->dfu_state = DFU_STATE_dfuMANIFEST_SYNC;
 
+	/* Receive the block where dfu_write() would copy it to */
+	buf = dfu_get_write_ptr(dfu_get_entity(f_dfu->altsetting), len);
+	if (buf) {
+		f_dfu->req_buf = req->buf;
+		req->buf = buf;
+	}
+
 	req->complete = dnload_request_complete;
 
 	return len;
@@ -612,6 +633,7 @@ dfu_handle(struct usb_function *f, const struct usb_ctrlrequest *ctrl)
 		if (value < 0) {
 			debug("ep_queue --> %d\n", value);
 			req->status = 0;
+			dnload_restore_buf(f_dfu, req);
 		}
 	}
 
@@ -19,6 +19,7 @@
 #include <linux/usb/gadget.h>
 #include <linux/usb/composite.h>
 #include <linux/compiler.h>
+#include <linux/sizes.h>
 #include <version.h>
 #include <g_dnl.h>
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
@@ -27,6 +28,10 @@
 #ifdef CONFIG_FASTBOOT_FLASH_NAND_DEV
 #include <fb_nand.h>
 #endif
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+#include <image-sparse.h>
+#endif
+#include "req_pool.h"
 
 #define FASTBOOT_VERSION		"0.4"
 
@@ -45,12 +50,22 @@
  * that expect bulk OUT requests to be divisible by maxpacket size.
  */
 
+/*
+ * Downloads are received straight into the download buffer by a pool of
+ * requests of this size (a multiple of the maxpacket size as well)
+ */
+#define DL_REQ_SIZE			SZ_256K
+#define DL_REQ_COUNT			CONFIG_USB_GADGET_REQ_POOL_DEPTH
+
 struct f_fastboot {
 	struct usb_function usb_function;
 
 	/* IN/OUT EP's and corresponding requests */
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
+
+	/* OUT requests receiving the data of downloads */
+	struct usb_req_pool dl_pool;
 };
 
 static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
@@ -61,6 +76,23 @@ static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
 static struct f_fastboot *fastboot_func;
 static unsigned int download_size;
 static unsigned int download_bytes;
+static unsigned int download_queued;
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+enum {
+	STREAM_NONE,		/* Download is not streamed */
+	STREAM_START,		/* Waiting for the first data */
+	STREAM_SPARSE,		/* Sparse image, written as it arrives */
+	STREAM_RAM,		/* Other image, stored in the buffer */
+	STREAM_TOO_LARGE,	/* Other image, larger than the buffer */
+};
+
+static char stream_part[32];
+static bool stream_armed;
+static int stream_mode;
+static struct sparse_writer stream_writer;
+static char stream_response[FASTBOOT_RESPONSE_LEN];
+#endif
 
 static struct usb_endpoint_descriptor fs_ep_in = {
 	.bLength            = USB_DT_ENDPOINT_SIZE,
@@ -148,7 +180,11 @@ static struct usb_gadget_strings *fastboot_strings[] = {
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req);
 static int strcmp_l1(const char *s1, const char *s2);
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+static void fastboot_stream_disable(void);
+#endif
 
 
 static char *fb_response_str;
@@ -231,6 +267,11 @@ static void fastboot_disable(struct usb_function *f)
 	usb_ep_disable(f_fb->out_ep);
 	usb_ep_disable(f_fb->in_ep);
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	fastboot_stream_disable();
+#endif
+	download_size = 0;
+	usb_req_pool_free(&f_fb->dl_pool, 0);
 	if (f_fb->out_req) {
 		free(f_fb->out_req->buf);
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
@@ -265,7 +306,7 @@ static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
 static int fastboot_set_alt(struct usb_function *f,
 			    unsigned interface, unsigned alt)
 {
-	int ret;
+	int i, ret;
 	struct usb_composite_dev *cdev = f->config->cdev;
 	struct usb_gadget *gadget = cdev->gadget;
 	struct f_fastboot *f_fb = func_to_fastboot(f);
@@ -289,6 +330,15 @@ static int fastboot_set_alt(struct usb_function *f,
 	}
 	f_fb->out_req->complete = rx_handler_command;
 
+	/* Their buffers are set up for each download */
+	ret = usb_req_pool_alloc(&f_fb->dl_pool, f_fb->out_ep, DL_REQ_COUNT, 0);
+	if (ret) {
+		puts("failed to alloc download reqs\n");
+		goto err;
+	}
+	for (i = 0; i < f_fb->dl_pool.count; i++)
+		f_fb->dl_pool.reqs[i]->complete = rx_handler_dl_image;
+
 	d = fb_ep_desc(gadget, &fs_ep_in, &hs_ep_in);
 	ret = usb_ep_enable(f_fb->in_ep, d);
 	if (ret) {
@@ -446,16 +496,16 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 	fastboot_tx_write_str(response);
 }
 
-static unsigned int rx_bytes_expected(struct usb_ep *ep)
+static unsigned int rx_length(struct usb_ep *ep, int rx_remain,
+			      unsigned int max)
 {
-	int rx_remain = download_size - download_bytes;
 	unsigned int rem;
 	unsigned int maxpacket = ep->maxpacket;
 
 	if (rx_remain <= 0)
 		return 0;
-	else if (rx_remain > EP_BUFFER_SIZE)
-		return EP_BUFFER_SIZE;
+	else if (rx_remain > max)
+		return max;
 
 	/*
 	 * Some controllers e.g. DWC3 don't like OUT transfers to be
@@ -471,25 +521,10 @@ static unsigned int rx_bytes_expected(struct usb_ep *ep)
 }
 
 #define BYTES_PER_DOT	0x20000
-static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
+static void fastboot_dl_progress(unsigned int transfer_size)
 {
-	char response[FASTBOOT_RESPONSE_LEN];
-	unsigned int transfer_size = download_size - download_bytes;
-	const unsigned char *buffer = req->buf;
-	unsigned int buffer_size = req->actual;
 	unsigned int pre_dot_num, now_dot_num;
 
-	if (req->status != 0) {
-		printf("Bad status: %d\n", req->status);
-		return;
-	}
-
-	if (buffer_size < transfer_size)
-		transfer_size = buffer_size;
-
-	memcpy((void *)CONFIG_FASTBOOT_BUF_ADDR + download_bytes,
-	       buffer, transfer_size);
-
 	pre_dot_num = download_bytes / BYTES_PER_DOT;
 	download_bytes += transfer_size;
 	now_dot_num = download_bytes / BYTES_PER_DOT;
@@ -499,49 +534,212 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		if (!(now_dot_num % 74))
 			putc('\n');
 	}
+}
 
-	/* Check if transfer is done */
-	if (download_bytes >= download_size) {
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+/*
+ * Decide how to handle the download from its first data. The writer has
+ * been set up for the partition when streaming was armed.
+ */
+static int stream_begin(void *buf)
+{
+	if (!is_sparse_image(buf)) {
+		if (download_size > CONFIG_FASTBOOT_BUF_SIZE)
+			return STREAM_TOO_LARGE;
+		return STREAM_RAM;
+	}
+
+	return STREAM_SPARSE;
+}
+
+static void stream_data(void *buf, unsigned int len)
+{
+	if (stream_mode == STREAM_START)
+		stream_mode = stream_begin(buf);
+	if (stream_mode == STREAM_SPARSE) {
+		fb_response_str = stream_response;
+		sparse_writer_feed(&stream_writer, buf, len);
+	}
+}
+
+static void stream_end(void)
+{
+	if (stream_mode == STREAM_SPARSE) {
+		fb_response_str = stream_response;
+		sparse_writer_finish(&stream_writer);
+	}
+}
+
+static void fastboot_stream_disable(void)
+{
+	/* Release the buffers of an interrupted write */
+	if (stream_mode == STREAM_SPARSE && download_size) {
+		fb_response_str = stream_response;
+		sparse_writer_finish(&stream_writer);
+	}
+	stream_armed = false;
+	stream_mode = STREAM_NONE;
+}
+#endif
+
+/*
+ * Where the next request receives its data: the data normally goes to
+ * its place in the download buffer. When it may not be kept in RAM, each
+ * request of the pool uses a slot of its own at the start of the buffer.
+ * As the requests are queued in turn, the slot is free again once its
+ * request can be queued.
+ */
+static void *dl_buf(void)
+{
+	unsigned int offset = download_queued;
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	if (stream_mode != STREAM_NONE && stream_mode != STREAM_RAM)
+		offset %= DL_REQ_COUNT * DL_REQ_SIZE;
+#endif
+
+	return (void *)CONFIG_FASTBOOT_BUF_ADDR + offset;
+}
+
+/* Keep the download requests queued until all the data is requested */
+static void dl_queue(struct usb_ep *ep)
+{
+	struct usb_req_pool *pool = &fastboot_func->dl_pool;
+	void *buf_end = (void *)CONFIG_FASTBOOT_BUF_ADDR +
+			CONFIG_FASTBOOT_BUF_SIZE;
+	struct usb_request *req;
+	unsigned int remain;
+
+	while (download_queued < download_size) {
+		req = usb_req_pool_next(pool);
+		if (!req)
+			break;
+
+		remain = download_size - download_queued;
+		req->buf = dl_buf();
+		req->length = rx_length(ep, remain, DL_REQ_SIZE);
 		/*
-		 * Reset global transfer variable, keep download_bytes because
-		 * it will be used in the next possible flashing command
+		 * rx_length() rounds the last request up to whole packets,
+		 * which must not be written past the download buffer. Stop
+		 * that request before the last, short packet, and receive
+		 * that packet into the command buffer, which is idle during
+		 * downloads.
 		 */
-		download_size = 0;
-		req->complete = rx_handler_command;
-		req->length = EP_BUFFER_SIZE;
+		if (req->buf + req->length > buf_end) {
+			if (remain > ep->maxpacket)
+				req->length = rounddown(remain, ep->maxpacket);
+			else
+				req->buf = fastboot_func->out_req->buf;
+		}
+		if (usb_req_pool_queue(pool)) {
+			printf("failed to queue download req\n");
+			break;
+		}
+		download_queued += req->length;
+	}
+}
 
-		strcpy(response, "OKAY");
-		fastboot_tx_write_str(response);
+static void dl_end(struct usb_ep *ep)
+{
+	char response[FASTBOOT_RESPONSE_LEN];
 
-		printf("\ndownloading of %d bytes finished\n", download_bytes);
-	} else {
-		req->length = rx_bytes_expected(ep);
+	/*
+	 * Reset global transfer variable, keep download_bytes because
+	 * it will be used in the next possible flashing command
+	 */
+	download_size = 0;
+	strcpy(response, "OKAY");
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	stream_end();
+	if (stream_mode == STREAM_TOO_LARGE)
+		strcpy(response, "FAILdata too large");
+#endif
+
+	/* Receive the next command */
+	fastboot_func->out_req->actual = 0;
+	usb_ep_queue(ep, fastboot_func->out_req, 0);
+
+	fastboot_tx_write_str(response);
+
+	printf("\ndownloading of %d bytes finished\n", download_bytes);
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	if (stream_mode == STREAM_TOO_LARGE)
+		download_bytes = 0;
+#endif
+}
+
+/*
+ * The other requests of the pool receive the next data while the data
+ * of this one is handled, after which it is queued again.
+ */
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
+{
+	unsigned int transfer_size = download_size - download_bytes;
+
+	usb_req_pool_complete(&fastboot_func->dl_pool, req);
+
+	if (req->status != 0) {
+		printf("Bad status: %d\n", req->status);
+		return;
 	}
 
-	req->actual = 0;
-	usb_ep_queue(ep, req, 0);
+	if (req->actual < transfer_size)
+		transfer_size = req->actual;
+
+	/* The last packet of the download was received out of place */
+	if (req->buf == fastboot_func->out_req->buf)
+		memcpy((void *)CONFIG_FASTBOOT_BUF_ADDR + download_bytes,
+		       req->buf, transfer_size);
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	stream_data(req->buf, transfer_size);
+#endif
+
+	fastboot_dl_progress(transfer_size);
+
+	/* Check if transfer is done */
+	if (download_bytes >= download_size)
+		dl_end(ep);
+	else
+		dl_queue(ep);
 }
 
 static void cb_download(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
 	char response[FASTBOOT_RESPONSE_LEN];
+	unsigned int max_size = CONFIG_FASTBOOT_BUF_SIZE;
 
 	strsep(&cmd, ":");
 	download_size = simple_strtoul(cmd, NULL, 16);
 	download_bytes = 0;
+	download_queued = 0;
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	/* Streaming applies to this download only */
+	stream_mode = STREAM_NONE;
+	if (stream_armed) {
+		stream_armed = false;
+		stream_mode = STREAM_START;
+		/* Streamed sparse images are not kept in RAM */
+		max_size = INT_MAX;
+	}
+#endif
 
 	printf("Starting download of %d bytes\n", download_size);
 
 	if (0 == download_size) {
 		strcpy(response, "FAILdata invalid size");
-	} else if (download_size > CONFIG_FASTBOOT_BUF_SIZE) {
+	} else if (download_size > max_size) {
 		download_size = 0;
 		strcpy(response, "FAILdata too large");
 	} else {
 		sprintf(response, "DATA%08x", download_size);
-		req->complete = rx_handler_dl_image;
-		req->length = rx_bytes_expected(ep);
+		/* The command request is queued again when it is done */
+		usb_req_pool_reset(&fastboot_func->dl_pool);
+		dl_queue(ep);
 	}
 	fastboot_tx_write_str(response);
 }
@@ -590,6 +788,21 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 		return;
 	}
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	/*
+	 * A streamed image has been written already, to the partition named
+	 * by "oem stream" right before the download; report the result
+	 */
+	if (stream_mode == STREAM_SPARSE) {
+		stream_mode = STREAM_NONE;
+		if (strcmp(cmd, stream_part))
+			fastboot_tx_write_str("FAILstreamed to other partition");
+		else
+			fastboot_tx_write_str(stream_response);
+		return;
+	}
+#endif
+
 	/* initialize the response buffer */
 	fb_response_str = response;
 
@@ -607,9 +820,61 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 }
 #endif
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+/*
+ * Arm streaming for the next download. The partition is looked up and
+ * the writer set up now, so that a download is only ever streamed to a
+ * partition which was confirmed by the command right before it.
+ */
+static void cb_oem_stream(const char *part)
+{
+	char response[FASTBOOT_RESPONSE_LEN];
+	int ret = -ENODEV;
+
+	while (*part == ' ')
+		part++;
+
+	if (!*part) {
+		fastboot_tx_write_str("OKAY");
+		return;
+	}
+	if (CONFIG_FASTBOOT_BUF_SIZE < DL_REQ_COUNT * DL_REQ_SIZE) {
+		fastboot_tx_write_str("FAILdownload buffer too small");
+		return;
+	}
+	if (strlen(part) >= sizeof(stream_part)) {
+		fastboot_tx_write_str("FAILpartition name too long");
+		return;
+	}
+
+	strcpy(stream_part, part);
+	fb_response_str = response;
+	fastboot_fail("no flash device defined");
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	ret = fb_mmc_flash_stream(stream_part, &stream_writer);
+#endif
+#ifdef CONFIG_FASTBOOT_FLASH_NAND_DEV
+	ret = fb_nand_flash_stream(stream_part, &stream_writer);
+#endif
+	if (ret) {
+		fastboot_tx_write_str(response);
+		return;
+	}
+
+	stream_armed = true;
+	printf("Streaming the next sparse image to '%s'\n", part);
+	fastboot_tx_write_str("OKAY");
+}
+#endif
+
 static void cb_oem(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	if (strncmp("stream", cmd + 4, 6) == 0) {
+		cb_oem_stream(cmd + 10);
+	} else
+#endif
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
 	if (strncmp("format", cmd + 4, 6) == 0) {
 		char cmdbuf[32];
@@ -709,6 +974,12 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 		}
 	}
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	/* Any command but the download cancels "oem stream" */
+	if (func_cb != cb_download)
+		stream_armed = false;
+#endif
+
 	if (!func_cb) {
 		error("unknown command: %s", cmdbuf);
 		fastboot_tx_write_str("FAILunknown command");
@@ -725,5 +996,7 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 
 	*cmdbuf = '\0';
 	req->actual = 0;
-	usb_ep_queue(ep, req, 0);
+	/* During downloads, the download requests receive the data */
+	if (!download_size)
+		usb_ep_queue(ep, req, 0);
 }
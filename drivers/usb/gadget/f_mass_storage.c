@@ -258,6 +258,8 @@
 #include <usb/lin_gadget_compat.h>
 #include <g_dnl.h>
 
+#include "req_pool.h"
+
 /*------------------------------------------------------------------------*/
 
 #define FSG_DRIVER_DESC	"Mass Storage Function"
@@ -318,6 +320,8 @@ struct fsg_common {
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
 	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
+	/* The requests of the buffer heads */
+	struct usb_req_pool	in_pool, out_pool;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -2175,14 +2179,15 @@ static int enable_endpoint(struct fsg_common *common, struct usb_ep *ep,
 	return rc;
 }
 
-static int alloc_request(struct fsg_common *common, struct usb_ep *ep,
-		struct usb_request **preq)
+static int alloc_requests(struct fsg_common *common, struct usb_ep *ep,
+		struct usb_req_pool *pool)
 {
-	*preq = usb_ep_alloc_request(ep, GFP_ATOMIC);
-	if (*preq)
-		return 0;
-	ERROR(common, "can't allocate request for %s\n", ep->name);
-	return -ENOMEM;
+	int rc;
+
+	rc = usb_req_pool_alloc(pool, ep, FSG_NUM_BUFFERS, 0);
+	if (rc)
+		ERROR(common, "can't allocate requests for %s\n", ep->name);
+	return rc;
 }
 
 /* Reset interface setting and re-init endpoint state (toggle etc). */
@@ -2203,15 +2208,11 @@ reset:
 		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
 			struct fsg_buffhd *bh = &common->buffhds[i];
 
-			if (bh->inreq) {
-				usb_ep_free_request(fsg->bulk_in, bh->inreq);
-				bh->inreq = NULL;
-			}
-			if (bh->outreq) {
-				usb_ep_free_request(fsg->bulk_out, bh->outreq);
-				bh->outreq = NULL;
-			}
+			bh->inreq = NULL;
+			bh->outreq = NULL;
 		}
+		usb_req_pool_free(&common->in_pool, 0);
+		usb_req_pool_free(&common->out_pool, 0);
 
 		/* Disable the endpoints */
 		if (fsg->bulk_in_enabled) {
@@ -2253,15 +2254,17 @@ reset:
 	clear_bit(IGNORE_BULK_OUT, &fsg->atomic_bitflags);
 
 	/* Allocate the requests */
+	rc = alloc_requests(common, fsg->bulk_in, &common->in_pool);
+	if (rc)
+		goto reset;
+	rc = alloc_requests(common, fsg->bulk_out, &common->out_pool);
+	if (rc)
+		goto reset;
 	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
 		struct fsg_buffhd	*bh = &common->buffhds[i];
 
-		rc = alloc_request(common, fsg->bulk_in, &bh->inreq);
-		if (rc)
-			goto reset;
-		rc = alloc_request(common, fsg->bulk_out, &bh->outreq);
-		if (rc)
-			goto reset;
+		bh->inreq = common->in_pool.reqs[i];
+		bh->outreq = common->out_pool.reqs[i];
 		bh->inreq->buf = bh->outreq->buf = bh->buf;
 		bh->inreq->context = bh->outreq->context = bh;
 		bh->inreq->complete = bulk_in_complete;
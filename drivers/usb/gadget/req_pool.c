@@ -0,0 +1,101 @@
+/*
+ * req_pool.c - requests kept queued on a bulk endpoint
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include "req_pool.h"
+
+int usb_req_pool_alloc(struct usb_req_pool *pool, struct usb_ep *ep,
+		       unsigned int count, unsigned int buf_size)
+{
+	struct usb_request *req;
+
+	if (!count || count > USB_REQ_POOL_MAX)
+		return -EINVAL;
+
+	memset(pool, 0, sizeof(*pool));
+	pool->ep = ep;
+	while (pool->count < count) {
+		req = usb_ep_alloc_request(ep, 0);
+		if (!req)
+			goto err;
+		pool->reqs[pool->count++] = req;
+
+		if (!buf_size)
+			continue;
+		req->length = buf_size;
+		req->buf = memalign(CONFIG_SYS_CACHELINE_SIZE, buf_size);
+		if (!req->buf)
+			goto err;
+	}
+
+	return 0;
+err:
+	usb_req_pool_free(pool, buf_size);
+	return -ENOMEM;
+}
+
+void usb_req_pool_free(struct usb_req_pool *pool, unsigned int buf_size)
+{
+	struct usb_request *req;
+	unsigned int i;
+
+	for (i = 0; i < pool->count; i++) {
+		req = pool->reqs[i];
+		if (buf_size)
+			free(req->buf);
+		usb_ep_free_request(pool->ep, req);
+		pool->reqs[i] = NULL;
+	}
+	pool->count = 0;
+	pool->head = 0;
+	pool->queued = 0;
+}
+
+void usb_req_pool_reset(struct usb_req_pool *pool)
+{
+	pool->head = 0;
+	pool->queued = 0;
+}
+
+struct usb_request *usb_req_pool_next(struct usb_req_pool *pool)
+{
+	if (pool->queued == pool->count)
+		return NULL;
+
+	return pool->reqs[(pool->head + pool->queued) % pool->count];
+}
+
+int usb_req_pool_queue(struct usb_req_pool *pool)
+{
+	struct usb_request *req = usb_req_pool_next(pool);
+	int ret;
+
+	if (!req)
+		return -EBUSY;
+
+	req->actual = 0;
+	pool->queued++;
+	ret = usb_ep_queue(pool->ep, req, 0);
+	if (ret)
+		pool->queued--;
+
+	return ret;
+}
+
+void usb_req_pool_complete(struct usb_req_pool *pool,
+			   struct usb_request *req)
+{
+	if (!pool->queued || pool->reqs[pool->head] != req) {
+		debug("%s: request %p completed out of order\n", __func__,
+		      req);
+		return;
+	}
+
+	pool->head = (pool->head + 1) % pool->count;
+	pool->queued--;
+}
@@ -0,0 +1,100 @@
+/*
+ * req_pool.h - requests kept queued on a bulk endpoint
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _USB_REQ_POOL_H_
+#define _USB_REQ_POOL_H_
+
+#include <linux/usb/ch9.h>
+#include <linux/usb/gadget.h>
+
+#define USB_REQ_POOL_MAX	16
+
+/**
+ * struct usb_req_pool - requests used in turn on one endpoint
+ *
+ * The requests are queued in the order of @reqs, wrapping around, and
+ * the controller completes them in the same order. Keeping several of
+ * them queued lets the controller carry on with the next one while the
+ * completion of the previous one is handled.
+ *
+ * fastboot queues its download requests this way. f_mass_storage only
+ * uses usb_req_pool_alloc() and usb_req_pool_free(): its buffer-head
+ * ring queues the requests itself.
+ *
+ * @ep:		Endpoint the requests are queued on
+ * @reqs:	The requests
+ * @count:	Number of requests in @reqs
+ * @head:	Index of the request which completes next
+ * @queued:	Number of requests queued
+ */
+struct usb_req_pool {
+	struct usb_ep		*ep;
+	struct usb_request	*reqs[USB_REQ_POOL_MAX];
+	unsigned int		count;
+	unsigned int		head;
+	unsigned int		queued;
+};
+
+/**
+ * usb_req_pool_alloc() - allocate the requests of a pool
+ *
+ * @pool:	Pool to set up
+ * @ep:		Endpoint the requests are used on
+ * @count:	Number of requests, at most USB_REQ_POOL_MAX
+ * @buf_size:	Size of the buffer to allocate for each request, or 0 if
+ *		the caller sets up the buffers
+ * @return 0 if OK, -ve on error
+ */
+int usb_req_pool_alloc(struct usb_req_pool *pool, struct usb_ep *ep,
+		       unsigned int count, unsigned int buf_size);
+
+/**
+ * usb_req_pool_free() - free the requests of a pool
+ *
+ * The requests must not be queued any more, e.g. after the endpoint was
+ * disabled. Buffers allocated by usb_req_pool_alloc() are freed too.
+ *
+ * @pool:	Pool to free
+ * @buf_size:	@buf_size passed to usb_req_pool_alloc()
+ */
+void usb_req_pool_free(struct usb_req_pool *pool, unsigned int buf_size);
+
+/**
+ * usb_req_pool_reset() - restart using the requests with the first one
+ *
+ * @pool:	Pool with no requests queued
+ */
+void usb_req_pool_reset(struct usb_req_pool *pool);
+
+/**
+ * usb_req_pool_next() - get the request to queue next
+ *
+ * @pool:	Pool to use
+ * @return the request, or NULL if all of them are queued
+ */
+struct usb_request *usb_req_pool_next(struct usb_req_pool *pool);
+
+/**
+ * usb_req_pool_queue() - queue the request returned by usb_req_pool_next()
+ *
+ * @pool:	Pool to use
+ * @return 0 if OK, -ve on error
+ */
+int usb_req_pool_queue(struct usb_req_pool *pool);
+
+/**
+ * usb_req_pool_complete() - note the completion of a request
+ *
+ * To be called from the completion handler of the requests, also for
+ * requests which failed or were cancelled.
+ *
+ * @pool:	Pool @req belongs to
+ * @req:	Completed request
+ */
+void usb_req_pool_complete(struct usb_req_pool *pool,
+			   struct usb_request *req);
+
+#endif /* _USB_REQ_POOL_H_ */
@@ -305,8 +305,12 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
-/* Number of buffers we will use.  2 is enough for double-buffering */
-#define FSG_NUM_BUFFERS	2
+/*
+ * Number of buffers we will use.  2 is enough for double-buffering, more
+ * keep the controller busy while a buffer is read from or written to the
+ * medium.
+ */
+#define FSG_NUM_BUFFERS	CONFIG_USB_GADGET_REQ_POOL_DEPTH
 
 /* Default size of buffer length. */
 #define FSG_BUFLEN	((u32)16384)
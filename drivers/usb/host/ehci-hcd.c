@@ -296,6 +296,75 @@ static void ehci_update_endpt2_dev_n_port(struct usb_device *udev,
 				     QH_ENDPT2_HUBADDR(hubaddr));
 }
 
+/*
+ * qTDs kept for the asynchronous schedule, enough for 5 MiB with page aligned
+ * buffers. ehci_get_max_xfer_size() keeps mass storage transfers within them;
+ * longer transfers allocate their own.
+ */
+#define EHCI_ASYNC_QTDS		256
+
+static int ehci_enable_async(struct ehci_ctrl *ctrl)
+{
+	uint32_t cmd;
+	int ret;
+
+	/* Once started, the schedule keeps running between transfers */
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	if (cmd & CMD_ASE)
+		return 0;
+
+	/* Set async. queue head pointer. */
+	ehci_writel(&ctrl->hcor->or_asynclistaddr, virt_to_phys(&ctrl->qh_list));
+
+	cmd |= CMD_ASE;
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
+
+	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, STS_ASS,
+			100 * 1000);
+	if (ret < 0)
+		printf("EHCI fail timeout STS_ASS set\n");
+
+	return ret;
+}
+
+/*
+ * Take the QH of a finished transfer off the asynchronous schedule. The
+ * controller may still hold a pointer to it, so wait until it has advanced
+ * past it before the QH and its qTDs are reused.
+ */
+static int ehci_unlink_async(struct ehci_ctrl *ctrl)
+{
+	uint32_t cmd;
+	int ret;
+
+	ctrl->qh_list.qh_link = cpu_to_hc32(virt_to_phys(&ctrl->qh_list) |
+					    QH_LINK_TYPE_QH);
+	flush_dcache_range((unsigned long)&ctrl->qh_list,
+		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+
+	/* Ring the doorbell */
+	ehci_writel(&ctrl->hcor->or_usbsts, STS_IAA);
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd | CMD_IAAD);
+	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_IAA, STS_IAA,
+			100 * 1000);
+	ehci_writel(&ctrl->hcor->or_usbsts, STS_IAA);
+	if (!ret)
+		return 0;
+
+	/* The doorbell got lost, stop the schedule instead */
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	cmd &= ~(CMD_ASE | CMD_IAAD);
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
+
+	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, 0,
+			100 * 1000);
+	if (ret < 0)
+		printf("EHCI fail timeout STS_ASS reset\n");
+
+	return ret;
+}
+
 static int
 ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		   int length, struct devrequest *req)
@@ -309,7 +378,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	uint32_t *tdp;
 	uint32_t endpt, maxpacket, token, usbsts;
 	uint32_t c, toggle;
-	uint32_t cmd;
+	unsigned long vtd_start;
 	int timeout;
 	int ret = 0;
 	struct ehci_ctrl *ctrl = ehci_get_ctrl(dev);
@@ -382,7 +451,15 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 #if CONFIG_SYS_MALLOC_LEN <= 64 + 128 * 1024
 #warning CONFIG_SYS_MALLOC_LEN may be too small for EHCI
 #endif
-	qtd = memalign(USB_DMA_MINALIGN, qtd_count * sizeof(struct qTD));
+	qtd = NULL;
+	if (qtd_count <= EHCI_ASYNC_QTDS) {
+		if (!ctrl->async_qtds)
+			ctrl->async_qtds = memalign(USB_DMA_MINALIGN,
+					EHCI_ASYNC_QTDS * sizeof(struct qTD));
+		qtd = ctrl->async_qtds;
+	}
+	if (!qtd)
+		qtd = memalign(USB_DMA_MINALIGN, qtd_count * sizeof(struct qTD));
 	if (qtd == NULL) {
 		printf("unable to allocate TDs\n");
 		return -1;
@@ -536,45 +613,36 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		tdp = &qtd[qtd_counter++].qt_next;
 	}
 
-	ctrl->qh_list.qh_link = cpu_to_hc32(virt_to_phys(qh) | QH_LINK_TYPE_QH);
-
-	/* Flush dcache */
-	flush_dcache_range((unsigned long)&ctrl->qh_list,
-		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+	/* Flush dcache, the QH and qTDs before the link to them */
 	flush_dcache_range((unsigned long)qh, ALIGN_END_ADDR(struct QH, qh, 1));
 	flush_dcache_range((unsigned long)qtd,
 			   ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
 
-	/* Set async. queue head pointer. */
-	ehci_writel(&ctrl->hcor->or_asynclistaddr, virt_to_phys(&ctrl->qh_list));
-
 	usbsts = ehci_readl(&ctrl->hcor->or_usbsts);
 	ehci_writel(&ctrl->hcor->or_usbsts, (usbsts & 0x3f));
 
-	/* Enable async. schedule. */
-	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
-	cmd |= CMD_ASE;
-	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
+	ctrl->qh_list.qh_link = cpu_to_hc32(virt_to_phys(qh) | QH_LINK_TYPE_QH);
+	flush_dcache_range((unsigned long)&ctrl->qh_list,
+		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
 
-	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, STS_ASS,
-			100 * 1000);
+	ret = ehci_enable_async(ctrl);
 	if (ret < 0) {
-		printf("EHCI fail timeout STS_ASS set\n");
+		ehci_unlink_async(ctrl);
 		goto fail;
 	}
 
-	/* Wait for TDs to be processed. */
+	/*
+	 * Wait for TDs to be processed. Only the last one is polled, which
+	 * keeps the cache maintenance small however long the chain is.
+	 */
 	ts = get_timer(0);
 	vtd = &qtd[qtd_counter - 1];
+	vtd_start = rounddown((unsigned long)vtd, USB_DMA_MINALIGN);
 	timeout = USB_TIMEOUT_MS(pipe);
 	do {
 		/* Invalidate dcache */
-		invalidate_dcache_range((unsigned long)&ctrl->qh_list,
-			ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
-		invalidate_dcache_range((unsigned long)qh,
-			ALIGN_END_ADDR(struct QH, qh, 1));
-		invalidate_dcache_range((unsigned long)qtd,
-			ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
+		invalidate_dcache_range(vtd_start,
+			roundup((unsigned long)(vtd + 1), USB_DMA_MINALIGN));
 
 		token = hc32_to_cpu(vtd->qt_token);
 		if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE))
@@ -598,18 +666,12 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)
 		printf("EHCI timed out on TD - token=%#x\n", token);
 
-	/* Disable async schedule. */
-	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
-	cmd &= ~CMD_ASE;
-	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
-
-	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, 0,
-			100 * 1000);
-	if (ret < 0) {
-		printf("EHCI fail timeout STS_ASS reset\n");
+	ret = ehci_unlink_async(ctrl);
+	if (ret < 0)
 		goto fail;
-	}
 
+	invalidate_dcache_range((unsigned long)qh,
+		ALIGN_END_ADDR(struct QH, qh, 1));
 	token = hc32_to_cpu(qh->qh_overlay.qt_token);
 	if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)) {
 		debug("TOKEN=%#x\n", token);
@@ -649,11 +711,13 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 #endif
 	}
 
-	free(qtd);
+	if (qtd != ctrl->async_qtds)
+		free(qtd);
 	return (dev->status != USB_ST_NOT_PROC) ? 0 : -1;
 
 fail:
-	free(qtd);
+	if (qtd != ctrl->async_qtds)
+		free(qtd);
 	return -1;
 }
 
@@ -1643,6 +1707,20 @@ int ehci_deregister(struct udevice *dev)
 		return 0;
 
 	ehci_shutdown(ctrl);
+	free(ctrl->async_qtds);
+	ctrl->async_qtds = NULL;
+
+	return 0;
+}
+
+static int ehci_get_max_xfer_size(struct udevice *dev, size_t *size)
+{
+	/*
+	 * As much as the cached qTDs take, with an unaligned buffer and the
+	 * SETUP and ACK qTDs of a control transfer, so that
+	 * ehci_submit_async() does not allocate qTDs for each transfer
+	 */
+	*size = (EHCI_ASYNC_QTDS - 4) * (QT_BUFFER_CNT - 1) * EHCI_PAGE_SIZE;
 
 	return 0;
 }
@@ -1654,6 +1732,7 @@ struct dm_usb_ops ehci_usb_ops = {
 	.create_int_queue = ehci_create_int_queue,
 	.poll_int_queue = ehci_poll_int_queue,
 	.destroy_int_queue = ehci_destroy_int_queue,
+	.get_max_xfer_size = ehci_get_max_xfer_size,
 };
 
 #endif
@@ -110,6 +110,14 @@ static int sandbox_alloc_device(struct udevice *dev, struct usb_device *udev)
 	return 0;
 }
 
+static int sandbox_get_max_xfer_size(struct udevice *dev, size_t *size)
+{
+	/* Like EHCI, any length can be emulated */
+	*size = SIZE_MAX;
+
+	return 0;
+}
+
 static int sandbox_usb_probe(struct udevice *dev)
 {
 	return 0;
@@ -120,6 +128,7 @@ static const struct dm_usb_ops sandbox_usb_ops = {
 	.bulk		= sandbox_submit_bulk,
 	.interrupt	= sandbox_submit_int,
 	.alloc_device	= sandbox_alloc_device,
+	.get_max_xfer_size = sandbox_get_max_xfer_size,
 };
 
 static const struct udevice_id sandbox_usb_ids[] = {
@@ -1235,11 +1235,24 @@ int xhci_deregister(struct udevice *dev)
 	return 0;
 }
 
+static int xhci_get_max_xfer_size(struct udevice *dev, size_t *size)
+{
+	/*
+	 * A transfer has to fit in the single segment of the endpoint ring,
+	 * less the link TRB, the slot which tells a full ring from an empty
+	 * one and the extra TRB needed when the buffer is not aligned.
+	 */
+	*size = (TRBS_PER_SEGMENT - 3) * TRB_MAX_BUFF_SIZE;
+
+	return 0;
+}
+
 struct dm_usb_ops xhci_usb_ops = {
 	.control = xhci_submit_control_msg,
 	.bulk = xhci_submit_bulk_msg,
 	.interrupt = xhci_submit_int_msg,
 	.alloc_device = xhci_alloc_device,
+	.get_max_xfer_size = xhci_get_max_xfer_size,
 };
 
 #endif
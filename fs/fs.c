@@ -362,7 +362,7 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	loff_t bytes;
 	loff_t pos;
 	loff_t len_read;
-	int ret;
+	int ret, span;
 	unsigned long time;
 	char *ep;
 
@@ -404,7 +404,9 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		pos = 0;
 
 	time = get_timer(0);
+	span = bootstage_span_begin("load");
 	ret = fs_read(filename, addr, pos, bytes, &len_read);
+	bootstage_span_end(span);
 	time = get_timer(time);
 	if (ret < 0)
 		return 1;
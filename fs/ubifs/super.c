@@ -2246,6 +2246,8 @@ static int ubifs_fill_super(struct super_block *sb, void *data, int silent)
 #else
 	/* U-Boot read only mode */
 	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	/* Files are mostly read whole, e.g. kernels, so use bulk-read */
+	c->bulk_read = 1;
 #endif
 
 	if (IS_ERR(c->ubi)) {
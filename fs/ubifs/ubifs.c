@@ -681,23 +681,12 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+static int unpack_block(struct ubifs_info *c, struct inode *inode, void *addr,
+			unsigned int block, struct ubifs_data_node *dn)
 {
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -728,6 +717,74 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return unpack_block(c, inode, addr, block, dn);
+}
+
+/*
+ * Read consecutive blocks of a file with one flash read, if their data nodes
+ * sit next to each other in the same LEB. Returns the number of blocks
+ * written to @addr (at most @max_blocks), or 0 if the caller has to read
+ * block by block.
+ */
+static int bulk_read_blocks(struct ubifs_info *c, struct inode *inode,
+			    void *addr, unsigned int block,
+			    unsigned int max_blocks)
+{
+	struct bu_info *bu = &c->bu;
+	unsigned int i, blocks;
+	void *node;
+	int err, n = 0;
+
+	if (!bu->buf || max_blocks < 2)
+		return 0;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err || bu->cnt < 2 ||
+	    key_block(c, &bu->zbranch[0].key) != block)
+		return 0;
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err)
+		return 0;
+
+	blocks = min_t(unsigned int, bu->blk_cnt, max_blocks);
+	node = bu->buf;
+	for (i = 0; i < blocks; i++, addr += UBIFS_BLOCK_SIZE) {
+		if (n >= bu->cnt ||
+		    key_block(c, &bu->zbranch[n].key) != block + i) {
+			/* Hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+			continue;
+		}
+
+		err = unpack_block(c, inode, addr, block + i, node);
+		if (err)
+			return err;
+		node += ALIGN(bu->zbranch[n].len, 8);
+		n++;
+	}
+
+	return blocks;
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -898,6 +955,20 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	page.index = offset / PAGE_SIZE;
 	page.inode = inode;
 	for (i = 0; i < count; i++) {
+		/* The last block may be partial, leave it to do_readpage() */
+		err = bulk_read_blocks(c, inode, page.addr,
+				       page.index << UBIFS_BLOCKS_PER_PAGE_SHIFT,
+				       count - i - 1);
+		if (err < 0)
+			break;
+		if (err > 0) {
+			page.addr += err * UBIFS_BLOCK_SIZE;
+			page.index += err;
+			i += err - 1;
+			err = 0;
+			continue;
+		}
+
 		/*
 		 * Make sure to not read beyond the requested size
 		 */
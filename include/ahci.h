@@ -17,9 +17,13 @@
 #define AHCI_RX_FIS_SZ		256
 #define AHCI_CMD_TBL_HDR	0x80
 #define AHCI_CMD_TBL_CDB	0x40
-#define AHCI_CMD_TBL_SZ		AHCI_CMD_TBL_HDR + (AHCI_MAX_SG * 16)
+#define AHCI_CMD_TBL_SZ		(AHCI_CMD_TBL_HDR + (AHCI_MAX_SG * 16))
+#define AHCI_CMD_TBL_AR_SZ	(AHCI_CMD_TBL_SZ * AHCI_MAX_CMD_SLOT)
 #define AHCI_PORT_PRIV_DMA_SZ	(AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT + \
 				AHCI_CMD_TBL_SZ	+ AHCI_RX_FIS_SZ)
+/* Same, but with one command table per slot for queued (NCQ) commands */
+#define AHCI_PORT_PRIV_NCQ_DMA_SZ (AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT + \
+				AHCI_CMD_TBL_AR_SZ + AHCI_RX_FIS_SZ)
 #define AHCI_CMD_ATAPI		(1 << 5)
 #define AHCI_CMD_WRITE		(1 << 6)
 #define AHCI_CMD_PREFETCH	(1 << 7)
@@ -36,6 +40,11 @@
 #define HOST_VERSION		0x10 /* AHCI spec. version compliancy */
 #define HOST_CAP2		0x24 /* host capabilities, extended */
 
+/* HOST_CAP bits */
+#define HOST_CAP_NCQ		(1 << 30) /* native command queuing */
+#define HOST_CAP_NCS_SHIFT	8	  /* number of command slots - 1 */
+#define HOST_CAP_NCS_MASK	(0x1f << HOST_CAP_NCS_SHIFT)
+
 /* HOST_CTL bits */
 #define HOST_RESET		(1 << 0)  /* reset controller; self-clear */
 #define HOST_IRQ_EN		(1 << 1)  /* global IRQ enable */
@@ -141,7 +150,8 @@ struct ahci_ioports {
 	struct ahci_cmd_hdr	*cmd_slot;
 	struct ahci_sg		*cmd_tbl_sg;
 	ulong	cmd_tbl;
-	u32	rx_fis;
+	ulong	rx_fis;
+	u32	ncq_depth;	/* usable NCQ tags, 0 if NCQ is not in use */
 };
 
 struct ahci_probe_ent {
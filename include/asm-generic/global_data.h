@@ -89,6 +89,8 @@ typedef struct global_data {
 	unsigned long malloc_base;	/* base address of early malloc() */
 	unsigned long malloc_limit;	/* limit address */
 	unsigned long malloc_ptr;	/* current address */
+	unsigned long malloc_peak;	/* highest value of malloc_ptr */
+	unsigned long malloc_freed;	/* bytes free below malloc_ptr */
 #endif
 #ifdef CONFIG_PCI
 	struct pci_controller *hose;	/* PCI hose for early use */
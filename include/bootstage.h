@@ -199,6 +199,9 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_SPI,
 	BOOTSTAGE_ID_ACCUM_DECOMP,
 	BOOTSTAGE_ID_FPGA_INIT,
+	BOOTSTAGE_ID_SPL_FIT_HEADER,
+	BOOTSTAGE_ID_SPL_FIT_FIRMWARE,
+	BOOTSTAGE_ID_SPL_FIT_FDT,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -272,6 +275,27 @@ ulong bootstage_mark_name(enum bootstage_id id, const char *name);
 ulong bootstage_mark_code(const char *file, const char *func,
 			  int linenum);
 
+/**
+ * Start a span of time, which may contain other spans
+ *
+ * Spans nest: whichever span is open when this is called becomes the
+ * parent of the new one, until bootstage_span_end() closes it again.
+ *
+ * @param name	Name of the span, which is copied and may be truncated
+ * @return span number to pass to bootstage_span_end(), or -1 if there is
+ * no space to record it
+ */
+int bootstage_span_begin(const char *name);
+
+/**
+ * End a span started by bootstage_span_begin()
+ *
+ * Any spans inside it which are still open end at the same time.
+ *
+ * @param span	Span number, or -1 to do nothing
+ */
+void bootstage_span_end(int span);
+
 /**
  * Mark the start of a bootstage activity. The end will be marked later with
  * bootstage_accum() and at that point we accumulate the time taken. Calling
@@ -309,6 +333,18 @@ void bootstage_report(void);
  */
 int bootstage_fdt_add_report(void);
 
+/**
+ * Write the bootstage records and spans as Chrome trace-event JSON
+ *
+ * Marks become instant events and spans become complete events, so a
+ * trace viewer shows the spans nested in a timeline.
+ *
+ * @param base	Buffer to write the JSON to
+ * @param size	Size of buffer
+ * @return number of bytes written, or -ENOSPC if the buffer is too small
+ */
+int bootstage_export(char *base, int size);
+
 /*
  * Stash bootstage data into memory
  *
@@ -371,6 +407,15 @@ static inline ulong bootstage_mark_code(const char *file, const char *func,
 	return 0;
 }
 
+static inline int bootstage_span_begin(const char *name)
+{
+	return -1;
+}
+
+static inline void bootstage_span_end(int span)
+{
+}
+
 static inline uint32_t bootstage_start(enum bootstage_id id, const char *name)
 {
 	return 0;
@@ -381,6 +426,11 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline int bootstage_export(char *base, int size)
+{
+	return 0;	/* Nothing to export */
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
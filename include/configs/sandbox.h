@@ -189,6 +189,8 @@
 #endif
 
 #define CONFIG_SCSI
+#define CONFIG_LIBATA
+#define CONFIG_SCSI_AHCI
 #define CONFIG_SCSI_AHCI_PLAT
 #define CONFIG_SYS_SCSI_MAX_DEVICE	2
 #define CONFIG_SYS_SCSI_MAX_SCSI_ID	8
@@ -201,4 +203,12 @@
 #define CONFIG_SYS_SYSTEMACE_WIDTH	16
 #define CONFIG_SYS_SYSTEMACE_BASE	0
 
+/* Sizes of the SPL UBI loader, built into U-Boot for its unit tests */
+#ifdef CONFIG_UT_UBISPL
+#define CONFIG_SPL_UBI_MAX_VOL_LEBS	16
+#define CONFIG_SPL_UBI_MAX_PEB_SIZE	(16 * 1024)
+#define CONFIG_SPL_UBI_MAX_PEBS		64
+#define CONFIG_SPL_UBI_VOL_IDS		4
+#endif
+
 #endif
@@ -121,6 +121,15 @@ struct dfu_entity {
 	int (*flush_medium)(struct dfu_entity *dfu);
 	unsigned int (*poll_timeout)(struct dfu_entity *dfu);
 
+	/*
+	 * Optional: return where the data written at @offset finally ends
+	 * up and in *len how much room there is, so that it is received
+	 * there instead of being staged in the DFU buffer. write_medium()
+	 * is then called with that very buffer. NULL means use the DFU
+	 * buffer.
+	 */
+	void *(*get_write_buf)(struct dfu_entity *dfu, u64 offset, long *len);
+
 	void (*free_entity)(struct dfu_entity *dfu);
 
 	struct list_head list;
@@ -135,9 +144,18 @@ struct dfu_entity {
 	long r_left;
 	long b_left;
 
+	/* staged data which is still to be written */
+	u8 *d_buf;
+	u8 *d_pos;
+	long d_left;
+	u64 d_offset;
+	int d_err;
+
 	u32 bad_skip;	/* for nand use */
 
 	unsigned int inited:1;
+	unsigned int banked:1;
+	unsigned int partial_write:1;	/* write_medium() takes any piece */
 };
 
 #ifdef CONFIG_SET_DFU_ALT_INFO
@@ -162,6 +180,7 @@ bool dfu_usb_get_reset(void);
 int dfu_read(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_write(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_flush(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
+void *dfu_get_write_ptr(struct dfu_entity *de, int size);
 
 /*
  * dfu_defer_flush - pointer to store dfu_entity for deferred flashing.
@@ -188,6 +207,44 @@ static inline void dfu_set_defer_flush(struct dfu_entity *dfu)
 	dfu_defer_flush = dfu;
 }
 
+/*
+ * dfu_defer_drain - dfu_entity with staged data waiting to be written by
+ *		     dfu_drain(). It is NULL when there is nothing to do.
+ */
+extern struct dfu_entity *dfu_defer_drain;
+/**
+ * dfu_get_defer_drain - get current value of dfu_defer_drain pointer
+ *
+ * @return - value of the dfu_defer_drain pointer
+ */
+static inline struct dfu_entity *dfu_get_defer_drain(void)
+{
+	return dfu_defer_drain;
+}
+
+/**
+ * dfu_set_async_drain - let dfu_write() leave full buffers to dfu_drain()
+ *
+ * The DFU buffer is then split in two halves: one is filled from USB
+ * while the other is written to the medium, piece by piece, by the loop
+ * servicing the USB controller. Only to be enabled by callers which call
+ * dfu_drain() while dfu_get_defer_drain() is set. Entities without
+ * partial_write (NAND, SPI flash) are still written a whole buffer at a
+ * time.
+ *
+ * @param enable - true to defer the writes, false to write synchronously
+ */
+void dfu_set_async_drain(bool enable);
+
+/**
+ * dfu_drain - write the next piece of the deferred data
+ *
+ * @param dfu - dfu entity returned by dfu_get_defer_drain()
+ * @return 0 on success, otherwise error code. The error is reported again
+ *	   by the next dfu_write() or dfu_flush().
+ */
+int dfu_drain(struct dfu_entity *dfu);
+
 /**
  * dfu_write_from_mem_addr - write data from memory to DFU managed medium
  *
@@ -5,6 +5,9 @@
  * SPDX-License-Identifier:	GPL-2.0+
  */
 
+struct sparse_writer;
+
 void fb_nand_flash_write(const char *cmd, void *download_buffer,
 			 unsigned int download_bytes);
 void fb_nand_erase(const char *cmd);
+int fb_nand_flash_stream(const char *cmd, struct sparse_writer *sw);
@@ -23,6 +23,65 @@ struct sparse_storage {
 	lbaint_t	(*reserve)(struct sparse_storage *info,
 				 lbaint_t blk,
 				 lbaint_t blkcnt);
+
+	/*
+	 * Optional: erase @blkcnt blocks at @blk, both aligned to
+	 * @erase_blks. Returns the number of blocks erased. Used for
+	 * FILL chunks whose value matches @erased_val (the byte erased
+	 * blocks read back as, or -1).
+	 */
+	lbaint_t	(*erase)(struct sparse_storage *info,
+				 lbaint_t blk,
+				 lbaint_t blkcnt);
+	lbaint_t	erase_blks;
+	int		erased_val;
+};
+
+/**
+ * struct sparse_writer - state of a streaming sparse image write
+ *
+ * @info:		Storage the image is written to
+ * @part_name:		Partition name, for messages
+ * @state:		Parser state (enum sparse_writer_state)
+ * @sparse_header:	Header of the image
+ * @chunk_header:	Header of the current chunk
+ * @hdr_len:		Bytes of the current header received so far
+ * @skip:		Bytes to skip before parsing continues
+ * @chunk:		Index of the current chunk
+ * @chunk_left:		Bytes of data left in the current chunk
+ * @blk:		Next block to write, after the buffered data
+ * @total_blocks:	Blocks of the image processed so far
+ * @bytes_written:	Bytes written to the storage so far
+ * @fill_val:		Value of the current FILL chunk
+ * @crc:		CRC32 of the image data processed so far
+ * @buf:		Buffer to collect RAW data into large writes
+ * @buf_len:		Bytes in @buf
+ * @buf_size:		Size of @buf
+ * @fill_buf:		Buffer holding @fill_buf_blks blocks of @fill_buf_val
+ * @fill_buf_blks:	Size of @fill_buf in blocks
+ * @fill_buf_val:	Value @fill_buf is filled with
+ */
+struct sparse_writer {
+	struct sparse_storage	*info;
+	const char		*part_name;
+	int			state;
+	sparse_header_t		sparse_header;
+	chunk_header_t		chunk_header;
+	unsigned int		hdr_len;
+	unsigned int		skip;
+	unsigned int		chunk;
+	u64			chunk_left;
+	lbaint_t		blk;
+	u32			total_blocks;
+	u64			bytes_written;
+	u32			fill_val;
+	u32			crc;
+	u8			*buf;
+	unsigned int		buf_len;
+	unsigned int		buf_size;
+	u32			*fill_buf;
+	lbaint_t		fill_buf_blks;
+	u32			fill_buf_val;
 };
 
 static inline int is_sparse_image(void *buf)
@@ -36,5 +95,43 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * sparse_writer_start() - start writing a sparse image
+ *
+ * The image is then passed to sparse_writer_feed() in pieces of any
+ * size, as it arrives, and each chunk is written as soon as its data
+ * is available.
+ *
+ * @sw:		Writer state to initialise
+ * @info:	Storage to write to
+ * @part_name:	Partition name, for messages
+ */
+void sparse_writer_start(struct sparse_writer *sw,
+			 struct sparse_storage *info, const char *part_name);
+
+/**
+ * sparse_writer_feed() - pass the next part of a sparse image
+ *
+ * Errors are reported with fastboot_fail(), further data is ignored.
+ *
+ * @sw:		Writer state
+ * @data:	Image data following the data passed before
+ * @len:	Length of @data in bytes
+ * @return 0 if OK, -ve on error
+ */
+int sparse_writer_feed(struct sparse_writer *sw, const void *data,
+		       unsigned int len);
+
+/**
+ * sparse_writer_finish() - complete writing a sparse image
+ *
+ * Writes any buffered data, checks the image was complete and reports
+ * the result with fastboot_okay() or fastboot_fail().
+ *
+ * @sw:		Writer state
+ * @return 0 if OK, -ve on error
+ */
+int sparse_writer_finish(struct sparse_writer *sw);
+
 void write_sparse_image(struct sparse_storage *info, const char *part_name,
 			void *data, unsigned sz);
@@ -867,6 +867,7 @@ int bootz_setup(ulong image, ulong *start, ulong *end);
 /* image node */
 #define FIT_DATA_PROP		"data"
 #define FIT_DATA_OFFSET_PROP	"data-offset"
+#define FIT_DATA_POSITION_PROP	"data-position"
 #define FIT_DATA_SIZE_PROP	"data-size"
 #define FIT_TIMESTAMP_PROP	"timestamp"
 #define FIT_DESC_PROP		"description"
@@ -885,6 +886,7 @@ int bootz_setup(ulong image, ulong *start, ulong *end);
 #define FIT_DEFAULT_PROP	"default"
 #define FIT_SETUP_PROP		"setup"
 #define FIT_FPGA_PROP		"fpga"
+#define FIT_FIRMWARE_PROP	"firmware"
 
 #define FIT_MAX_HASH_LEN	HASH_MAX_DIGEST_SIZE
 
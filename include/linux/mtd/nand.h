@@ -105,6 +105,8 @@ extern void nand_wait_ready(struct mtd_info *mtd);
  */
 #define NAND_CMD_DEPLETE1	0x100
 #define NAND_CMD_DEPLETE2	0x38
+#define NAND_CMD_READCACHESEQ	0x31
+#define NAND_CMD_READCACHEEND	0x3f
 #define NAND_CMD_STATUS_MULTI	0x71
 #define NAND_CMD_STATUS_ERROR	0x72
 /* multi-bank error status (banks 0-3) */
@@ -195,12 +197,16 @@ typedef enum {
  */
 #define NAND_NEED_SCRAMBLING	0x00002000
 
+/* Chip supports sequential cache reads (31h/3Fh) */
+#define NAND_CACHERD		0x00004000
+
 /* Options valid for Samsung large page devices */
 #define NAND_SAMSUNG_LP_OPTIONS NAND_CACHEPRG
 
 /* Macros to identify the above */
 #define NAND_HAS_CACHEPROG(chip) ((chip->options & NAND_CACHEPRG))
 #define NAND_HAS_SUBPAGE_READ(chip) ((chip->options & NAND_SUBPAGE_READ))
+#define NAND_HAS_CACHE_READ(chip) ((chip->options & NAND_CACHERD))
 
 /* Non chip related options */
 /* This option skips the bbt scan during initialization. */
@@ -261,6 +267,9 @@ struct nand_chip;
 /* ONFI subfeature parameters length */
 #define ONFI_SUBFEATURE_PARAM_LEN	4
 
+/* ONFI optional commands READ CACHE supported? */
+#define ONFI_OPT_CMD_READ_CACHE		(1 << 1)
+
 /* ONFI optional commands SET/GET FEATURES supported? */
 #define ONFI_OPT_CMD_SET_GET_FEATURES	(1 << 2)
 
@@ -667,6 +676,8 @@ struct nand_buffers {
  * @jedec_params:	[INTERN] holds the JEDEC parameter page when JEDEC is
  *			supported, 0 otherwise.
  * @read_retries:	[INTERN] the number of read retry modes supported
+ * @read_bytes:		[INTERN] number of bytes read through nand_do_read_ops()
+ * @read_us:		[INTERN] time spent reading @read_bytes, in microseconds
  * @onfi_set_features:	[REPLACEABLE] set the features for ONFI nand
  * @onfi_get_features:	[REPLACEABLE] get the features for ONFI nand
  * @bbt:		[INTERN] bad block table pointer
@@ -748,6 +759,9 @@ struct nand_chip {
  
 	int read_retries;
 
+	u64 read_bytes;
+	u64 read_us;
+
 	flstate_t state;
 
 	uint8_t *oob_poi;
@@ -902,6 +916,11 @@ extern struct nand_manufacturers nand_manuf_ids[];
 
 extern int nand_default_bbt(struct mtd_info *mtd);
 extern int nand_markbad_bbt(struct mtd_info *mtd, loff_t offs);
+#ifdef CONFIG_NAND_BBT_STASH
+void nand_bbt_stash_drop(struct mtd_info *mtd);
+#else
+static inline void nand_bbt_stash_drop(struct mtd_info *mtd) {}
+#endif
 extern int nand_isreserved_bbt(struct mtd_info *mtd, loff_t offs);
 extern int nand_isbad_bbt(struct mtd_info *mtd, loff_t offs, int allowbbt);
 extern int nand_erase_nand(struct mtd_info *mtd, struct erase_info *instr,
@@ -3,6 +3,7 @@
 #ifdef __KERNEL__
 
 #include <asm/types.h>
+#include <linux/rbtree.h>
 /*
  * Logical memory blocks.
  *
@@ -11,17 +12,40 @@
  * SPDX-License-Identifier:	GPL-2.0+
  */
 
-#define MAX_LMB_REGIONS 8
-
+/**
+ * struct lmb_property - a region of memory
+ *
+ * @node:	Node in the tree of regions, which is sorted by base address
+ * @base:	Start address of the region
+ * @size:	Size of the region in bytes
+ * @type:	Type of the region, for region sets which hold several types,
+ *		such as the EFI memory map. The lmb sets use 0.
+ *
+ * Region sets use 64-bit addresses whatever the size of phys_addr_t, so
+ * that a region may end at the top of a 32-bit address space, and so that
+ * the EFI memory map can describe any memory.
+ */
 struct lmb_property {
-	phys_addr_t base;
-	phys_size_t size;
+	struct rb_node node;
+	u64 base;
+	u64 size;
+	ulong type;
 };
 
+/**
+ * struct lmb_region - a set of regions which do not overlap
+ *
+ * Adjacent regions of the same type are always merged, so each region is
+ * bounded by free space or by a region of another type.
+ *
+ * @root:	Tree of struct lmb_property
+ * @cnt:	Number of regions
+ * @size:	Total size of the regions in bytes
+ */
 struct lmb_region {
+	struct rb_root root;
 	unsigned long cnt;
-	phys_size_t size;
-	struct lmb_property region[MAX_LMB_REGIONS+1];
+	u64 size;
 };
 
 struct lmb {
@@ -31,6 +55,12 @@ struct lmb {
 
 extern struct lmb lmb;
 
+/*
+ * lmb_init() - Set up an empty lmb
+ *
+ * The lmb must be zeroed or have been set up before. Any regions it holds
+ * are freed.
+ */
 extern void lmb_init(struct lmb *lmb);
 extern long lmb_add(struct lmb *lmb, phys_addr_t base, phys_size_t size);
 extern long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size);
@@ -44,10 +74,93 @@ extern long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size);
 
 extern void lmb_dump_all(struct lmb *lmb);
 
-static inline phys_size_t
-lmb_size_bytes(struct lmb_region *type, unsigned long region_nr)
+/**
+ * lmb_region_init() - Empty a region set
+ *
+ * @rgn:	Region set, which must be zeroed or have been set up before
+ */
+void lmb_region_init(struct lmb_region *rgn);
+
+/**
+ * lmb_region_set() - Give a range of memory a type
+ *
+ * Regions overlapping the range are trimmed, split or removed, then the
+ * range is added and merged with neighbours of the same type.
+ *
+ * @rgn:	Region set to update
+ * @base:	Start of the range
+ * @size:	Size of the range in bytes
+ * @type:	Type of the range
+ * @return 0 if OK, -1 if out of memory
+ */
+long lmb_region_set(struct lmb_region *rgn, u64 base, u64 size, ulong type);
+
+/**
+ * lmb_region_clear() - Remove a range of memory from a region set
+ *
+ * @rgn:	Region set to update
+ * @base:	Start of the range
+ * @size:	Size of the range in bytes
+ * @return 0 if OK, -1 if out of memory
+ */
+long lmb_region_clear(struct lmb_region *rgn, u64 base, u64 size);
+
+/**
+ * lmb_region_find() - Find the lowest region overlapping a range
+ *
+ * @rgn:	Region set to search
+ * @base:	Start of the range
+ * @size:	Size of the range in bytes
+ * @return region, or NULL if nothing overlaps the range
+ */
+struct lmb_property *lmb_region_find(struct lmb_region *rgn, u64 base,
+				     u64 size);
+
+/**
+ * lmb_region_below() - Find the region with the highest base below an address
+ *
+ * @rgn:	Region set to search
+ * @addr:	Address to search below
+ * @return region, or NULL if no region starts below @addr
+ */
+struct lmb_property *lmb_region_below(struct lmb_region *rgn, u64 addr);
+
+/**
+ * lmb_region_covered() - Check that a range only holds one type of region
+ *
+ * @rgn:	Region set to search
+ * @base:	Start of the range
+ * @size:	Size of the range in bytes
+ * @type:	Type to check for
+ * @return true if regions of type @type cover all of the range
+ */
+bool lmb_region_covered(struct lmb_region *rgn, u64 base, u64 size,
+			ulong type);
+
+static inline struct lmb_property *lmb_property_of(struct rb_node *node)
+{
+	return node ? rb_entry(node, struct lmb_property, node) : NULL;
+}
+
+/* Iterate over a region set in order of address, in either direction */
+static inline struct lmb_property *lmb_region_first(struct lmb_region *rgn)
+{
+	return lmb_property_of(rb_first(&rgn->root));
+}
+
+static inline struct lmb_property *lmb_region_last(struct lmb_region *rgn)
+{
+	return lmb_property_of(rb_last(&rgn->root));
+}
+
+static inline struct lmb_property *lmb_region_next(struct lmb_property *prop)
+{
+	return lmb_property_of(rb_next(&prop->node));
+}
+
+static inline struct lmb_property *lmb_region_prev(struct lmb_property *prop)
 {
-	return type->region[region_nr].size;
+	return lmb_property_of(rb_prev(&prop->node));
 }
 
 void board_lmb_reserve(struct lmb *lmb);
@@ -876,7 +876,8 @@ extern Void_t*     sbrk();
 #define malloc malloc_simple
 #define realloc realloc_simple
 #define memalign memalign_simple
-static inline void free(void *ptr) {}
+void free_simple(void *ptr);
+static inline void free(void *ptr) { free_simple(ptr); }
 void *calloc(size_t nmemb, size_t size);
 void *memalign_simple(size_t alignment, size_t bytes);
 void *realloc_simple(void *ptr, size_t size);
@@ -913,6 +914,39 @@ int initf_malloc(void);
 
 /* Simple versions which can be used when space is tight */
 void *malloc_simple(size_t size);
+void *memalign_simple(size_t alignment, size_t bytes);
+
+/*
+ * free_simple() - Free memory from malloc_simple()
+ *
+ * This does nothing unless CONFIG_SYS_MALLOC_F_FREE is enabled.
+ */
+void free_simple(void *ptr);
+
+/**
+ * malloc_simple_mark() - Mark the current top of the malloc_simple() pool
+ *
+ * This allows temporary allocations to be released together with
+ * malloc_simple_release(), even without CONFIG_SYS_MALLOC_F_FREE.
+ *
+ * @return mark to pass to malloc_simple_release()
+ */
+ulong malloc_simple_mark(void);
+
+/**
+ * malloc_simple_release() - Release everything allocated since a mark
+ *
+ * The memory allocated since malloc_simple_mark() returned @mark must not
+ * be used afterwards. With CONFIG_SYS_MALLOC_F_FREE an allocation made
+ * since the mark may reuse a free block below @mark. Such a block is not
+ * released here and stays allocated until it is passed to free().
+ *
+ * @mark:	Value returned by malloc_simple_mark()
+ */
+void malloc_simple_release(ulong mark);
+
+/* Print the usage and peak usage of the malloc_simple() pool */
+void malloc_simple_info(void);
 
 #pragma GCC visibility push(hidden)
 # if __STD_C
@@ -957,6 +991,50 @@ extern ulong mem_malloc_brk;
 
 void mem_malloc_init(ulong start, ulong size);
 
+/* Largest request served by the size-class slab allocator */
+#define MALLOC_SLAB_MAX		1024
+
+/**
+ * malloc_slab_init() - Set up the slab allocator at the top of the heap
+ *
+ * @end:	End of the malloc() area
+ * @size:	Size of the malloc() area
+ * @return number of bytes taken from the top of the area
+ */
+ulong malloc_slab_init(ulong end, ulong size);
+
+/**
+ * malloc_slab_alloc() - Allocate a small object from the slabs
+ *
+ * @bytes:	Number of bytes to allocate
+ * @return pointer to the object, or NULL if @bytes is larger than
+ *	MALLOC_SLAB_MAX or no slab page is free
+ */
+void *malloc_slab_alloc(size_t bytes);
+
+/**
+ * malloc_slab_owns() - Check if an object was allocated from the slabs
+ *
+ * @mem:	Pointer returned by malloc()
+ * @return true if malloc_slab_alloc() returned @mem
+ */
+bool malloc_slab_owns(const void *mem);
+
+/* Free an object for which malloc_slab_owns() is true */
+void malloc_slab_free(void *mem);
+
+/* Get the usable size of an object for which malloc_slab_owns() is true */
+size_t malloc_slab_usable_size(const void *mem);
+
+/* Get the number of bytes taken from the heap for the slabs */
+ulong malloc_slab_size(void);
+
+/* Get the number of bytes allocated from the slabs */
+ulong malloc_slab_inuse(void);
+
+/* Print the slab allocator statistics */
+void malloc_slab_print_stats(void);
+
 #ifdef __cplusplus
 };  /* end of extern "C" */
 #endif
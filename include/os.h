@@ -330,4 +330,50 @@ int os_spl_to_uboot(const char *fname);
  */
 void os_localtime(struct rtc_time *rt);
 
+/**
+ * os_profile_timer() - Call a function periodically with the CPU registers
+ *
+ * This uses a profiling timer, which counts the CPU time used by U-Boot,
+ * so that samples are not taken while sandbox is waiting for input.
+ *
+ * @interval_us:	Interval between calls in microseconds, or 0 to stop
+ * @func:		Function to call with the program counter, frame
+ *			pointer and stack pointer that were interrupted
+ * @return 0 if OK, -ENOSYS if this host is not supported, other -ve on
+ * error
+ */
+int os_profile_timer(unsigned int interval_us,
+		     void (*func)(unsigned long pc, unsigned long fp,
+				  unsigned long sp));
+
+/**
+ * os_perf_open() - Open a host hardware performance counter
+ *
+ * The counter counts events in this process, outside the kernel. It is
+ * disabled until os_perf_enable() is called. Close it with os_close().
+ *
+ * @hw_event:	Linux PERF_COUNT_HW_... event to count
+ * @return file descriptor if OK, -ve on error, e.g. if the host does not
+ * allow access to performance counters
+ */
+int os_perf_open(unsigned int hw_event);
+
+/**
+ * os_perf_enable() - Start or stop a host performance counter
+ *
+ * @fd:		File descriptor from os_perf_open()
+ * @enable:	1 to reset the count and start counting, 0 to stop
+ * @return 0 if OK, -ve on error
+ */
+int os_perf_enable(int fd, int enable);
+
+/**
+ * os_perf_read() - Read a host performance counter
+ *
+ * @fd:		File descriptor from os_perf_open()
+ * @countp:	Returns the count
+ * @return 0 if OK, -ve on error
+ */
+int os_perf_read(int fd, uint64_t *countp);
+
 #endif
@@ -0,0 +1,129 @@
+/*
+ * Performance counters
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __PERF_H
+#define __PERF_H
+
+/*
+ * Events which a performance counter device can count. Drivers map these
+ * to the nearest hardware events, e.g. L1 data cache accesses on ARM.
+ */
+enum perf_event_id {
+	PERF_EVENT_CYCLES,		/* CPU cycles */
+	PERF_EVENT_INSTRUCTIONS,	/* Instructions retired */
+	PERF_EVENT_CACHE_REFS,		/* Cache accesses */
+	PERF_EVENT_CACHE_MISSES,	/* Cache misses */
+	PERF_EVENT_BRANCHES,		/* Branch instructions */
+	PERF_EVENT_BRANCH_MISSES,	/* Mispredicted branches */
+
+	PERF_EVENT_COUNT,
+};
+
+/**
+ * struct perf_uc_priv - information about a device used by the uclass
+ *
+ * @events:	Mask of events the device can count, (1 << PERF_EVENT_...).
+ *		Set by the driver when probed.
+ * @counters:	Number of events the device can count at once, not
+ *		including cycles if @cycle_counter is set. Set by the driver
+ *		when probed.
+ * @cycle_counter: true if cycles are counted by a counter of their own,
+ *		in addition to @counters. Set by the driver when probed.
+ * @counting:	Mask of events being counted since the last perf_start()
+ */
+struct perf_uc_priv {
+	uint events;
+	uint counters;
+	bool cycle_counter;
+	uint counting;
+};
+
+/**
+ * struct perf_ops - Driver model performance counter operations
+ *
+ * The uclass interface is implemented by all performance counter devices
+ * which use driver model.
+ */
+struct perf_ops {
+	/**
+	 * start() - Reset counters and start counting events
+	 *
+	 * @dev:	Device to start
+	 * @events:	Mask of events to count. This only includes events
+	 *		the device supports, and no more than it can count at
+	 *		once
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*start)(struct udevice *dev, uint events);
+
+	/**
+	 * stop() - Stop counting, keeping the counts for read()
+	 *
+	 * @dev:	Device to stop
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*stop)(struct udevice *dev);
+
+	/**
+	 * read() - Read the count of an event
+	 *
+	 * @dev:	Device to read
+	 * @event:	Event to read, which was passed to start()
+	 * @countp:	Returns the count
+	 * @return 0 if OK, -EOVERFLOW if the counter wrapped, other -ve on
+	 *	error
+	 */
+	int (*read)(struct udevice *dev, enum perf_event_id event,
+		    u64 *countp);
+};
+
+#define perf_get_ops(dev)	((struct perf_ops *)(dev)->driver->ops)
+
+/**
+ * perf_start() - Reset counters and start counting events
+ *
+ * Events which the device does not support are ignored. If the device
+ * cannot count all the others at once, it counts the first ones, in the
+ * order of enum perf_event_id.
+ *
+ * @dev:	Device to start
+ * @events:	Mask of events to count, (1 << PERF_EVENT_...)
+ * @return mask of the events being counted, or -ve on error
+ */
+int perf_start(struct udevice *dev, uint events);
+
+/**
+ * perf_stop() - Stop counting, keeping the counts
+ *
+ * @dev:	Device to stop
+ * @return 0 if OK, -ve on error
+ */
+int perf_stop(struct udevice *dev);
+
+/**
+ * perf_read() - Read the count of an event
+ *
+ * @dev:	Device to read
+ * @event:	Event to read
+ * @countp:	Returns the count
+ * Counts are 64-bit. Devices with narrower counters either extend them,
+ * which may need a read before the counter wraps twice, or report
+ * -EOVERFLOW.
+ *
+ * @return 0 if OK, -ENOENT if the event is not being counted, -EOVERFLOW
+ *	if the counter wrapped, other -ve on error
+ */
+int perf_read(struct udevice *dev, enum perf_event_id event, u64 *countp);
+
+/**
+ * perf_get_event_name() - Get the name of an event
+ *
+ * @event:	Event to look up
+ * @return name of the event, e.g. "cycles"
+ */
+const char *perf_get_event_name(enum perf_event_id event);
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Sampling profiler
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+/**
+ * profile_sample() - Record where the CPU was interrupted
+ *
+ * Architecture code calls this from the profiling timer interrupt, which
+ * it sets up in profile_timer_start().
+ *
+ * @pc:		Program counter of the interrupted code
+ * @fp:		Frame pointer of the interrupted code, or 0 if not known
+ * @sp:		Stack pointer of the interrupted code, or 0 if not known
+ */
+void profile_sample(ulong pc, ulong fp, ulong sp);
+
+/**
+ * profile_timer_start() - Start the profiling timer
+ *
+ * Architectures which can profile implement this to call profile_sample()
+ * @rate times a second until profile_timer_stop() is called.
+ *
+ * @rate:	Number of samples a second
+ * @return 0 if OK, -ENOSYS if the architecture cannot profile, or other
+ *	-ve error
+ */
+int profile_timer_start(uint rate);
+
+/**
+ * profile_timer_stop() - Stop the profiling timer
+ */
+void profile_timer_stop(void);
+
+/**
+ * profile_start() - Start sampling, discarding any earlier samples
+ *
+ * @rate:	Number of samples a second
+ * @return 0 if OK, -ve on error
+ */
+int profile_start(uint rate);
+
+/**
+ * profile_stop() - Stop sampling, keeping the samples taken so far
+ */
+void profile_stop(void);
+
+/**
+ * profile_print_stats() - Print statistics about the samples taken
+ */
+void profile_print_stats(void);
+
+/**
+ * profile_list_samples() - Dump the samples into a buffer
+ *
+ * This writes a struct trace_output_hdr followed by a struct trace_sample
+ * for each sample, oldest first, as read by proftool.
+ *
+ * @buff:	Buffer in which to place data
+ * @buff_size:	Size of buffer
+ * @needed:	Returns number of bytes used / needed
+ * @return 0 if ok, -1 on error (buffer exhausted)
+ */
+int profile_list_samples(void *buff, int buff_size, unsigned int *needed);
+
+#endif
@@ -464,6 +464,22 @@ struct dm_spi_ops {
 	 *	   is invalid, other -ve value on error
 	 */
 	int (*cs_info)(struct udevice *bus, uint cs, struct spi_cs_info *info);
+
+	/**
+	 * get_mmap() - Get memory-mapped SPI
+	 *
+	 * Some controllers can map the attached flash into the CPU address
+	 * space, so that it can be read (and executed) in place without
+	 * going through xfer().
+	 *
+	 * @dev:	The SPI slave device
+	 * @map_basep:	Returns base memory address of the window
+	 * @map_sizep:	Returns size of the window in bytes
+	 * @offsetp:	Returns the flash offset which appears at @map_basep
+	 * @return 0 if OK, -EFAULT if memory mapping is not available
+	 */
+	int (*get_mmap)(struct udevice *dev, ulong *map_basep, uint *map_sizep,
+			uint *offsetp);
 };
 
 struct dm_spi_emul_ops {
@@ -651,6 +667,18 @@ void dm_spi_release_bus(struct udevice *dev);
 int dm_spi_xfer(struct udevice *dev, unsigned int bitlen,
 		const void *dout, void *din, unsigned long flags);
 
+/**
+ * dm_spi_get_mmap() - Get memory-mapped window of a SPI slave
+ *
+ * @dev:	The SPI slave device
+ * @map_basep:	Returns base memory address of the window
+ * @map_sizep:	Returns size of the window in bytes
+ * @offsetp:	Returns the flash offset which appears at @map_basep
+ * @return 0 if OK, -EFAULT if the controller has no memory-mapped window
+ */
+int dm_spi_get_mmap(struct udevice *dev, ulong *map_basep, uint *map_sizep,
+		    uint *offsetp);
+
 /* Access the operations for a SPI device */
 #define spi_get_ops(dev)	((struct dm_spi_ops *)(dev)->driver->ops)
 #define spi_emul_get_ops(dev)	((struct dm_spi_emul_ops *)(dev)->driver->ops)
@@ -28,6 +28,20 @@
 
 struct spi_slave;
 
+/* Number of erase block sizes a flash can have */
+#define SPI_FLASH_MAX_ERASE_TYPES	4
+
+/**
+ * struct spi_flash_erase_type - an erase block size supported by a flash
+ *
+ * @size:	Erase block size in bytes, 0 if the entry is unused
+ * @cmd:	Erase command for this block size
+ */
+struct spi_flash_erase_type {
+	u32 size;
+	u8 cmd;
+};
+
 /**
  * struct spi_flash - SPI flash structure
  *
@@ -45,9 +59,12 @@ struct spi_slave;
  * @bank_write_cmd:	Bank write cmd
  * @bank_curr:		Current flash bank
  * @erase_cmd:		Erase cmd 4K, 32K, 64K
+ * @erase_types:	Erase block sizes usable on this flash, smallest first.
+ *			The smallest one is always @erase_size/@erase_cmd
  * @read_cmd:		Read cmd - Array Fast, Extn read and quad read.
  * @write_cmd:		Write cmd - page and quad program.
  * @dummy_byte:		Dummy cycles for read operation.
+ * @addr_width:		Number of address bytes sent with each command (3 or 4)
  * @memory_map:		Address of read-only SPI flash access
  * @flash_lock:		lock a region of the SPI Flash
  * @flash_unlock:	unlock a region of the SPI Flash
@@ -80,9 +97,11 @@ struct spi_flash {
 	u8 bank_curr;
 #endif
 	u8 erase_cmd;
+	struct spi_flash_erase_type erase_types[SPI_FLASH_MAX_ERASE_TYPES];
 	u8 read_cmd;
 	u8 write_cmd;
 	u8 dummy_byte;
+	u8 addr_width;
 
 	void *memory_map;
 
@@ -0,0 +1,13 @@
+/*
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TEST_AHCI_H__
+#define __TEST_AHCI_H__
+
+#include <test/test.h>
+
+/* Declare a new AHCI test */
+#define AHCI_TEST(_name, _flags)	UNIT_TEST(_name, _flags, ahci_test)
+
+#endif /* __TEST_AHCI_H__ */
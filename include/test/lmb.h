@@ -0,0 +1,13 @@
+/*
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TEST_LMB_H__
+#define __TEST_LMB_H__
+
+#include <test/test.h>
+
+/* Declare a new lmb test */
+#define LMB_TEST(_name, _flags)	UNIT_TEST(_name, _flags, lmb_test)
+
+#endif /* __TEST_LMB_H__ */
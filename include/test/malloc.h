@@ -0,0 +1,13 @@
+/*
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TEST_MALLOC_H__
+#define __TEST_MALLOC_H__
+
+#include <test/test.h>
+
+/* Declare a new malloc test */
+#define MALLOC_TEST(_name, _flags)	UNIT_TEST(_name, _flags, malloc_test)
+
+#endif /* __TEST_MALLOC_H__ */
@@ -0,0 +1,13 @@
+/*
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TEST_UBISPL_H__
+#define __TEST_UBISPL_H__
+
+#include <test/test.h>
+
+/* Declare a new SPL UBI loader test */
+#define UBISPL_TEST(_name, _flags)	UNIT_TEST(_name, _flags, ubispl_test)
+
+#endif /* __TEST_UBISPL_H__ */
@@ -29,6 +29,8 @@ enum {
 enum trace_chunk_type {
 	TRACE_CHUNK_FUNCS,
 	TRACE_CHUNK_CALLS,
+	TRACE_CHUNK_SAMPLES,
+	TRACE_CHUNK_GRAPH,
 };
 
 /* A trace record for a function, as written to the profile output file */
@@ -80,6 +82,47 @@ struct trace_call {
 
 int trace_list_calls(void *buff, int buff_size, unsigned int *needed);
 
+/*
+ * A call graph record, as written to the profile output file. Each one is
+ * a call path, identified by the function called and the record for the
+ * path it was called from, numbered from 1. Parents come before children.
+ */
+struct trace_graph {
+	uint32_t parent;	/* Record of the caller, 0 if none */
+	uint32_t func;		/* Function offset */
+	uint32_t call_count;	/* Number of calls along this path */
+	uint32_t reserved;
+	uint64_t total_us;	/* Time in these calls, including callees */
+	uint64_t self_us;	/* Time in these calls, excluding callees */
+};
+
+/**
+ * Dump the call graph into a buffer
+ *
+ * Each record in the buffer is a struct trace_graph.
+ *
+ * @param buff		Buffer in which to place data, or NULL to count size
+ * @param buff_size	Size of buffer
+ * @param needed	Returns number of bytes used / needed
+ * @return 0 if ok, -1 on error (buffer exhausted)
+ */
+int trace_list_graph(void *buff, int buff_size, unsigned int *needed);
+
+enum {
+	TRACE_SAMPLE_DEPTH	= 8,	/* Stack entries kept for each sample */
+};
+
+/*
+ * A sample from the sampling profiler. The first stack entry is the code
+ * offset of the interrupted PC, the others are offsets of the return
+ * addresses found by following the frame pointers, innermost first.
+ */
+struct trace_sample {
+	uint32_t timestamp;	/* Time of the sample in microseconds */
+	uint32_t depth;		/* Number of valid stack entries */
+	uint32_t stack[TRACE_SAMPLE_DEPTH];
+};
+
 /**
  * Turn function tracing on and off
  *
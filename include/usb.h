@@ -730,6 +730,17 @@ struct dm_usb_ops {
 	 * reset_root_port() - Reset usb root port
 	 */
 	int (*reset_root_port)(struct udevice *bus, struct usb_device *udev);
+
+	/**
+	 * get_max_xfer_size() - Get the largest bulk transfer supported
+	 *
+	 * Class drivers use this to size their transfers, e.g. the number
+	 * of blocks read by one mass storage command.
+	 *
+	 * @size: Returns the maximum number of bytes in one transfer
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*get_max_xfer_size)(struct udevice *bus, size_t *size);
 };
 
 #define usb_get_ops(dev)	((struct dm_usb_ops *)(dev)->driver->ops)
@@ -912,6 +923,15 @@ int usb_new_device(struct usb_device *dev);
 
 int usb_alloc_device(struct usb_device *dev);
 
+/**
+ * usb_get_max_xfer_size() - Get the largest bulk transfer of a controller
+ *
+ * @dev:	USB device attached to the controller
+ * @size:	Returns the maximum number of bytes in one transfer
+ * @return 0 if OK, -ENOSYS if the controller does not report it
+ */
+int usb_get_max_xfer_size(struct usb_device *dev, size_t *size);
+
 /**
  * usb_emul_setup_device() - Set up a new USB device emulation
  *
@@ -8,152 +8,97 @@
 
 #include <common.h>
 #include <efi_loader.h>
+#include <lmb.h>
 #include <malloc.h>
 #include <asm/global_data.h>
 #include <libfdt_env.h>
-#include <linux/list_sort.h>
 #include <inttypes.h>
 #include <watchdog.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
-struct efi_mem_list {
-	struct list_head link;
-	struct efi_mem_desc desc;
-};
-
-#define EFI_CARVE_NO_OVERLAP		-1
-#define EFI_CARVE_LOOP_AGAIN		-2
-#define EFI_CARVE_OVERLAPS_NONRAM	-3
-
-/* This list contains all memory map items */
-LIST_HEAD(efi_mem);
+/*
+ * The memory map. It uses the same region sets as lmb, with the EFI memory
+ * type of each region as its type.
+ */
+static struct lmb_region efi_mem;
 
 #ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
 void *efi_bounce_buffer;
 #endif
 
 /*
- * U-Boot services each EFI AllocatePool request as a separate
- * (multiple) page allocation.  We have to track the number of pages
- * to be able to free the correct amount later.
- * EFI requires 8 byte alignment for pool allocations, so we can
- * prepend each allocation with an 64 bit header tracking the
- * allocation size, and hand out the remainder to the caller.
+ * EFI applications make many small pool allocations. Requests of up to
+ * EFI_POOL_MAX bytes are served from slabs: runs of EFI_POOL_SLAB_PAGES
+ * pages of the pool's memory type, split into blocks of one size. There is
+ * a list of slabs with free blocks for each memory type and block size.
+ * Larger requests get pages of their own.
+ *
+ * Each allocation starts with a 64 bit header, which keeps the 8 byte
+ * alignment EFI requires for pool memory. For a block it holds the offset
+ * of the block in its slab, so the slab can be found when it is freed.
  */
 struct efi_pool_allocation {
-	u64 num_pages;
+	u32 num_pages;		/* Pages allocated, or 0 for a block */
+	u32 offset;		/* Offset of a block from its slab */
 	char data[];
 };
 
-/*
- * Sorts the memory list from highest address to lowest address
+/**
+ * struct efi_pool_slab - header at the start of a slab
  *
- * When allocating memory we should always start from the highest
- * address chunk, so sort the memory list such that the first list
- * iterator gets the highest address and goes lower from there.
+ * @list:	Node in the list of slabs with free blocks, empty if full
+ * @free:	First free block
+ * @inuse:	Number of blocks allocated
+ * @memory_type: Memory type of the pool
+ * @class:	Size class of the blocks, see efi_pool_class()
  */
-static int efi_mem_cmp(void *priv, struct list_head *a, struct list_head *b)
-{
-	struct efi_mem_list *mema = list_entry(a, struct efi_mem_list, link);
-	struct efi_mem_list *memb = list_entry(b, struct efi_mem_list, link);
+struct efi_pool_slab {
+	struct list_head list;
+	struct efi_pool_allocation *free;
+	u32 inuse;
+	u16 memory_type;
+	u16 class;
+};
 
-	if (mema->desc.physical_start == memb->desc.physical_start)
-		return 0;
-	else if (mema->desc.physical_start < memb->desc.physical_start)
-		return 1;
-	else
-		return -1;
-}
+#define EFI_POOL_SLAB_PAGES	4
+#define EFI_POOL_SLAB_SIZE	(EFI_POOL_SLAB_PAGES << EFI_PAGE_SHIFT)
+#define EFI_POOL_SLAB_HDR	ALIGN(sizeof(struct efi_pool_slab), 8)
+#define EFI_POOL_MIN_BLOCK	32
+#define EFI_POOL_CLASSES	7
+#define EFI_POOL_MAX_BLOCK	(EFI_POOL_MIN_BLOCK << (EFI_POOL_CLASSES - 1))
+#define EFI_POOL_MAX		(EFI_POOL_MAX_BLOCK - \
+				 sizeof(struct efi_pool_allocation))
 
-static void efi_mem_sort(void)
-{
-	list_sort(NULL, &efi_mem, efi_mem_cmp);
-}
+static struct list_head efi_pools[EFI_MAX_MEMORY_TYPE][EFI_POOL_CLASSES];
 
-/*
- * Unmaps all memory occupied by the carve_desc region from the
- * list entry pointed to by map.
- *
- * Returns EFI_CARVE_NO_OVERLAP if the regions don't overlap.
- * Returns EFI_CARVE_OVERLAPS_NONRAM if the carve and map overlap,
- *    and the map contains anything but free ram.
- *    (only when overlap_only_ram is true)
- * Returns EFI_CARVE_LOOP_AGAIN if the mapping list should be traversed
- *    again, as it has been altered
- * Returns the number of overlapping pages. The pages are removed from
- *     the mapping list.
- *
- * In case of EFI_CARVE_OVERLAPS_NONRAM it is the callers responsibility
- * to readd the already carved out pages to the mapping.
- */
-static int efi_mem_carve_out(struct efi_mem_list *map,
-			     struct efi_mem_desc *carve_desc,
-			     bool overlap_only_ram)
+static void efi_mem_desc(struct lmb_property *prop, struct efi_mem_desc *desc)
 {
-	struct efi_mem_list *newmap;
-	struct efi_mem_desc *map_desc = &map->desc;
-	uint64_t map_start = map_desc->physical_start;
-	uint64_t map_end = map_start + (map_desc->num_pages << EFI_PAGE_SHIFT);
-	uint64_t carve_start = carve_desc->physical_start;
-	uint64_t carve_end = carve_start +
-			     (carve_desc->num_pages << EFI_PAGE_SHIFT);
-
-	/* check whether we're overlapping */
-	if ((carve_end <= map_start) || (carve_start >= map_end))
-		return EFI_CARVE_NO_OVERLAP;
-
-	/* We're overlapping with non-RAM, warn the caller if desired */
-	if (overlap_only_ram && (map_desc->type != EFI_CONVENTIONAL_MEMORY))
-		return EFI_CARVE_OVERLAPS_NONRAM;
-
-	/* Sanitize carve_start and carve_end to lie within our bounds */
-	carve_start = max(carve_start, map_start);
-	carve_end = min(carve_end, map_end);
-
-	/* Carving at the beginning of our map? Just move it! */
-	if (carve_start == map_start) {
-		if (map_end == carve_end) {
-			/* Full overlap, just remove map */
-			list_del(&map->link);
-			free(map);
-		} else {
-			map->desc.physical_start = carve_end;
-			map->desc.num_pages = (map_end - carve_end)
-					      >> EFI_PAGE_SHIFT;
-		}
+	memset(desc, '\0', sizeof(*desc));
+	desc->type = prop->type;
+	desc->physical_start = prop->base;
+	desc->virtual_start = prop->base;
+	desc->num_pages = prop->size >> EFI_PAGE_SHIFT;
 
-		return (carve_end - carve_start) >> EFI_PAGE_SHIFT;
+	switch (prop->type) {
+	case EFI_RUNTIME_SERVICES_CODE:
+	case EFI_RUNTIME_SERVICES_DATA:
+		desc->attribute = (1 << EFI_MEMORY_WB_SHIFT) |
+				  (1ULL << EFI_MEMORY_RUNTIME_SHIFT);
+		break;
+	case EFI_MMAP_IO:
+		desc->attribute = 1ULL << EFI_MEMORY_RUNTIME_SHIFT;
+		break;
+	default:
+		desc->attribute = 1 << EFI_MEMORY_WB_SHIFT;
+		break;
 	}
-
-	/*
-	 * Overlapping maps, just split the list map at carve_start,
-	 * it will get moved or removed in the next iteration.
-	 *
-	 * [ map_desc |__carve_start__| newmap ]
-	 */
-
-	/* Create a new map from [ carve_start ... map_end ] */
-	newmap = calloc(1, sizeof(*newmap));
-	newmap->desc = map->desc;
-	newmap->desc.physical_start = carve_start;
-	newmap->desc.num_pages = (map_end - carve_start) >> EFI_PAGE_SHIFT;
-	/* Insert before current entry (descending address order) */
-	list_add_tail(&newmap->link, &map->link);
-
-	/* Shrink the map to [ map_start ... carve_start ] */
-	map_desc->num_pages = (carve_start - map_start) >> EFI_PAGE_SHIFT;
-
-	return EFI_CARVE_LOOP_AGAIN;
 }
 
 uint64_t efi_add_memory_map(uint64_t start, uint64_t pages, int memory_type,
 			    bool overlap_only_ram)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *newlist;
-	bool carve_again;
-	uint64_t carved_pages = 0;
+	uint64_t len = pages << EFI_PAGE_SHIFT;
 
 	debug("%s: 0x%" PRIx64 " 0x%" PRIx64 " %d %s\n", __func__,
 	      start, pages, memory_type, overlap_only_ram ? "yes" : "no");
@@ -161,115 +106,39 @@ uint64_t efi_add_memory_map(uint64_t start, uint64_t pages, int memory_type,
 	if (!pages)
 		return start;
 
-	newlist = calloc(1, sizeof(*newlist));
-	newlist->desc.type = memory_type;
-	newlist->desc.physical_start = start;
-	newlist->desc.virtual_start = start;
-	newlist->desc.num_pages = pages;
-
-	switch (memory_type) {
-	case EFI_RUNTIME_SERVICES_CODE:
-	case EFI_RUNTIME_SERVICES_DATA:
-		newlist->desc.attribute = (1 << EFI_MEMORY_WB_SHIFT) |
-					  (1ULL << EFI_MEMORY_RUNTIME_SHIFT);
-		break;
-	case EFI_MMAP_IO:
-		newlist->desc.attribute = 1ULL << EFI_MEMORY_RUNTIME_SHIFT;
-		break;
-	default:
-		newlist->desc.attribute = 1 << EFI_MEMORY_WB_SHIFT;
-		break;
-	}
-
-	/* Add our new map */
-	do {
-		carve_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			int r;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			r = efi_mem_carve_out(lmem, &newlist->desc,
-					      overlap_only_ram);
-			switch (r) {
-			case EFI_CARVE_OVERLAPS_NONRAM:
-				/*
-				 * The user requested to only have RAM overlaps,
-				 * but we hit a non-RAM region. Error out.
-				 */
-				return 0;
-			case EFI_CARVE_NO_OVERLAP:
-				/* Just ignore this list entry */
-				break;
-			case EFI_CARVE_LOOP_AGAIN:
-				/*
-				 * We split an entry, but need to loop through
-				 * the list again to actually carve it.
-				 */
-				carve_again = true;
-				break;
-			default:
-				/* We carved a number of pages */
-				carved_pages += r;
-				carve_again = true;
-				break;
-			}
-
-			if (carve_again) {
-				/* The list changed, we need to start over */
-				break;
-			}
-		}
-	} while (carve_again);
-
-	if (overlap_only_ram && (carved_pages != pages)) {
-		/*
-		 * The payload wanted to have RAM overlaps, but we overlapped
-		 * with an unallocated region. Error out.
-		 */
+	/*
+	 * The payload wanted to have RAM overlaps only, but the range holds
+	 * something else or is not mapped at all. Error out.
+	 */
+	if (overlap_only_ram &&
+	    !lmb_region_covered(&efi_mem, start, len, EFI_CONVENTIONAL_MEMORY))
 		return 0;
-	}
-
-	/* Add our new map */
-        list_add_tail(&newlist->link, &efi_mem);
 
-	/* And make sure memory is listed in descending order */
-	efi_mem_sort();
+	/* Carve the range out of the map and add it with its new type */
+	if (lmb_region_set(&efi_mem, start, len, memory_type))
+		return 0;
 
 	return start;
 }
 
 static uint64_t efi_find_free_memory(uint64_t len, uint64_t max_addr)
 {
-	struct list_head *lhandle;
-
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem = list_entry(lhandle,
-			struct efi_mem_list, link);
-		struct efi_mem_desc *desc = &lmem->desc;
-		uint64_t desc_len = desc->num_pages << EFI_PAGE_SHIFT;
-		uint64_t desc_end = desc->physical_start + desc_len;
+	struct lmb_property *prop;
+
+	/* Start from the highest region below max_addr */
+	for (prop = lmb_region_below(&efi_mem, max_addr); prop;
+	     prop = lmb_region_prev(prop)) {
+		uint64_t desc_end = prop->base + prop->size;
 		uint64_t curmax = min(max_addr, desc_end);
-		uint64_t ret = curmax - len;
 
 		/* We only take memory from free RAM */
-		if (desc->type != EFI_CONVENTIONAL_MEMORY)
-			continue;
-
-		/* Out of bounds for max_addr */
-		if ((ret + len) > max_addr)
-			continue;
-
-		/* Out of bounds for upper map limit */
-		if ((ret + len) > desc_end)
+		if (prop->type != EFI_CONVENTIONAL_MEMORY)
 			continue;
 
-		/* Out of bounds for lower map limit */
-		if (ret < desc->physical_start)
-			continue;
-
-		/* Return the highest address in this map within bounds */
-		return ret;
+		/* Return the highest pages in this region within bounds */
+		curmax &= ~EFI_PAGE_MASK;
+		if (curmax >= prop->base && curmax - prop->base >= len)
+			return curmax - len;
 	}
 
 	return 0;
@@ -342,8 +211,8 @@ efi_status_t efi_free_pages(uint64_t memory, unsigned long pages)
 {
 	uint64_t r = 0;
 
+	/* This merges the pages with adjacent free regions */
 	r = efi_add_memory_map(memory, pages, EFI_CONVENTIONAL_MEMORY, false);
-	/* Merging of adjacent free regions is missing */
 
 	if (r == memory)
 		return EFI_SUCCESS;
@@ -351,23 +220,131 @@ efi_status_t efi_free_pages(uint64_t memory, unsigned long pages)
 	return EFI_NOT_FOUND;
 }
 
+/* Get the size class of a block which can hold len bytes */
+static int efi_pool_class(unsigned long len)
+{
+	int class = 0;
+
+	while ((EFI_POOL_MIN_BLOCK << class) < len)
+		class++;
+
+	return class;
+}
+
+/* Set up a new slab, with all its blocks free */
+static efi_status_t efi_pool_new_slab(int pool_type, int class,
+				      struct efi_pool_slab **slabp)
+{
+	ulong block_size = EFI_POOL_MIN_BLOCK << class;
+	struct efi_pool_allocation *alloc;
+	struct efi_pool_slab *slab;
+	efi_physical_addr_t t;
+	efi_status_t r;
+	ulong offset;
+
+	r = efi_allocate_pages(0, pool_type, EFI_POOL_SLAB_PAGES, &t);
+	if (r != EFI_SUCCESS)
+		return r;
+
+	slab = (void *)(uintptr_t)t;
+	slab->free = NULL;
+	slab->inuse = 0;
+	slab->memory_type = pool_type;
+	slab->class = class;
+
+	/* Chain the blocks from the top, so they are used in address order */
+	offset = EFI_POOL_SLAB_HDR +
+		 (EFI_POOL_SLAB_SIZE - EFI_POOL_SLAB_HDR) / block_size *
+		 block_size;
+	while (offset > EFI_POOL_SLAB_HDR) {
+		offset -= block_size;
+		alloc = (void *)slab + offset;
+		alloc->num_pages = 0;
+		alloc->offset = offset;
+		*(struct efi_pool_allocation **)alloc->data = slab->free;
+		slab->free = alloc;
+	}
+	*slabp = slab;
+
+	return EFI_SUCCESS;
+}
+
+static efi_status_t efi_pool_alloc_block(int pool_type, unsigned long size,
+					 void **buffer)
+{
+	int class = efi_pool_class(size + sizeof(struct efi_pool_allocation));
+	struct list_head *head = &efi_pools[pool_type][class];
+	struct efi_pool_allocation *alloc;
+	struct efi_pool_slab *slab;
+	efi_status_t r;
+
+	if (list_empty(head)) {
+		r = efi_pool_new_slab(pool_type, class, &slab);
+		if (r != EFI_SUCCESS)
+			return r;
+		list_add(&slab->list, head);
+	} else {
+		slab = list_first_entry(head, struct efi_pool_slab, list);
+	}
+
+	alloc = slab->free;
+	slab->free = *(struct efi_pool_allocation **)alloc->data;
+	if (!slab->free)
+		list_del_init(&slab->list);
+	slab->inuse++;
+	*buffer = alloc->data;
+
+	return EFI_SUCCESS;
+}
+
+static efi_status_t efi_pool_free_block(struct efi_pool_allocation *alloc)
+{
+	struct efi_pool_slab *slab = (void *)alloc - alloc->offset;
+	struct list_head *head;
+
+	/* Sanity check, was the supplied address returned by allocate_pool */
+	assert(slab->class < EFI_POOL_CLASSES && slab->inuse);
+
+	/* A full slab has a free block again */
+	if (list_empty(&slab->list)) {
+		head = &efi_pools[slab->memory_type][slab->class];
+		list_add(&slab->list, head);
+	}
+	*(struct efi_pool_allocation **)alloc->data = slab->free;
+	slab->free = alloc;
+
+	/* Give back empty slabs, but keep the last one for the next request */
+	if (!--slab->inuse && !list_is_singular(&slab->list)) {
+		list_del(&slab->list);
+		return efi_free_pages((uintptr_t)slab, EFI_POOL_SLAB_PAGES);
+	}
+
+	return EFI_SUCCESS;
+}
+
 efi_status_t efi_allocate_pool(int pool_type, unsigned long size,
 			       void **buffer)
 {
 	efi_status_t r;
 	efi_physical_addr_t t;
-	u64 num_pages = (size + sizeof(u64) + EFI_PAGE_MASK) >> EFI_PAGE_SHIFT;
+	u64 num_pages = (size + sizeof(struct efi_pool_allocation) +
+			 EFI_PAGE_MASK) >> EFI_PAGE_SHIFT;
 
 	if (size == 0) {
 		*buffer = NULL;
 		return EFI_SUCCESS;
 	}
 
+	if (size <= EFI_POOL_MAX && pool_type >= 0 &&
+	    pool_type < EFI_MAX_MEMORY_TYPE)
+		return efi_pool_alloc_block(pool_type, size, buffer);
+
 	r = efi_allocate_pages(0, pool_type, num_pages, &t);
 
 	if (r == EFI_SUCCESS) {
 		struct efi_pool_allocation *alloc = (void *)(uintptr_t)t;
 		alloc->num_pages = num_pages;
+		alloc->offset = 0;
 		*buffer = alloc->data;
 	}
 
@@ -380,6 +357,9 @@ efi_status_t efi_free_pool(void *buffer)
 	struct efi_pool_allocation *alloc;
 
 	alloc = container_of(buffer, struct efi_pool_allocation, data);
+	if (!alloc->num_pages)
+		return efi_pool_free_block(alloc);
+
 	/* Sanity check, was the supplied address returned by allocate_pool */
 	assert(((uintptr_t)alloc & EFI_PAGE_MASK) == 0);
 
@@ -395,13 +375,10 @@ efi_status_t efi_get_memory_map(unsigned long *memory_map_size,
 			       uint32_t *descriptor_version)
 {
 	ulong map_size = 0;
-	int map_entries = 0;
-	struct list_head *lhandle;
+	int map_entries = efi_mem.cnt;
+	struct lmb_property *prop;
 	unsigned long provided_map_size = *memory_map_size;
 
-	list_for_each(lhandle, &efi_mem)
-		map_entries++;
-
 	map_size = map_entries * sizeof(struct efi_mem_desc);
 
 	*memory_map_size = map_size;
@@ -415,17 +392,11 @@ efi_status_t efi_get_memory_map(unsigned long *memory_map_size,
 	if (provided_map_size < map_size)
 		return EFI_BUFFER_TOO_SMALL;
 
-	/* Copy list into array */
+	/* Copy the map into the array, in ascending order */
 	if (memory_map) {
-		/* Return the list in ascending order */
-		memory_map = &memory_map[map_entries - 1];
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			*memory_map = lmem->desc;
-			memory_map--;
-		}
+		for (prop = lmb_region_first(&efi_mem); prop;
+		     prop = lmb_region_next(prop))
+			efi_mem_desc(prop, memory_map++);
 	}
 
 	return EFI_SUCCESS;
@@ -436,7 +407,11 @@ int efi_memory_init(void)
 	unsigned long runtime_start, runtime_end, runtime_pages;
 	unsigned long uboot_start, uboot_pages;
 	unsigned long uboot_stack_size = 16 * 1024 * 1024;
-	int i;
+	int i, j;
+
+	for (i = 0; i < EFI_MAX_MEMORY_TYPE; i++)
+		for (j = 0; j < EFI_POOL_CLASSES; j++)
+			INIT_LIST_HEAD(&efi_pools[i][j]);
 
 	/* Add RAM */
 	for (i = 0; i < CONFIG_NR_DRAM_BANKS; i++) {
@@ -9,247 +9,238 @@
 
 #include <common.h>
 #include <lmb.h>
+#include <malloc.h>
 
 #define LMB_ALLOC_ANYWHERE	0
 
 void lmb_dump_all(struct lmb *lmb)
 {
 #ifdef DEBUG
+	struct lmb_property *prop;
 	unsigned long i;
 
 	debug("lmb_dump_all:\n");
 	debug("    memory.cnt		   = 0x%lx\n", lmb->memory.cnt);
 	debug("    memory.size		   = 0x%llx\n",
 	      (unsigned long long)lmb->memory.size);
-	for (i=0; i < lmb->memory.cnt ;i++) {
+	for (prop = lmb_region_first(&lmb->memory), i = 0; prop;
+	     prop = lmb_region_next(prop), i++) {
 		debug("    memory.reg[0x%lx].base   = 0x%llx\n", i,
-			(long long unsigned)lmb->memory.region[i].base);
+			(long long unsigned)prop->base);
 		debug("		   .size   = 0x%llx\n",
-			(long long unsigned)lmb->memory.region[i].size);
+			(long long unsigned)prop->size);
 	}
 
 	debug("\n    reserved.cnt	   = 0x%lx\n",
 		lmb->reserved.cnt);
 	debug("    reserved.size	   = 0x%llx\n",
 		(long long unsigned)lmb->reserved.size);
-	for (i=0; i < lmb->reserved.cnt ;i++) {
+	for (prop = lmb_region_first(&lmb->reserved), i = 0; prop;
+	     prop = lmb_region_next(prop), i++) {
 		debug("    reserved.reg[0x%lx].base = 0x%llx\n", i,
-			(long long unsigned)lmb->reserved.region[i].base);
+			(long long unsigned)prop->base);
 		debug("		     .size = 0x%llx\n",
-			(long long unsigned)lmb->reserved.region[i].size);
+			(long long unsigned)prop->size);
 	}
 #endif /* DEBUG */
 }
 
-static long lmb_addrs_overlap(phys_addr_t base1,
-		phys_size_t size1, phys_addr_t base2, phys_size_t size2)
+struct lmb_property *lmb_region_below(struct lmb_region *rgn, u64 addr)
 {
-	return ((base1 < (base2+size2)) && (base2 < (base1+size1)));
-}
+	struct rb_node *node = rgn->root.rb_node;
+	struct lmb_property *below = NULL;
 
-static long lmb_addrs_adjacent(phys_addr_t base1, phys_size_t size1,
-		phys_addr_t base2, phys_size_t size2)
-{
-	if (base2 == base1 + size1)
-		return 1;
-	else if (base1 == base2 + size2)
-		return -1;
+	while (node) {
+		struct lmb_property *prop = lmb_property_of(node);
 
-	return 0;
+		if (prop->base < addr) {
+			below = prop;
+			node = node->rb_right;
+		} else {
+			node = node->rb_left;
+		}
+	}
+
+	return below;
 }
 
-static long lmb_regions_adjacent(struct lmb_region *rgn,
-		unsigned long r1, unsigned long r2)
+static struct lmb_property *lmb_region_insert(struct lmb_region *rgn,
+		u64 base, u64 size, ulong type)
 {
-	phys_addr_t base1 = rgn->region[r1].base;
-	phys_size_t size1 = rgn->region[r1].size;
-	phys_addr_t base2 = rgn->region[r2].base;
-	phys_size_t size2 = rgn->region[r2].size;
+	struct rb_node **link = &rgn->root.rb_node, *parent = NULL;
+	struct lmb_property *prop;
+
+	prop = malloc(sizeof(*prop));
+	if (!prop)
+		return NULL;
+	prop->base = base;
+	prop->size = size;
+	prop->type = type;
+
+	while (*link) {
+		parent = *link;
+		if (base < lmb_property_of(parent)->base)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&prop->node, parent, link);
+	rb_insert_color(&prop->node, &rgn->root);
+	rgn->cnt++;
 
-	return lmb_addrs_adjacent(base1, size1, base2, size2);
+	return prop;
 }
 
-static void lmb_remove_region(struct lmb_region *rgn, unsigned long r)
+static void lmb_region_remove(struct lmb_region *rgn,
+			      struct lmb_property *prop)
 {
-	unsigned long i;
-
-	for (i = r; i < rgn->cnt - 1; i++) {
-		rgn->region[i].base = rgn->region[i + 1].base;
-		rgn->region[i].size = rgn->region[i + 1].size;
-	}
+	rb_erase(&prop->node, &rgn->root);
+	free(prop);
 	rgn->cnt--;
 }
 
-/* Assumption: base addr of region 1 < base addr of region 2 */
-static void lmb_coalesce_regions(struct lmb_region *rgn,
-		unsigned long r1, unsigned long r2)
+void lmb_region_init(struct lmb_region *rgn)
 {
-	rgn->region[r1].size += rgn->region[r2].size;
-	lmb_remove_region(rgn, r2);
+	struct lmb_property *prop;
+
+	while ((prop = lmb_region_first(rgn)))
+		lmb_region_remove(rgn, prop);
+	rgn->size = 0;
 }
 
 void lmb_init(struct lmb *lmb)
 {
-	/* Create a dummy zero size LMB which will get coalesced away later.
-	 * This simplifies the lmb_add() code below...
-	 */
-	lmb->memory.region[0].base = 0;
-	lmb->memory.region[0].size = 0;
-	lmb->memory.cnt = 1;
-	lmb->memory.size = 0;
-
-	/* Ditto. */
-	lmb->reserved.region[0].base = 0;
-	lmb->reserved.region[0].size = 0;
-	lmb->reserved.cnt = 1;
-	lmb->reserved.size = 0;
+	lmb_region_init(&lmb->memory);
+	lmb_region_init(&lmb->reserved);
 }
 
-/* This routine called with relocation disabled. */
-static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base, phys_size_t size)
+long lmb_region_clear(struct lmb_region *rgn, u64 base, u64 size)
 {
-	unsigned long coalesced = 0;
-	long adjacent, i;
-
-	if ((rgn->cnt == 1) && (rgn->region[0].size == 0)) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-		return 0;
-	}
-
-	/* First try and coalesce this LMB with another. */
-	for (i=0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-
-		if ((rgnbase == base) && (rgnsize == size))
-			/* Already have this region, so we're done */
-			return 0;
-
-		adjacent = lmb_addrs_adjacent(base,size,rgnbase,rgnsize);
-		if ( adjacent > 0 ) {
-			rgn->region[i].base -= size;
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		}
-		else if ( adjacent < 0 ) {
-			rgn->region[i].size += size;
-			coalesced++;
+	u64 end = base + size;
+	struct lmb_property *prop, *prev;
+
+	/* Trim the regions overlapping the range, from the top down */
+	for (prop = lmb_region_below(rgn, end);
+	     prop && prop->base + prop->size > base; prop = prev) {
+		u64 rgnend = prop->base + prop->size;
+
+		prev = lmb_region_prev(prop);
+		if (prop->base < base && rgnend > end) {
+			/* Split the region around the hole */
+			if (!lmb_region_insert(rgn, end, rgnend - end,
+					       prop->type))
+				return -1;
+			prop->size = base - prop->base;
+			rgn->size -= size;
 			break;
+		} else if (prop->base < base) {
+			prop->size = base - prop->base;
+			rgn->size -= rgnend - base;
+		} else if (rgnend > end) {
+			rgn->size -= end - prop->base;
+			prop->base = end;
+			prop->size = rgnend - end;
+		} else {
+			rgn->size -= prop->size;
+			lmb_region_remove(rgn, prop);
 		}
 	}
 
-	if ((i < rgn->cnt-1) && lmb_regions_adjacent(rgn, i, i+1) ) {
-		lmb_coalesce_regions(rgn, i, i+1);
-		coalesced++;
-	}
+	return 0;
+}
 
-	if (coalesced)
-		return coalesced;
-	if (rgn->cnt >= MAX_LMB_REGIONS)
+long lmb_region_set(struct lmb_region *rgn, u64 base, u64 size, ulong type)
+{
+	u64 end = base + size;
+	struct lmb_property *prev, *next;
+
+	if (!size)
+		return 0;
+	if (lmb_region_clear(rgn, base, size))
 		return -1;
 
-	/* Couldn't coalesce the LMB, so add it to the sorted table. */
-	for (i = rgn->cnt-1; i >= 0; i--) {
-		if (base < rgn->region[i].base) {
-			rgn->region[i+1].base = rgn->region[i].base;
-			rgn->region[i+1].size = rgn->region[i].size;
-		} else {
-			rgn->region[i+1].base = base;
-			rgn->region[i+1].size = size;
-			break;
+	/* Nothing overlaps now, so merge with the neighbours if possible */
+	prev = lmb_region_below(rgn, base);
+	next = prev ? lmb_region_next(prev) : lmb_region_first(rgn);
+	if (next && (next->type != type || next->base != end))
+		next = NULL;
+
+	if (prev && prev->type == type && prev->base + prev->size == base) {
+		prev->size += size;
+		if (next) {
+			prev->size += next->size;
+			lmb_region_remove(rgn, next);
 		}
+	} else if (next) {
+		/* This keeps the tree sorted as nothing lies in between */
+		next->base = base;
+		next->size += size;
+	} else if (!lmb_region_insert(rgn, base, size, type)) {
+		return -1;
 	}
-
-	if (base < rgn->region[0].base) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-	}
-
-	rgn->cnt++;
+	rgn->size += size;
 
 	return 0;
 }
 
-/* This routine may be called with relocation disabled. */
-long lmb_add(struct lmb *lmb, phys_addr_t base, phys_size_t size)
+struct lmb_property *lmb_region_find(struct lmb_region *rgn, u64 base,
+				     u64 size)
 {
-	struct lmb_region *_rgn = &(lmb->memory);
+	struct lmb_property *prop, *prev;
 
-	return lmb_add_region(_rgn, base, size);
-}
-
-long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
-{
-	struct lmb_region *rgn = &(lmb->reserved);
-	phys_addr_t rgnbegin, rgnend;
-	phys_addr_t end = base + size;
-	int i;
-
-	rgnbegin = rgnend = 0; /* supress gcc warnings */
+	if (!size)
+		return NULL;
+	prop = lmb_region_below(rgn, base + size);
+	if (!prop || prop->base + prop->size <= base)
+		return NULL;
 
-	/* Find the region where (base, size) belongs to */
-	for (i=0; i < rgn->cnt; i++) {
-		rgnbegin = rgn->region[i].base;
-		rgnend = rgnbegin + rgn->region[i].size;
-
-		if ((rgnbegin <= base) && (end <= rgnend))
-			break;
-	}
-
-	/* Didn't find the region */
-	if (i == rgn->cnt)
-		return -1;
+	/* Regions are disjoint, so the others overlapping are just below */
+	while ((prev = lmb_region_prev(prop)) &&
+	       prev->base + prev->size > base)
+		prop = prev;
 
-	/* Check to see if we are removing entire region */
-	if ((rgnbegin == base) && (rgnend == end)) {
-		lmb_remove_region(rgn, i);
-		return 0;
-	}
-
-	/* Check to see if region is matching at the front */
-	if (rgnbegin == base) {
-		rgn->region[i].base = end;
-		rgn->region[i].size -= size;
-		return 0;
-	}
+	return prop;
+}
 
-	/* Check to see if the region is matching at the end */
-	if (rgnend == end) {
-		rgn->region[i].size -= size;
-		return 0;
+bool lmb_region_covered(struct lmb_region *rgn, u64 base, u64 size,
+			ulong type)
+{
+	u64 end = base + size;
+	struct lmb_property *prop;
+
+	for (prop = lmb_region_below(rgn, end); end > base;
+	     prop = lmb_region_prev(prop)) {
+		if (!prop || prop->type != type ||
+		    prop->base + prop->size < end)
+			return false;
+		end = prop->base;
 	}
 
-	/*
-	 * We need to split the entry -  adjust the current one to the
-	 * beginging of the hole and add the region after hole.
-	 */
-	rgn->region[i].size = base - rgn->region[i].base;
-	return lmb_add_region(rgn, end, rgnend - end);
+	return true;
 }
 
-long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
+/* This routine may be called with relocation disabled. */
+long lmb_add(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
-	struct lmb_region *_rgn = &(lmb->reserved);
-
-	return lmb_add_region(_rgn, base, size);
+	return lmb_region_set(&lmb->memory, base, size, 0);
 }
 
-static long lmb_overlaps_region(struct lmb_region *rgn, phys_addr_t base,
-				phys_size_t size)
+long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
-	unsigned long i;
+	struct lmb_property *prop;
 
-	for (i=0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-		if ( lmb_addrs_overlap(base,size,rgnbase,rgnsize) ) {
-			break;
-		}
-	}
+	/* The range must lie within one reserved region */
+	prop = lmb_region_find(&lmb->reserved, base, size);
+	if (!prop || base < prop->base ||
+	    (u64)base + size > prop->base + prop->size)
+		return -1;
 
-	return (i < rgn->cnt) ? i : -1;
+	return lmb_region_clear(&lmb->reserved, base, size);
+}
+
+long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
+{
+	return lmb_region_set(&lmb->reserved, base, size, 0);
 }
 
 phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align)
@@ -270,9 +261,9 @@ phys_addr_t lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_
 	return alloc;
 }
 
-static phys_addr_t lmb_align_down(phys_addr_t addr, phys_size_t size)
+static u64 lmb_align_down(u64 addr, phys_size_t size)
 {
-	return addr & ~(size - 1);
+	return addr & ~((u64)size - 1);
 }
 
 static phys_addr_t lmb_align_up(phys_addr_t addr, ulong size)
@@ -282,41 +273,39 @@ static phys_addr_t lmb_align_up(phys_addr_t addr, ulong size)
 
 phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_addr_t max_addr)
 {
-	long i, j;
-	phys_addr_t base = 0;
-	phys_addr_t res_base;
+	struct lmb_property *mem, *rsv;
+	u64 base, last;
 
-	for (i = lmb->memory.cnt-1; i >= 0; i--) {
-		phys_addr_t lmbbase = lmb->memory.region[i].base;
-		phys_size_t lmbsize = lmb->memory.region[i].size;
+	for (mem = lmb_region_last(&lmb->memory); mem;
+	     mem = lmb_region_prev(mem)) {
+		u64 lmbbase = mem->base;
 
-		if (lmbsize < size)
+		if (mem->size < size)
 			continue;
-		if (max_addr == LMB_ALLOC_ANYWHERE)
-			base = lmb_align_down(lmbbase + lmbsize - size, align);
-		else if (lmbbase < max_addr) {
-			base = lmbbase + lmbsize;
-			if (base < lmbbase)
-				base = -1;
-			base = min(base, max_addr);
-			base = lmb_align_down(base - size, align);
-		} else
+		if (max_addr != LMB_ALLOC_ANYWHERE && lmbbase >= max_addr)
 			continue;
 
+		/* Only allocate what the caller can address */
+		last = min_t(u64, lmbbase + mem->size - 1, (phys_addr_t)-1);
+		if (max_addr != LMB_ALLOC_ANYWHERE)
+			last = min_t(u64, last, max_addr - 1);
+		if (last + 1 - lmbbase < size)
+			continue;
+		base = lmb_align_down(last + 1 - size, align);
+
 		while (base && lmbbase <= base) {
-			j = lmb_overlaps_region(&lmb->reserved, base, size);
-			if (j < 0) {
+			rsv = lmb_region_find(&lmb->reserved, base, size);
+			if (!rsv) {
 				/* This area isn't reserved, take it */
-				if (lmb_add_region(&lmb->reserved, base,
-							lmb_align_up(size,
-								align)) < 0)
+				if (lmb_region_set(&lmb->reserved, base,
+						   lmb_align_up(size, align),
+						   0) < 0)
 					return 0;
 				return base;
 			}
-			res_base = lmb->reserved.region[j].base;
-			if (res_base < size)
+			if (rsv->base < size)
 				break;
-			base = lmb_align_down(res_base - size, align);
+			base = lmb_align_down(rsv->base - size, align);
 		}
 	}
 	return 0;
@@ -324,15 +313,7 @@ phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phy
 
 int lmb_is_reserved(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
-
-	for (i = 0; i < lmb->reserved.cnt; i++) {
-		phys_addr_t upper = lmb->reserved.region[i].base +
-			lmb->reserved.region[i].size - 1;
-		if ((addr >= lmb->reserved.region[i].base) && (addr <= upper))
-			return 1;
-	}
-	return 0;
+	return lmb_region_find(&lmb->reserved, addr, 1) != NULL;
 }
 
 __weak void board_lmb_reserve(struct lmb *lmb)
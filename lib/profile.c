@@ -0,0 +1,188 @@
+/*
+ * Sampling profiler
+ *
+ * A periodic timer interrupt records where the CPU is, and optionally a few
+ * callers, in a ring buffer. Unlike function tracing this needs no special
+ * build and costs very little, so it can profile normal images.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <profile.h>
+#include <trace.h>
+#include <asm/sections.h>
+#ifdef CONFIG_SANDBOX
+#include <asm/state.h>
+#endif
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/*
+ * Where a stack frame keeps the caller's frame pointer and the return
+ * address: the frame pointer points at the saved frame pointer, with the
+ * return address just above it.
+ */
+#define FRAME_FP(fp)	(((ulong *)(fp))[0])
+#define FRAME_RET(fp)	(((ulong *)(fp))[1])
+#define PROFILE_FRAME_SIZE	(2 * sizeof(ulong))
+
+/**
+ * struct profile_state - state of the sampling profiler
+ *
+ * @ring:	Ring buffer of samples
+ * @size:	Number of samples the ring buffer holds
+ * @count:	Number of samples taken since profiling started
+ * @rate:	Number of samples a second
+ * @stack_top:	Top of the stack. Frames are only followed below this.
+ * @running:	true while sampling
+ */
+struct profile_state {
+	struct trace_sample *ring;
+	ulong size;
+	ulong count;
+	uint rate;
+	ulong stack_top;
+	bool running;
+};
+
+static struct profile_state profile;
+
+__weak int profile_timer_start(uint rate)
+{
+	return -ENOSYS;
+}
+
+__weak void profile_timer_stop(void)
+{
+}
+
+/* Convert a code address to an offset, as function tracing does */
+static uint32_t profile_offset(ulong addr)
+{
+#ifdef CONFIG_SANDBOX
+	return addr - (ulong)&_init;
+#else
+	if (gd->flags & GD_FLG_RELOC)
+		return addr - gd->relocaddr;
+
+	return addr - CONFIG_SYS_TEXT_BASE;
+#endif
+}
+
+void profile_sample(ulong pc, ulong fp, ulong sp)
+{
+	struct trace_sample *sample;
+	ulong low = sp;
+	uint depth = 1;
+
+	if (!profile.running)
+		return;
+
+	sample = &profile.ring[profile.count++ % profile.size];
+	sample->timestamp = timer_get_us();
+	sample->stack[0] = profile_offset(pc);
+
+	/*
+	 * Follow the frame pointers while they stay on the stack, between
+	 * the interrupted stack pointer and the top of the stack, and move
+	 * towards the top.
+	 */
+	while (IS_ENABLED(CONFIG_PROFILE_STACK) &&
+	       depth < TRACE_SAMPLE_DEPTH && sp &&
+	       fp >= low && fp + PROFILE_FRAME_SIZE <= profile.stack_top &&
+	       !(fp & (sizeof(ulong) - 1))) {
+		sample->stack[depth++] = profile_offset(FRAME_RET(fp));
+		low = fp + PROFILE_FRAME_SIZE;
+		fp = FRAME_FP(fp);
+	}
+	sample->depth = depth;
+}
+
+int profile_start(uint rate)
+{
+	int ret;
+
+	profile_stop();
+	if (!profile.ring) {
+		profile.size = CONFIG_PROFILE_SAMPLES;
+		profile.ring = calloc(profile.size, sizeof(*profile.ring));
+		if (!profile.ring)
+			return -ENOMEM;
+	}
+
+#ifdef CONFIG_SANDBOX
+	profile.stack_top = (ulong)state_get_current()->stack_top;
+#else
+	profile.stack_top = gd->start_addr_sp;
+#endif
+	profile.count = 0;
+	profile.rate = rate;
+	profile.running = true;
+	ret = profile_timer_start(rate);
+	if (ret)
+		profile.running = false;
+
+	return ret;
+}
+
+void profile_stop(void)
+{
+	if (!profile.running)
+		return;
+	profile_timer_stop();
+	profile.running = false;
+}
+
+void profile_print_stats(void)
+{
+	printf("Profiling %s at %u samples a second\n",
+	       profile.running ? "running" : "stopped", profile.rate);
+	print_grouped_ull(profile.count, 10);
+	puts(" samples taken");
+	if (profile.count > profile.size)
+		printf(" (%lu oldest overwritten)",
+		       profile.count - profile.size);
+	puts("\n");
+}
+
+int profile_list_samples(void *buff, int buff_size, unsigned int *needed)
+{
+	struct trace_output_hdr *output_hdr = NULL;
+	void *end, *ptr = buff;
+	ulong first, rec;
+	int upto;
+
+	end = buff ? buff + buff_size : NULL;
+
+	/* Place some header information */
+	if (ptr + sizeof(struct trace_output_hdr) < end)
+		output_hdr = ptr;
+	ptr += sizeof(struct trace_output_hdr);
+
+	/* Add the samples which are still in the ring, oldest first */
+	first = profile.count > profile.size ? profile.count - profile.size : 0;
+	for (rec = first, upto = 0; rec < profile.count; rec++) {
+		if (ptr + sizeof(struct trace_sample) <= end) {
+			memcpy(ptr, &profile.ring[rec % profile.size],
+			       sizeof(struct trace_sample));
+			upto++;
+		}
+		ptr += sizeof(struct trace_sample);
+	}
+
+	/* Update the header */
+	if (output_hdr) {
+		output_hdr->rec_count = upto;
+		output_hdr->type = TRACE_CHUNK_SAMPLES;
+	}
+
+	/* Work out how much of the buffer we used */
+	*needed = ptr - buff;
+	if (ptr > end)
+		return -1;
+
+	return 0;
+}
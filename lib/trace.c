@@ -9,12 +9,51 @@
 #include <trace.h>
 #include <asm/io.h>
 #include <asm/sections.h>
+#include <linux/bug.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
 static char trace_enabled __attribute__((section(".data")));
 static char trace_inited __attribute__((section(".data")));
 
+/* Call graph size, a power of 2. Each node takes 36 bytes of the buffer */
+#ifndef CONFIG_TRACE_GRAPH_NODES
+#define CONFIG_TRACE_GRAPH_NODES	1024
+#endif
+
+/* With CONFIG_TRACE_GRAPH_ONLY, calls are not logged one by one */
+#ifdef CONFIG_TRACE_GRAPH_ONLY
+#define TRACE_CALL_LOG		0
+#else
+#define TRACE_CALL_LOG		1
+#endif
+
+enum {
+	TRACE_GRAPH_NODES	= CONFIG_TRACE_GRAPH_NODES,
+	TRACE_GRAPH_DEPTH	= 64,	/* Deepest call recorded in the graph */
+};
+
+/*
+ * A node in the call graph, which is one call path: the function called
+ * and the node it was called from. Nodes are found by hashing the parent
+ * and function, and chained through @next.
+ */
+struct trace_node {
+	uint32_t parent;	/* Node of the caller, 0 if none */
+	uint32_t func;		/* Function number, see func_ptr_to_num() */
+	uint32_t call_count;	/* Number of calls along this path */
+	uint32_t next;		/* Next node with the same hash, 0 if none */
+	u64 total_us;		/* Time spent in calls, including callees */
+	u64 self_us;		/* Time spent in calls, excluding callees */
+};
+
+/* A function which has been entered and not yet exited */
+struct trace_frame {
+	uint32_t node;		/* Graph node for this call, 0 if untracked */
+	ulong start_us;		/* Time of entry */
+	ulong child_us;		/* Time spent in callees so far */
+};
+
 /* The header block at the start of the trace memory area */
 struct trace_hdr {
 	int func_count;		/* Total number of function call sites */
@@ -37,6 +76,18 @@ struct trace_hdr {
 	int depth;
 	int depth_limit;
 	int max_depth;
+
+	/*
+	 * Call graph, with time spent along each call path. This has a fixed
+	 * size, so unlike the function trace list it does not overflow during
+	 * a long boot.
+	 */
+	uint32_t *graph_hash;	/* First node for each hash value */
+	struct trace_node *graph;	/* Nodes, indexed from 1 */
+	uint32_t graph_count;	/* Number of nodes used, including node 0 */
+	ulong graph_dropped;	/* Calls not recorded as the graph is full */
+	int graph_depth;	/* Number of entries used in graph_stack */
+	struct trace_frame graph_stack[TRACE_GRAPH_DEPTH];
 };
 
 static struct trace_hdr *hdr;	/* Pointer to start of trace buffer */
@@ -60,6 +111,8 @@ static inline uintptr_t __attribute__((no_instrument_function))
 static void __attribute__((no_instrument_function)) add_ftrace(void *func_ptr,
 				void *caller, ulong flags)
 {
+	if (!TRACE_CALL_LOG)
+		return;
 	if (hdr->depth > hdr->depth_limit) {
 		hdr->ftrace_too_deep_count++;
 		return;
@@ -74,8 +127,89 @@ static void __attribute__((no_instrument_function)) add_ftrace(void *func_ptr,
 	hdr->ftrace_count++;
 }
 
+static uint32_t __attribute__((no_instrument_function)) graph_node(
+		uint32_t parent, uint32_t func)
+{
+	struct trace_node *node;
+	uint32_t hash, num;
+
+	hash = ((parent * 0x9e3779b1) ^ func) & (TRACE_GRAPH_NODES - 1);
+	for (num = hdr->graph_hash[hash]; num; num = node->next) {
+		node = &hdr->graph[num];
+		if (node->parent == parent && node->func == func)
+			return num;
+	}
+	if (hdr->graph_count == TRACE_GRAPH_NODES)
+		return 0;
+
+	num = hdr->graph_count++;
+	node = &hdr->graph[num];
+	node->parent = parent;
+	node->func = func;
+	node->next = hdr->graph_hash[hash];
+	hdr->graph_hash[hash] = num;
+
+	return num;
+}
+
+/* Record entry to a function in the call graph */
+static void __attribute__((no_instrument_function)) graph_enter(void *func_ptr)
+{
+	struct trace_frame *frame;
+	uint32_t parent = 0;
+	uint32_t num = 0;
+
+	if (hdr->graph_depth >= TRACE_GRAPH_DEPTH) {
+		/* Too deep, so we don't know when we return to the graph */
+		hdr->graph_depth++;
+		hdr->graph_dropped++;
+		return;
+	}
+	if (hdr->graph_depth)
+		parent = hdr->graph_stack[hdr->graph_depth - 1].node;
+
+	/* Calls from an untracked call are not tracked either */
+	if (parent || !hdr->graph_depth)
+		num = graph_node(parent, func_ptr_to_num(func_ptr));
+	if (!num)
+		hdr->graph_dropped++;
+	else
+		hdr->graph[num].call_count++;
+
+	frame = &hdr->graph_stack[hdr->graph_depth++];
+	frame->node = num;
+	frame->child_us = 0;
+	frame->start_us = timer_get_us();
+}
+
+/* Record exit from a function, adding its time to the call graph */
+static void __attribute__((no_instrument_function)) graph_exit(void)
+{
+	struct trace_frame *frame;
+	struct trace_node *node;
+	ulong total;
+
+	/* We may have been enabled part-way through a call */
+	if (!hdr->graph_depth)
+		return;
+	if (hdr->graph_depth-- > TRACE_GRAPH_DEPTH)
+		return;
+
+	frame = &hdr->graph_stack[hdr->graph_depth];
+	total = timer_get_us() - frame->start_us;
+	if (frame->node) {
+		node = &hdr->graph[frame->node];
+		node->total_us += total;
+		node->self_us += total - min(total, frame->child_us);
+	}
+	if (hdr->graph_depth)
+		frame[-1].child_us += total;
+}
+
 static void __attribute__((no_instrument_function)) add_textbase(void)
 {
+	if (!TRACE_CALL_LOG)
+		return;
 	if (hdr->ftrace_count < hdr->ftrace_size) {
 		struct trace_call *rec = &hdr->ftrace[hdr->ftrace_count];
 
@@ -102,6 +236,7 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_enter(
 		int func;
 
 		add_ftrace(func_ptr, caller, FUNCF_ENTRY);
+		graph_enter(func_ptr);
 		func = func_ptr_to_num(func_ptr);
 		if (func < hdr->func_count) {
 			hdr->call_accum[func]++;
@@ -110,7 +245,7 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_enter(
 			hdr->untracked_count++;
 		}
 		hdr->depth++;
-		if (hdr->depth > hdr->depth_limit)
+		if (hdr->depth > hdr->max_depth)
 			hdr->max_depth = hdr->depth;
 	}
 }
@@ -118,7 +253,7 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_enter(
 /**
  * This is called on every function exit
  *
- * We do nothing here.
+ * We add the time spent in the function to the call graph.
  *
  * @param func_ptr	Pointer to function being entered
  * @param caller	Pointer to function which called this function
@@ -128,6 +263,7 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_exit(
 {
 	if (trace_enabled) {
 		add_ftrace(func_ptr, caller, FUNCF_EXIT);
+		graph_exit();
 		hdr->depth--;
 	}
 }
@@ -232,6 +368,50 @@ int trace_list_calls(void *buff, int buff_size, unsigned *needed)
 	return 0;
 }
 
+int trace_list_graph(void *buff, int buff_size, unsigned int *needed)
+{
+	struct trace_output_hdr *output_hdr = NULL;
+	void *end, *ptr = buff;
+	uint32_t num;
+	int upto;
+
+	end = buff ? buff + buff_size : NULL;
+
+	/* Place some header information */
+	if (ptr + sizeof(struct trace_output_hdr) < end)
+		output_hdr = ptr;
+	ptr += sizeof(struct trace_output_hdr);
+
+	/* Add each node. Parents come first, since they are created first */
+	for (num = 1, upto = 0; num < hdr->graph_count; num++) {
+		if (ptr + sizeof(struct trace_graph) <= end) {
+			struct trace_node *node = &hdr->graph[num];
+			struct trace_graph *out = ptr;
+
+			out->parent = node->parent;
+			out->func = node->func * FUNC_SITE_SIZE;
+			out->call_count = node->call_count;
+			out->reserved = 0;
+			out->total_us = node->total_us;
+			out->self_us = node->self_us;
+			upto++;
+		}
+		ptr += sizeof(struct trace_graph);
+	}
+
+	/* Update the header */
+	if (output_hdr) {
+		output_hdr->rec_count = upto;
+		output_hdr->type = TRACE_CHUNK_GRAPH;
+	}
+
+	/* Work out how must of the buffer we used */
+	*needed = ptr - buff;
+	if (ptr > end)
+		return -1;
+	return 0;
+}
+
 /* Print basic information about tracing */
 void trace_print_stats(void)
 {
@@ -263,6 +443,36 @@ void trace_print_stats(void)
 	printf("%15d call depth limit\n", hdr->depth_limit);
 	print_grouped_ull(hdr->ftrace_too_deep_count, 10);
 	puts(" calls not traced due to depth\n");
+	print_grouped_ull(hdr->graph_count - 1, 10);
+	printf(" call graph nodes (of %d)\n", TRACE_GRAPH_NODES - 1);
+	print_grouped_ull(hdr->graph_dropped, 10);
+	puts(" calls not in call graph\n");
+}
+
+/**
+ * Lay out the trace buffer: the header, call counts and call graph, which
+ * are followed by the function trace list
+ *
+ * @param h		Trace buffer to set up, or NULL to just get the size
+ * @param func_count	Number of function sites
+ * @return number of bytes used before the function trace list
+ */
+static size_t __attribute__((no_instrument_function)) trace_layout(
+		struct trace_hdr *h, ulong func_count)
+{
+	size_t hash_ofs, graph_ofs;
+
+	BUILD_BUG_ON(TRACE_GRAPH_NODES & (TRACE_GRAPH_NODES - 1));
+	hash_ofs = sizeof(*h) + func_count * sizeof(uintptr_t);
+	graph_ofs = ALIGN(hash_ofs + TRACE_GRAPH_NODES * sizeof(uint32_t),
+			  sizeof(u64));
+	if (h) {
+		h->call_accum = (uintptr_t *)(h + 1);
+		h->graph_hash = (uint32_t *)((char *)h + hash_ofs);
+		h->graph = (struct trace_node *)((char *)h + graph_ofs);
+	}
+
+	return graph_ofs + TRACE_GRAPH_NODES * sizeof(struct trace_node);
 }
 
 void __attribute__((no_instrument_function)) trace_set_enabled(int enabled)
@@ -295,7 +505,8 @@ int __attribute__((no_instrument_function)) trace_init(void *buff,
 		trace_enabled = 0;
 		hdr = map_sysmem(CONFIG_TRACE_EARLY_ADDR,
 				 CONFIG_TRACE_EARLY_SIZE);
-		end = (char *)&hdr->ftrace[hdr->ftrace_count];
+		end = (char *)&hdr->ftrace[min(hdr->ftrace_count,
+					       hdr->ftrace_size)];
 		used = end - (char *)hdr;
 		printf("trace: copying %08lx bytes of early data from %x to %08lx\n",
 		       used, CONFIG_TRACE_EARLY_ADDR,
@@ -307,7 +518,7 @@ int __attribute__((no_instrument_function)) trace_init(void *buff,
 #endif
 	}
 	hdr = (struct trace_hdr *)buff;
-	needed = sizeof(*hdr) + func_count * sizeof(uintptr_t);
+	needed = trace_layout(NULL, func_count);
 	if (needed > buff_size) {
 		printf("trace: buffer size %zd bytes: at least %zd needed\n",
 		       buff_size, needed);
@@ -316,12 +527,15 @@ int __attribute__((no_instrument_function)) trace_init(void *buff,
 
 	if (was_disabled)
 		memset(hdr, '\0', needed);
+	trace_layout(hdr, func_count);
 	hdr->func_count = func_count;
-	hdr->call_accum = (uintptr_t *)(hdr + 1);
+	if (was_disabled)
+		hdr->graph_count = 1;
 
 	/* Use any remaining space for the timed function trace */
 	hdr->ftrace = (struct trace_call *)(buff + needed);
-	hdr->ftrace_size = (buff_size - needed) / sizeof(*hdr->ftrace);
+	if (TRACE_CALL_LOG)
+		hdr->ftrace_size = (buff_size - needed) / sizeof(*hdr->ftrace);
 	add_textbase();
 
 	puts("trace: enabled\n");
@@ -343,7 +557,7 @@ int __attribute__((no_instrument_function)) trace_early_init(void)
 		return 0;
 
 	hdr = map_sysmem(CONFIG_TRACE_EARLY_ADDR, CONFIG_TRACE_EARLY_SIZE);
-	needed = sizeof(*hdr) + func_count * sizeof(uintptr_t);
+	needed = trace_layout(NULL, func_count);
 	if (needed > buff_size) {
 		printf("trace: buffer size is %zd bytes, at least %zd needed\n",
 		       buff_size, needed);
@@ -351,12 +565,14 @@ int __attribute__((no_instrument_function)) trace_early_init(void)
 	}
 
 	memset(hdr, '\0', needed);
-	hdr->call_accum = (uintptr_t *)(hdr + 1);
+	trace_layout(hdr, func_count);
 	hdr->func_count = func_count;
+	hdr->graph_count = 1;
 
 	/* Use any remaining space for the timed function trace */
 	hdr->ftrace = (struct trace_call *)((char *)hdr + needed);
-	hdr->ftrace_size = (buff_size - needed) / sizeof(*hdr->ftrace);
+	if (TRACE_CALL_LOG)
+		hdr->ftrace_size = (buff_size - needed) / sizeof(*hdr->ftrace);
 	add_textbase();
 	hdr->depth_limit = 200;
 	printf("trace: early enable at %08x\n", CONFIG_TRACE_EARLY_ADDR);
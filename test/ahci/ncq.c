@@ -0,0 +1,174 @@
+/*
+ * Tests for the AHCI driver, using an emulated controller
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <ahci.h>
+#include <libata.h>
+#include <malloc.h>
+#include <scsi.h>
+#include <asm/test.h>
+#include <asm/unaligned.h>
+#include <test/ahci.h>
+#include <test/ut.h>
+
+/* A 4MiB disk, with transfers of half of it split into 64KiB commands */
+#define TEST_BLOCKS		8192
+#define TEST_XFER_BLOCKS	4096
+#define TEST_XFER_CMDS		(TEST_XFER_BLOCKS / 128)
+#define TEST_DEPTH		8
+
+/**
+ * struct ahci_test_env - an emulated controller and buffers for a test
+ *
+ * @mmio:	Register base of the controller
+ * @disk:	Disk contents
+ * @buf:	Buffer for transfers
+ */
+struct ahci_test_env {
+	void *mmio;
+	u8 *disk;
+	u8 *buf;
+};
+
+static int ahci_test_setup(struct ahci_test_env *env, uint depth)
+{
+	ulong len = TEST_BLOCKS * ATA_SECT_SIZE;
+	ulong i;
+
+	env->disk = malloc(len);
+	env->buf = malloc(len);
+	env->mmio = env->disk ? sandbox_ahci_add(env->disk, TEST_BLOCKS,
+						 depth) : NULL;
+	if (!env->buf || !env->mmio)
+		return -ENOMEM;
+	for (i = 0; i < len; i++)
+		env->disk[i] = i * 7 + i / 512;
+
+	return ahci_init(env->mmio);
+}
+
+static void ahci_test_teardown(struct ahci_test_env *env)
+{
+	if (env->mmio)
+		sandbox_ahci_remove(env->mmio);
+	free(env->buf);
+	free(env->disk);
+}
+
+static bool ahci_test_exec(u8 op, ulong lba, uint blocks, u8 *buf)
+{
+	ccb pccb;
+
+	memset(&pccb, '\0', sizeof(pccb));
+	pccb.cmd[0] = op;
+	if (op == SCSI_INQUIRY) {
+		pccb.datalen = 96;
+	} else {
+		put_unaligned_be32(lba, &pccb.cmd[2]);
+		put_unaligned_be16(blocks, &pccb.cmd[7]);
+		pccb.datalen = blocks * ATA_SECT_SIZE;
+	}
+	pccb.pdata = buf;
+
+	return scsi_exec(&pccb);
+}
+
+static int ahci_test_rw(struct unit_test_state *uts, struct ahci_test_env *env,
+			uint depth)
+{
+	ulong off = 100 * ATA_SECT_SIZE, len = TEST_XFER_BLOCKS * ATA_SECT_SIZE;
+	struct sandbox_ahci_stats stats;
+	ulong i;
+
+	ut_assertok(ahci_test_setup(env, depth));
+	ut_assert(ahci_test_exec(SCSI_INQUIRY, 0, 0, env->buf));
+	sandbox_ahci_get_stats(env->mmio, &stats);
+
+	/* Read, checking that the queue was kept full */
+	ut_assert(ahci_test_exec(SCSI_READ10, 100, TEST_XFER_BLOCKS,
+				 env->buf));
+	ut_assertok(memcmp(env->buf, env->disk + off, len));
+	sandbox_ahci_get_stats(env->mmio, &stats);
+	ut_asserteq(depth ? TEST_XFER_CMDS : 0, stats.queued);
+	ut_asserteq(depth ? 0 : TEST_XFER_CMDS, stats.unqueued);
+	ut_asserteq(depth, stats.max_active);
+
+	/* Write, which needs one flush with NCQ and one per command without */
+	for (i = 0; i < len; i++)
+		env->buf[i] = ~i;
+	ut_assert(ahci_test_exec(SCSI_WRITE10, 100, TEST_XFER_BLOCKS,
+				 env->buf));
+	ut_assertok(memcmp(env->buf, env->disk + off, len));
+	sandbox_ahci_get_stats(env->mmio, &stats);
+	ut_asserteq(depth ? TEST_XFER_CMDS : 0, stats.queued);
+	ut_asserteq(depth ? 1 : TEST_XFER_CMDS, stats.flushes);
+
+	return 0;
+}
+
+/* Test transfers with NCQ */
+static int ahci_test_ncq(struct unit_test_state *uts)
+{
+	struct ahci_test_env env = { NULL };
+	int ret;
+
+	ret = ahci_test_rw(uts, &env, TEST_DEPTH);
+	ahci_test_teardown(&env);
+
+	return ret;
+}
+AHCI_TEST(ahci_test_ncq, 0);
+
+/* Test transfers with a disk which does not support NCQ */
+static int ahci_test_no_ncq(struct unit_test_state *uts)
+{
+	struct ahci_test_env env = { NULL };
+	int ret;
+
+	ret = ahci_test_rw(uts, &env, 0);
+	ahci_test_teardown(&env);
+
+	return ret;
+}
+AHCI_TEST(ahci_test_no_ncq, 0);
+
+static int ahci_test_error(struct unit_test_state *uts,
+			   struct ahci_test_env *env)
+{
+	ulong off = 100 * ATA_SECT_SIZE, len = TEST_XFER_BLOCKS * ATA_SECT_SIZE;
+	struct sandbox_ahci_stats stats;
+
+	ut_assertok(ahci_test_setup(env, TEST_DEPTH));
+	ut_assert(ahci_test_exec(SCSI_INQUIRY, 0, 0, env->buf));
+
+	/* A failed command fails the transfer */
+	sandbox_ahci_fail_lba(env->mmio, 1000);
+	ut_assert(!ahci_test_exec(SCSI_READ10, 100, TEST_XFER_BLOCKS,
+				  env->buf));
+	sandbox_ahci_get_stats(env->mmio, &stats);
+	ut_asserteq(1, stats.errors);
+
+	/* The port is restarted, so the next transfer works */
+	memset(env->buf, '\0', len);
+	ut_assert(ahci_test_exec(SCSI_READ10, 100, TEST_XFER_BLOCKS,
+				 env->buf));
+	ut_assertok(memcmp(env->buf, env->disk + off, len));
+
+	return 0;
+}
+
+/* Test recovery from a queued command which fails */
+static int ahci_test_ncq_error(struct unit_test_state *uts)
+{
+	struct ahci_test_env env = { NULL };
+	int ret;
+
+	ret = ahci_test_error(uts, &env);
+	ahci_test_teardown(&env);
+
+	return ret;
+}
+AHCI_TEST(ahci_test_ncq_error, 0);
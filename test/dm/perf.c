@@ -0,0 +1,83 @@
+/*
+ * Tests for the performance counter uclass
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <perf.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+/* Test that counting cycles works, and that counts stop with the counter */
+static int dm_test_perf_cycles(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	u64 count, again;
+
+	ut_assertok(uclass_get_device(UCLASS_PERF, 0, &dev));
+	ut_asserteq(1 << PERF_EVENT_CYCLES,
+		    perf_start(dev, 1 << PERF_EVENT_CYCLES));
+	mdelay(1);
+	ut_assertok(perf_stop(dev));
+	ut_assertok(perf_read(dev, PERF_EVENT_CYCLES, &count));
+	ut_assert(count > 0);
+	mdelay(1);
+	ut_assertok(perf_read(dev, PERF_EVENT_CYCLES, &again));
+	ut_asserteq(count, again);
+
+	/* Only the events started can be read */
+	ut_asserteq(-ENOENT, perf_read(dev, PERF_EVENT_BRANCHES, &count));
+
+	return 0;
+}
+DM_TEST(dm_test_perf_cycles, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that perf_start() only counts as many events as there are counters */
+static int dm_test_perf_counters(struct unit_test_state *uts)
+{
+	struct perf_uc_priv *uc_priv;
+	struct udevice *dev;
+	int events;
+
+	ut_assertok(uclass_get_device(UCLASS_PERF, 0, &dev));
+	uc_priv = dev_get_uclass_priv(dev);
+	uc_priv->counters = 1;
+	events = perf_start(dev, (1 << PERF_EVENT_COUNT) - 1);
+	ut_asserteq(1 << PERF_EVENT_CYCLES, events);
+	ut_assertok(perf_stop(dev));
+
+	ut_asserteq_str("cache-misses",
+			perf_get_event_name(PERF_EVENT_CACHE_MISSES));
+
+	return 0;
+}
+DM_TEST(dm_test_perf_counters, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that a cycle counter of its own leaves the others for other events */
+static int dm_test_perf_cycle_counter(struct unit_test_state *uts)
+{
+	struct perf_uc_priv *uc_priv;
+	struct udevice *dev;
+	uint all = (1 << PERF_EVENT_COUNT) - 1;
+	uint cycles = 1 << PERF_EVENT_CYCLES;
+	uint two = 1 << PERF_EVENT_INSTRUCTIONS | 1 << PERF_EVENT_CACHE_REFS;
+
+	ut_assertok(uclass_get_device(UCLASS_PERF, 0, &dev));
+	uc_priv = dev_get_uclass_priv(dev);
+	uc_priv->events = all;
+	uc_priv->counters = 2;
+	uc_priv->cycle_counter = true;
+
+	/* Without cycles, only as many events as there are counters */
+	ut_asserteq(two, perf_start(dev, all & ~cycles));
+	ut_assertok(perf_stop(dev));
+
+	/* Cycles come on top of those */
+	ut_asserteq(cycles | two, perf_start(dev, all));
+	ut_assertok(perf_stop(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_perf_cycle_counter, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -125,3 +125,21 @@ static int dm_test_spi_xfer(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_xfer, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that the memory-mapped window of a controller can be read */
+static int dm_test_spi_get_mmap(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	ulong map_base;
+	uint map_size, offset;
+
+	ut_assertok(uclass_find_first_device(UCLASS_SPI_FLASH, &dev));
+	ut_assert(dev);
+	ut_assertok(dm_spi_get_mmap(dev, &map_base, &map_size, &offset));
+	ut_asserteq(0x1000, map_base);
+	ut_asserteq(0x2000, map_size);
+	ut_asserteq(0x100, offset);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_get_mmap, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
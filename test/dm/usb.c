@@ -58,6 +58,41 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
 
+/*
+ * Test that a large read is split into several commands, each small enough
+ * to complete within the USB timeout. This needs a testflash.bin of more
+ * than 32MiB.
+ */
+static int dm_test_usb_flash_split(struct unit_test_state *uts)
+{
+	struct udevice *dev, *emul;
+	struct blk_desc *dev_desc;
+	lbaint_t blks = (36 << 20) / 512;
+	uint max_len;
+	char *buf;
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
+	ut_assertok(blk_get_device_by_str("usb", "0", &dev_desc));
+	ut_assertok(uclass_find_device_by_name(UCLASS_USB_EMUL, "flash-stick@0",
+					       &emul));
+	ut_assert(dev_desc->lba >= blks);
+	sandbox_usb_flash_get_reads(emul, &max_len);
+
+	/* The host takes any length, the reads stop at 65535 blocks */
+	buf = map_sysmem(0x1000000, blks * 512);
+	ut_asserteq(blks, blk_dread(dev_desc, 0, blks, buf));
+	ut_assertok(strcmp(buf, "this is a test"));
+	unmap_sysmem(buf);
+	ut_asserteq(2, sandbox_usb_flash_get_reads(emul, &max_len));
+	ut_asserteq(65535, max_len);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_flash_split, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
 /* test that we can handle multiple storage devices */
 static int dm_test_usb_multi(struct unit_test_state *uts)
 {
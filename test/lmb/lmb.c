@@ -0,0 +1,183 @@
+/*
+ * Tests for lmb and the region sets behind it
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <lmb.h>
+#include <test/lmb.h>
+#include <test/ut.h>
+
+/* Memory ending at the top of a 32-bit address space */
+#define TEST_RAM_BASE		0x80000000ULL
+#define TEST_RAM_SIZE		0x80000000ULL
+#define TEST_RAM_END		(TEST_RAM_BASE + TEST_RAM_SIZE)
+
+static int lmb_test_check(struct unit_test_state *uts,
+			  struct lmb_property *prop, u64 base, u64 size,
+			  ulong type)
+{
+	ut_assertnonnull(prop);
+	ut_assert(prop->base == base);
+	ut_assert(prop->size == size);
+	ut_asserteq(type, prop->type);
+
+	return 0;
+}
+
+static int lmb_test_alloc_run(struct unit_test_state *uts, struct lmb *lmb)
+{
+	phys_addr_t addr;
+
+	ut_assertok(lmb_add(lmb, TEST_RAM_BASE, TEST_RAM_SIZE));
+	ut_assert(lmb->memory.size == TEST_RAM_SIZE);
+	ut_assertok(lmb_test_check(uts, lmb_region_first(&lmb->memory),
+				   TEST_RAM_BASE, TEST_RAM_SIZE, 0));
+
+	/* Allocations come from the top, even when it is at 4GiB */
+	addr = lmb_alloc(lmb, 0x1000, 0x1000);
+	ut_assert(addr == TEST_RAM_END - 0x1000);
+	ut_assert(lmb_is_reserved(lmb, TEST_RAM_END - 1));
+
+	/* Adjacent ranges merge, and the next allocation skips the run */
+	ut_assertok(lmb_reserve(lmb, TEST_RAM_END - 0x100000, 0xff000));
+	ut_asserteq(1, lmb->reserved.cnt);
+	addr = lmb_alloc(lmb, 0x2000, 0x1000);
+	ut_assert(addr == TEST_RAM_END - 0x102000);
+	ut_asserteq(1, lmb->reserved.cnt);
+
+	/* max_addr is respected */
+	addr = lmb_alloc_base(lmb, 0x1000, 0x1000, TEST_RAM_BASE + 0x10000);
+	ut_assert(addr == TEST_RAM_BASE + 0xf000);
+
+	/* Freeing the top allocation makes it available again */
+	ut_assertok(lmb_free(lmb, TEST_RAM_END - 0x1000, 0x1000));
+	ut_assert(!lmb_is_reserved(lmb, TEST_RAM_END - 1));
+	ut_assert(lmb_free(lmb, TEST_RAM_END - 0x1000, 0x1000) < 0);
+	addr = lmb_alloc(lmb, 0x1000, 0x1000);
+	ut_assert(addr == TEST_RAM_END - 0x1000);
+
+	/* Nothing fits which is larger than the memory */
+	ut_assert(!__lmb_alloc_base(lmb, TEST_RAM_SIZE + 0x1000, 0x1000, 0));
+
+	return 0;
+}
+
+/* Test allocation from memory which ends at 4GiB */
+static int lmb_test_alloc(struct unit_test_state *uts)
+{
+	struct lmb test_lmb;
+	int ret;
+
+	memset(&test_lmb, '\0', sizeof(test_lmb));
+	lmb_init(&test_lmb);
+	ret = lmb_test_alloc_run(uts, &test_lmb);
+	lmb_init(&test_lmb);
+
+	return ret;
+}
+LMB_TEST(lmb_test_alloc, 0);
+
+static int lmb_test_many_run(struct unit_test_state *uts, struct lmb *lmb)
+{
+	phys_addr_t base;
+	int i;
+
+	ut_assertok(lmb_add(lmb, TEST_RAM_BASE, TEST_RAM_SIZE));
+
+	/* There is no fixed limit on the number of regions */
+	for (i = 0; i < 100; i++) {
+		base = TEST_RAM_BASE + i * 0x20000;
+		ut_assertok(lmb_reserve(lmb, base, 0x10000));
+	}
+	ut_asserteq(100, lmb->reserved.cnt);
+	ut_assert(lmb->reserved.size == 100 * 0x10000);
+
+	/* Filling the holes merges everything into one region */
+	for (i = 0; i < 100; i++) {
+		base = TEST_RAM_BASE + i * 0x20000 + 0x10000;
+		ut_assertok(lmb_reserve(lmb, base, 0x10000));
+	}
+	ut_asserteq(1, lmb->reserved.cnt);
+	ut_assertok(lmb_test_check(uts, lmb_region_first(&lmb->reserved),
+				   TEST_RAM_BASE, 200 * 0x10000, 0));
+
+	/* Freeing a part in the middle splits it again */
+	ut_assertok(lmb_free(lmb, TEST_RAM_BASE + 0x10000, 0x10000));
+	ut_asserteq(2, lmb->reserved.cnt);
+
+	return 0;
+}
+
+/* Test more reservations than the old fixed arrays held */
+static int lmb_test_many(struct unit_test_state *uts)
+{
+	struct lmb test_lmb;
+	int ret;
+
+	memset(&test_lmb, '\0', sizeof(test_lmb));
+	lmb_init(&test_lmb);
+	ret = lmb_test_many_run(uts, &test_lmb);
+	lmb_init(&test_lmb);
+
+	return ret;
+}
+LMB_TEST(lmb_test_many, 0);
+
+static int lmb_test_typed_run(struct unit_test_state *uts,
+			      struct lmb_region *rgn)
+{
+	struct lmb_property *prop;
+
+	/* Memory up to 4GiB, then more above it as the EFI map may hold */
+	ut_assertok(lmb_region_set(rgn, TEST_RAM_BASE, TEST_RAM_SIZE, 1));
+	ut_assertok(lmb_region_set(rgn, TEST_RAM_END, 0x10000000, 1));
+	ut_asserteq(1, rgn->cnt);
+	ut_assert(lmb_region_covered(rgn, TEST_RAM_END - 0x1000, 0x2000, 1));
+
+	/* Setting another type in the middle splits the region */
+	ut_assertok(lmb_region_set(rgn, TEST_RAM_END - 0x1000, 0x1000, 2));
+	ut_asserteq(3, rgn->cnt);
+	prop = lmb_region_first(rgn);
+	ut_assertok(lmb_test_check(uts, prop, TEST_RAM_BASE,
+				   TEST_RAM_SIZE - 0x1000, 1));
+	prop = lmb_region_next(prop);
+	ut_assertok(lmb_test_check(uts, prop, TEST_RAM_END - 0x1000, 0x1000,
+				   2));
+	prop = lmb_region_next(prop);
+	ut_assertok(lmb_test_check(uts, prop, TEST_RAM_END, 0x10000000, 1));
+	ut_assert(!lmb_region_covered(rgn, TEST_RAM_END - 0x2000, 0x2000, 1));
+	ut_assert(lmb_region_find(rgn, TEST_RAM_END - 0x1800, 0x1000) ==
+		  lmb_region_first(rgn));
+
+	/* Setting it back merges the three again */
+	ut_assertok(lmb_region_set(rgn, TEST_RAM_END - 0x1000, 0x1000, 1));
+	ut_asserteq(1, rgn->cnt);
+
+	/* A range up to 4GiB is trimmed off the end of the lower memory */
+	ut_assertok(lmb_region_set(rgn, TEST_RAM_END, 0x10000000, 2));
+	ut_assertok(lmb_region_clear(rgn, TEST_RAM_END - 0x100000, 0x100000));
+	ut_asserteq(2, rgn->cnt);
+	ut_assertok(lmb_test_check(uts, lmb_region_first(rgn), TEST_RAM_BASE,
+				   TEST_RAM_SIZE - 0x100000, 1));
+	ut_assert(lmb_region_below(rgn, TEST_RAM_END) ==
+		  lmb_region_first(rgn));
+	ut_assert(rgn->size == TEST_RAM_SIZE - 0x100000 + 0x10000000);
+
+	return 0;
+}
+
+/* Test a set of typed regions which goes beyond 4GiB, like the EFI map */
+static int lmb_test_typed(struct unit_test_state *uts)
+{
+	struct lmb_region rgn;
+	int ret;
+
+	memset(&rgn, '\0', sizeof(rgn));
+	ret = lmb_test_typed_run(uts, &rgn);
+	lmb_region_init(&rgn);
+
+	return ret;
+}
+LMB_TEST(lmb_test_typed, 0);
@@ -0,0 +1,258 @@
+/*
+ * Tests for the simple malloc() used before relocation
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <test/malloc.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Size of the test pool, and of the header before each block */
+#define TEST_POOL_SIZE		0x400
+#define HDR			sizeof(ulong)
+
+typedef int (*simple_test_func)(struct unit_test_state *uts, u8 *pool);
+
+/* Run a test on its own pool, leaving the early malloc() pool untouched */
+static int malloc_simple_run(struct unit_test_state *uts,
+			     simple_test_func func)
+{
+	ulong base = gd->malloc_base, limit = gd->malloc_limit;
+	ulong ptr = gd->malloc_ptr, peak = gd->malloc_peak;
+	ulong freed = gd->malloc_freed;
+	void *buf;
+	u8 *pool;
+	int ret;
+
+	/* Alignment is by address, which need not match the pointer's */
+	buf = malloc(TEST_POOL_SIZE + 64);
+	ut_assertnonnull(buf);
+	gd->malloc_base = ALIGN(map_to_sysmem(buf), 64);
+	pool = map_sysmem(gd->malloc_base, TEST_POOL_SIZE);
+	gd->malloc_limit = TEST_POOL_SIZE;
+	gd->malloc_ptr = 0;
+	gd->malloc_peak = 0;
+	gd->malloc_freed = 0;
+
+	ret = func(uts, pool);
+
+	gd->malloc_base = base;
+	gd->malloc_limit = limit;
+	gd->malloc_ptr = ptr;
+	gd->malloc_peak = peak;
+	gd->malloc_freed = freed;
+	free(buf);
+
+	return ret;
+}
+
+static int malloc_simple_top_run(struct unit_test_state *uts, u8 *pool)
+{
+	void *ptr, *other;
+
+	ptr = malloc_simple(16);
+	ut_asserteq_ptr(pool + HDR, ptr);
+	ut_asserteq(HDR + 16, gd->malloc_ptr);
+	other = malloc_simple(16);
+	ut_asserteq_ptr(pool + 2 * HDR + 16, other);
+	ut_asserteq(2 * (HDR + 16), gd->malloc_ptr);
+
+	/* Freeing the top block rewinds the pool at once */
+	free_simple(other);
+	ut_asserteq(HDR + 16, gd->malloc_ptr);
+	ut_asserteq(0, gd->malloc_freed);
+	free_simple(ptr);
+	ut_asserteq(0, gd->malloc_ptr);
+	ut_asserteq(2 * (HDR + 16), gd->malloc_peak);
+
+	/* Free blocks below the top go too when the top is freed */
+	ptr = malloc_simple(16);
+	other = malloc_simple(16);
+	free_simple(ptr);
+	ut_asserteq(HDR + 16, gd->malloc_freed);
+	ut_asserteq(2 * (HDR + 16), gd->malloc_ptr);
+	free_simple(other);
+	ut_asserteq(0, gd->malloc_ptr);
+	ut_asserteq(0, gd->malloc_freed);
+
+	/* Freeing twice, or something not in use, is ignored */
+	free_simple(other);
+	ut_asserteq(0, gd->malloc_ptr);
+
+	return 0;
+}
+
+/* Freeing the top block gives its space back to the pool */
+static int malloc_test_simple_top(struct unit_test_state *uts)
+{
+	return malloc_simple_run(uts, malloc_simple_top_run);
+}
+MALLOC_TEST(malloc_test_simple_top, 0);
+
+static int malloc_simple_reuse_run(struct unit_test_state *uts, u8 *pool)
+{
+	void *ptr, *other, *top;
+	ulong used;
+
+	ptr = malloc_simple(40);
+	top = malloc_simple(8);
+	used = gd->malloc_ptr;
+	free_simple(ptr);
+	ut_asserteq(HDR + 40, gd->malloc_freed);
+
+	/* A smaller request takes the start of the hole and splits it */
+	other = malloc_simple(16);
+	ut_asserteq_ptr(ptr, other);
+	ut_asserteq(40 - 16, gd->malloc_freed);
+
+	/* The rest of the hole is used for the next request which fits */
+	other = malloc_simple(16);
+	ut_asserteq_ptr(pool + 2 * HDR + 16, other);
+	ut_asserteq(0, gd->malloc_freed);
+	ut_asserteq(used, gd->malloc_ptr);
+
+	/* Anything larger comes from the top */
+	other = malloc_simple(40);
+	ut_asserteq_ptr(pool + used + HDR, other);
+	free_simple(other);
+	free_simple(top);
+	ut_asserteq(2 * (HDR + 16), gd->malloc_ptr);
+
+	return 0;
+}
+
+/* A free block is split to serve a smaller request */
+static int malloc_test_simple_reuse(struct unit_test_state *uts)
+{
+	return malloc_simple_run(uts, malloc_simple_reuse_run);
+}
+MALLOC_TEST(malloc_test_simple_reuse, 0);
+
+static int malloc_simple_merge_run(struct unit_test_state *uts, u8 *pool)
+{
+	void *ptr[3], *top, *other;
+	ulong used;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ptr); i++)
+		ptr[i] = malloc_simple(16);
+	top = malloc_simple(8);
+	used = gd->malloc_ptr;
+
+	/* Two neighbouring free blocks together serve a larger request */
+	free_simple(ptr[0]);
+	free_simple(ptr[1]);
+	ut_asserteq(2 * (HDR + 16), gd->malloc_freed);
+	other = malloc_simple(HDR + 32);
+	ut_asserteq_ptr(ptr[0], other);
+	ut_asserteq(0, gd->malloc_freed);
+	ut_asserteq(used, gd->malloc_ptr);
+
+	/* Freeing the top block then takes everything free below it too */
+	free_simple(other);
+	free_simple(ptr[2]);
+	ut_asserteq(3 * (HDR + 16), gd->malloc_freed);
+	free_simple(top);
+	ut_asserteq(0, gd->malloc_ptr);
+	ut_asserteq(0, gd->malloc_freed);
+
+	return 0;
+}
+
+/* Neighbouring free blocks are merged */
+static int malloc_test_simple_merge(struct unit_test_state *uts)
+{
+	return malloc_simple_run(uts, malloc_simple_merge_run);
+}
+MALLOC_TEST(malloc_test_simple_merge, 0);
+
+static int malloc_simple_align_run(struct unit_test_state *uts, u8 *pool)
+{
+	void *ptr, *aligned, *other;
+
+	ptr = malloc_simple(8);
+	ut_asserteq(HDR + 8, gd->malloc_ptr);
+
+	/* The space skipped to align the block becomes a free block */
+	aligned = memalign_simple(64, 8);
+	ut_asserteq_ptr(pool + 64, aligned);
+	ut_asserteq(64 - HDR - (HDR + 8), gd->malloc_freed);
+	ut_asserteq(64 + 8, gd->malloc_ptr);
+
+	/* ...which later requests can use */
+	other = malloc_simple(24);
+	ut_asserteq_ptr(pool + HDR + 8 + HDR, other);
+	ut_asserteq(64 - HDR - (HDR + 8) - (HDR + 24), gd->malloc_freed);
+
+	/* Freeing the aligned block drops the rest of the gap with it */
+	free_simple(aligned);
+	ut_asserteq((HDR + 8) + (HDR + 24), gd->malloc_ptr);
+	ut_asserteq(0, gd->malloc_freed);
+	free_simple(other);
+	free_simple(ptr);
+	ut_asserteq(0, gd->malloc_ptr);
+
+	return 0;
+}
+
+/* Alignment leaves a gap which is not lost */
+static int malloc_test_simple_align(struct unit_test_state *uts)
+{
+	return malloc_simple_run(uts, malloc_simple_align_run);
+}
+MALLOC_TEST(malloc_test_simple_align, 0);
+
+static int malloc_simple_mark_run(struct unit_test_state *uts, u8 *pool)
+{
+	void *ptr, *other, *below;
+	ulong mark;
+
+	ptr = malloc_simple(16);
+	mark = malloc_simple_mark();
+	ut_asserteq(HDR + 16, mark);
+	malloc_simple(16);
+	malloc_simple(40);
+	malloc_simple_release(mark);
+	ut_asserteq(mark, gd->malloc_ptr);
+	ut_asserteq(0, gd->malloc_freed);
+
+	/* Releasing to a mark above the top does nothing */
+	malloc_simple_release(mark + 0x100);
+	ut_asserteq(mark, gd->malloc_ptr);
+
+	/* Free blocks just above the mark go too */
+	other = malloc_simple(16);
+	malloc_simple(16);
+	free_simple(other);
+	malloc_simple_release(mark);
+	ut_asserteq(mark, gd->malloc_ptr);
+	ut_asserteq(0, gd->malloc_freed);
+
+	/* A block reused from below the mark stays allocated */
+	other = malloc_simple(16);
+	free_simple(ptr);
+	mark = malloc_simple_mark();
+	below = malloc_simple(16);
+	ut_asserteq_ptr(ptr, below);
+	malloc_simple(16);
+	malloc_simple_release(mark);
+	ut_asserteq(mark, gd->malloc_ptr);
+	ut_asserteq(0, gd->malloc_freed);
+	free_simple(below);
+	free_simple(other);
+	ut_asserteq(0, gd->malloc_ptr);
+
+	return 0;
+}
+
+/* Releasing to a mark frees everything allocated above it */
+static int malloc_test_simple_mark(struct unit_test_state *uts)
+{
+	return malloc_simple_run(uts, malloc_simple_mark_run);
+}
+MALLOC_TEST(malloc_test_simple_mark, 0);
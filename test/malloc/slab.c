@@ -0,0 +1,132 @@
+/*
+ * Tests for the size-class slab allocator behind malloc()
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <test/malloc.h>
+#include <test/ut.h>
+
+/* Small requests come from the slabs, rounded up to their size class */
+static int malloc_test_slab_alloc(struct unit_test_state *uts)
+{
+	ulong inuse = malloc_slab_inuse();
+	void *ptr;
+
+	ptr = malloc(20);
+	ut_assertnonnull(ptr);
+	ut_assert(malloc_slab_owns(ptr));
+	ut_asserteq(32, malloc_usable_size(ptr));
+	ut_asserteq(inuse + 32, malloc_slab_inuse());
+	free(ptr);
+	ut_asserteq(inuse, malloc_slab_inuse());
+
+	ptr = malloc(MALLOC_SLAB_MAX);
+	ut_assert(malloc_slab_owns(ptr));
+	ut_asserteq(MALLOC_SLAB_MAX, malloc_usable_size(ptr));
+	free(ptr);
+
+	/* Anything larger is left to dlmalloc */
+	ptr = malloc(MALLOC_SLAB_MAX + 1);
+	ut_assertnonnull(ptr);
+	ut_assert(!malloc_slab_owns(ptr));
+	free(ptr);
+	ut_asserteq(inuse, malloc_slab_inuse());
+
+	return 0;
+}
+MALLOC_TEST(malloc_test_slab_alloc, 0);
+
+/* A freed object is the next one handed out in its class */
+static int malloc_test_slab_reuse(struct unit_test_state *uts)
+{
+	void *ptr, *other;
+
+	ptr = malloc(100);
+	ut_assert(malloc_slab_owns(ptr));
+	free(ptr);
+	other = malloc(120);
+	ut_asserteq_ptr(ptr, other);
+	free(other);
+
+	/* calloc() clears the object even though it was used before */
+	ptr = malloc(100);
+	memset(ptr, 0xa5, 100);
+	free(ptr);
+	other = calloc(1, 100);
+	ut_asserteq_ptr(ptr, other);
+	ut_asserteq(0, ((u8 *)other)[0]);
+	ut_asserteq(0, ((u8 *)other)[99]);
+	free(other);
+
+	return 0;
+}
+MALLOC_TEST(malloc_test_slab_reuse, 0);
+
+/* realloc() moves objects to and from dlmalloc, keeping the contents */
+static int malloc_test_slab_realloc(struct unit_test_state *uts)
+{
+	ulong inuse = malloc_slab_inuse();
+	u8 *ptr, *grown;
+	int i;
+
+	ptr = malloc(40);
+	ut_assert(malloc_slab_owns(ptr));
+	for (i = 0; i < 40; i++)
+		ptr[i] = i;
+
+	/* Growing within the size class keeps the object where it is */
+	ut_asserteq_ptr(ptr, realloc(ptr, 48));
+
+	grown = realloc(ptr, 2 * MALLOC_SLAB_MAX);
+	ut_assertnonnull(grown);
+	ut_assert(!malloc_slab_owns(grown));
+	ut_asserteq(inuse, malloc_slab_inuse());
+	for (i = 0; i < 40; i++)
+		ut_asserteq(i, grown[i]);
+	free(grown);
+
+	return 0;
+}
+MALLOC_TEST(malloc_test_slab_realloc, 0);
+
+static int malloc_test_fill(struct unit_test_state *uts, void **ptr, int max,
+			    int *countp)
+{
+	int count;
+
+	for (count = 0; count < max; count++) {
+		ptr[count] = malloc(MALLOC_SLAB_MAX);
+		*countp = count + 1;
+		ut_assertnonnull(ptr[count]);
+		if (!malloc_slab_owns(ptr[count]))
+			break;
+	}
+
+	/* Once every page is in use, dlmalloc takes over */
+	ut_assert(count < max);
+
+	return 0;
+}
+
+/* Small requests still succeed when the slabs are full */
+static int malloc_test_slab_full(struct unit_test_state *uts)
+{
+	ulong inuse = malloc_slab_inuse();
+	int max = malloc_slab_size() / MALLOC_SLAB_MAX + 1;
+	int count = 0, ret;
+	void **ptr;
+
+	ptr = calloc(max, sizeof(*ptr));
+	ut_assertnonnull(ptr);
+	ret = malloc_test_fill(uts, ptr, max, &count);
+	while (count)
+		free(ptr[--count]);
+	free(ptr);
+	ut_asserteq(inuse, malloc_slab_inuse());
+
+	return ret;
+}
+MALLOC_TEST(malloc_test_slab_full, 0);
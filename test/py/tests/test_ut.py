@@ -9,12 +9,13 @@ import pytest
 def test_ut_dm_init(u_boot_console):
     """Initialize data for ut dm tests."""
 
+    # Large enough for a USB read that takes several commands
     fn = u_boot_console.config.source_dir + '/testflash.bin'
-    if not os.path.exists(fn):
-        data = 'this is a test'
-        data += '\x00' * ((4 * 1024 * 1024) - len(data))
+    size = 40 * 1024 * 1024
+    if not os.path.exists(fn) or os.path.getsize(fn) < size:
         with open(fn, 'wb') as fh:
-            fh.write(data)
+            fh.write('this is a test')
+            fh.truncate(size)
 
     fn = u_boot_console.config.source_dir + '/spi.bin'
     if not os.path.exists(fn):
@@ -0,0 +1,312 @@
+/*
+ * Tests for the SPL UBI loader, using a UBI image held in RAM
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <ubispl.h>
+#include <linux/crc32.h>
+#include <linux/sizes.h>
+#include <test/ubispl.h>
+#include <test/ut.h>
+
+#include "../../drivers/mtd/ubispl/ubispl.h"
+
+/*
+ * The emulated flash: 64 PEBs of 16KiB with 512 byte pages, VID header
+ * in the second page and data starting at the fifth page.
+ */
+#define TEST_PEB_SIZE		SZ_16K
+#define TEST_PEBS		64
+#define TEST_VID_OFFSET		512
+#define TEST_LEB_START		2048
+#define TEST_LEB_SIZE		(TEST_PEB_SIZE - TEST_LEB_START)
+
+/*
+ * The static volume 0 has TEST_LEBS blocks, placed at the end of the
+ * device, far away from the fastmap anchor. The last LEB is only
+ * listed in the fastmap pool, the others in the EBA table. When the
+ * image is stale, the data of TEST_STALE_PEB is corrupted and a newer
+ * copy of its LEB, which the fastmap does not know about, lives in
+ * TEST_NEW_PEB. When the last LEB is unlisted, the pool is empty, so
+ * the fastmap describes a volume which is one LEB short.
+ */
+#define TEST_VOL_ID		0
+#define TEST_LEBS		4
+#define TEST_FIRST_PEB		40
+#define TEST_LAST_SIZE		1000
+#define TEST_VOL_SIZE		((TEST_LEBS - 1) * TEST_LEB_SIZE + \
+				 TEST_LAST_SIZE)
+#define TEST_ANCHOR		2
+#define TEST_STALE_PEB		(TEST_FIRST_PEB + 1)
+#define TEST_NEW_PEB		50
+
+enum ubispl_test_image {
+	TEST_IMAGE_GOOD,
+	TEST_IMAGE_STALE,
+	TEST_IMAGE_UNLISTED,
+};
+
+/**
+ * struct ubispl_test_flash - emulated flash and its read statistics
+ * @image:	The flash contents
+ * @hdr_reads:	Number of VID header reads
+ * @data_reads:	Number of other reads
+ * @bytes:	Number of bytes read in total
+ */
+struct ubispl_test_flash {
+	u8 *image;
+	int hdr_reads;
+	int data_reads;
+	ulong bytes;
+};
+
+/* The read callback has no context pointer */
+static struct ubispl_test_flash test_flash;
+
+static int ubispl_test_read(int pnum, int offset, int len, void *dst)
+{
+	if (pnum < 0 || pnum >= TEST_PEBS || offset + len > TEST_PEB_SIZE)
+		return -EINVAL;
+
+	if (offset == TEST_VID_OFFSET)
+		test_flash.hdr_reads++;
+	else
+		test_flash.data_reads++;
+	test_flash.bytes += len;
+	memcpy(dst, test_flash.image + pnum * TEST_PEB_SIZE + offset, len);
+
+	return 0;
+}
+
+static u8 *peb_data(u8 *image, int pnum)
+{
+	return image + pnum * TEST_PEB_SIZE + TEST_LEB_START;
+}
+
+static void write_vid_hdr(u8 *image, int pnum, u32 vol_id, u8 vol_type,
+			  u32 lnum, u32 data_size, u64 sqnum)
+{
+	struct ubi_vid_hdr *vh;
+
+	vh = (struct ubi_vid_hdr *)(image + pnum * TEST_PEB_SIZE +
+				    TEST_VID_OFFSET);
+	memset(vh, 0, sizeof(*vh));
+	vh->magic = cpu_to_be32(UBI_VID_HDR_MAGIC);
+	vh->version = UBI_VERSION;
+	vh->vol_type = vol_type;
+	vh->vol_id = cpu_to_be32(vol_id);
+	vh->lnum = cpu_to_be32(lnum);
+	vh->sqnum = cpu_to_be64(sqnum);
+	if (vol_type == UBI_VID_STATIC) {
+		vh->data_size = cpu_to_be32(data_size);
+		vh->used_ebs = cpu_to_be32(TEST_LEBS);
+		vh->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT,
+						 peb_data(image, pnum),
+						 data_size));
+	}
+	vh->hdr_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, vh,
+					UBI_VID_HDR_SIZE_CRC));
+}
+
+static void write_leb(u8 *image, u8 *vol, int pnum, u32 lnum, u64 sqnum)
+{
+	u32 size = lnum == TEST_LEBS - 1 ? TEST_LAST_SIZE : TEST_LEB_SIZE;
+
+	memcpy(peb_data(image, pnum), vol + lnum * TEST_LEB_SIZE, size);
+	write_vid_hdr(image, pnum, TEST_VOL_ID, UBI_VID_STATIC, lnum, size,
+		      sqnum);
+}
+
+static void write_fastmap(u8 *image, bool unlisted)
+{
+	u8 *buf = peb_data(image, TEST_ANCHOR);
+	struct ubi_fm_sb *fmsb;
+	struct ubi_fm_hdr *fmhdr;
+	struct ubi_fm_scan_pool *fmpl;
+	struct ubi_fm_ec *fmec;
+	struct ubi_fm_volhdr *fmvhdr;
+	struct ubi_fm_eba *fm_eba;
+	size_t pos = 0;
+	int i;
+
+	memset(buf, 0, TEST_LEB_SIZE);
+
+	fmsb = (struct ubi_fm_sb *)buf;
+	fmsb->magic = cpu_to_be32(UBI_FM_SB_MAGIC);
+	fmsb->version = UBI_FM_FMT_VERSION;
+	fmsb->used_blocks = cpu_to_be32(1);
+	fmsb->block_loc[0] = cpu_to_be32(TEST_ANCHOR);
+	pos += sizeof(*fmsb);
+
+	fmhdr = (struct ubi_fm_hdr *)(buf + pos);
+	fmhdr->magic = cpu_to_be32(UBI_FM_HDR_MAGIC);
+	fmhdr->used_peb_count = cpu_to_be32(TEST_LEBS - 1);
+	fmhdr->vol_count = cpu_to_be32(1);
+	pos += sizeof(*fmhdr);
+
+	/* The last LEB was written after the fastmap, into the pool */
+	fmpl = (struct ubi_fm_scan_pool *)(buf + pos);
+	fmpl->magic = cpu_to_be32(UBI_FM_POOL_MAGIC);
+	fmpl->max_size = cpu_to_be16(UBI_FM_MIN_POOL_SIZE);
+	if (!unlisted) {
+		fmpl->size = cpu_to_be16(1);
+		fmpl->pebs[0] = cpu_to_be32(TEST_FIRST_PEB + TEST_LEBS - 1);
+	}
+	pos += sizeof(*fmpl);
+
+	fmpl = (struct ubi_fm_scan_pool *)(buf + pos);
+	fmpl->magic = cpu_to_be32(UBI_FM_POOL_MAGIC);
+	fmpl->max_size = cpu_to_be16(UBI_FM_MIN_POOL_SIZE);
+	pos += sizeof(*fmpl);
+
+	for (i = 0; i < TEST_LEBS - 1; i++) {
+		fmec = (struct ubi_fm_ec *)(buf + pos);
+		fmec->pnum = cpu_to_be32(TEST_FIRST_PEB + i);
+		pos += sizeof(*fmec);
+	}
+
+	fmvhdr = (struct ubi_fm_volhdr *)(buf + pos);
+	fmvhdr->magic = cpu_to_be32(UBI_FM_VHDR_MAGIC);
+	fmvhdr->vol_id = cpu_to_be32(TEST_VOL_ID);
+	fmvhdr->vol_type = UBI_STATIC_VOLUME;
+	fmvhdr->used_ebs = cpu_to_be32(TEST_LEBS);
+	fmvhdr->last_eb_bytes = cpu_to_be32(TEST_LAST_SIZE);
+	pos += sizeof(*fmvhdr);
+
+	fm_eba = (struct ubi_fm_eba *)(buf + pos);
+	fm_eba->magic = cpu_to_be32(UBI_FM_EBA_MAGIC);
+	fm_eba->reserved_pebs = cpu_to_be32(TEST_LEBS);
+	for (i = 0; i < TEST_LEBS; i++)
+		fm_eba->pnum[i] = cpu_to_be32(TEST_FIRST_PEB + i);
+
+	fmsb->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, buf,
+					   TEST_LEB_SIZE));
+
+	write_vid_hdr(image, TEST_ANCHOR, UBI_FM_SB_VOLUME_ID,
+		      UBI_VID_DYNAMIC, 0, 0, 100);
+}
+
+static void build_image(u8 *image, u8 *vol, enum ubispl_test_image type)
+{
+	int i;
+
+	memset(image, 0xff, TEST_PEBS * TEST_PEB_SIZE);
+	for (i = 0; i < TEST_VOL_SIZE; i++)
+		vol[i] = i * 7 + i / TEST_LEB_SIZE;
+
+	for (i = 0; i < TEST_LEBS; i++)
+		write_leb(image, vol, TEST_FIRST_PEB + i, i, 10 + i);
+	write_fastmap(image, type == TEST_IMAGE_UNLISTED);
+
+	if (type == TEST_IMAGE_STALE) {
+		peb_data(image, TEST_STALE_PEB)[0] ^= 0xff;
+		write_leb(image, vol, TEST_NEW_PEB, TEST_STALE_PEB -
+			  TEST_FIRST_PEB, 200);
+	}
+}
+
+static int ubispl_test_run(struct unit_test_state *uts,
+			   struct ubispl_info *info, bool fastmap,
+			   enum ubispl_test_image type, u8 *vol, u8 *buf)
+{
+	struct ubispl_load lv;
+	ulong start;
+
+	build_image(test_flash.image, vol, type);
+	test_flash.hdr_reads = 0;
+	test_flash.data_reads = 0;
+	test_flash.bytes = 0;
+
+	info->peb_size = TEST_PEB_SIZE;
+	info->vid_offset = TEST_VID_OFFSET;
+	info->leb_start = TEST_LEB_START;
+	info->peb_count = TEST_PEBS;
+	info->peb_offset = 0;
+	info->fastmap = fastmap;
+	info->read = ubispl_test_read;
+	lv.vol_id = TEST_VOL_ID;
+	lv.load_addr = buf;
+
+	start = timer_get_us();
+	ut_assertok(ubispl_load_volumes(info, &lv, 1));
+	printf("%s: %d header reads, %d data reads, %lu bytes, %lu us\n",
+	       fastmap ? "fastmap" : "scan", test_flash.hdr_reads,
+	       test_flash.data_reads, test_flash.bytes,
+	       timer_get_us() - start);
+	ut_assertok(memcmp(vol, buf, TEST_VOL_SIZE));
+
+	return 0;
+}
+
+static int ubispl_test_load(struct unit_test_state *uts, bool fastmap,
+			    enum ubispl_test_image type)
+{
+	struct ubispl_info info;
+	u8 *vol, *buf;
+	int ret = -ENOMEM;
+
+	test_flash.image = malloc(TEST_PEBS * TEST_PEB_SIZE);
+	vol = malloc(TEST_VOL_SIZE);
+	buf = malloc(TEST_VOL_SIZE);
+	info.ubi = malloc(sizeof(struct ubi_scan_info));
+	if (test_flash.image && vol && buf && info.ubi)
+		ret = ubispl_test_run(uts, &info, fastmap, type, vol, buf);
+
+	free(info.ubi);
+	free(buf);
+	free(vol);
+	free(test_flash.image);
+
+	return ret;
+}
+
+/* Test that a full scan reads every VID header once */
+static int ubispl_test_scan(struct unit_test_state *uts)
+{
+	ut_assertok(ubispl_test_load(uts, false, TEST_IMAGE_GOOD));
+	ut_asserteq(TEST_PEBS, test_flash.hdr_reads);
+
+	return 0;
+}
+UBISPL_TEST(ubispl_test_scan, 0);
+
+/* Test that fastmap only reads the anchor and the volume VID headers */
+static int ubispl_test_fastmap(struct unit_test_state *uts)
+{
+	ut_assertok(ubispl_test_load(uts, true, TEST_IMAGE_GOOD));
+	ut_asserteq(TEST_ANCHOR + 1 + TEST_LEBS, test_flash.hdr_reads);
+
+	return 0;
+}
+UBISPL_TEST(ubispl_test_fastmap, 0);
+
+/*
+ * Test that a stale fastmap falls back to a full scan, which does not
+ * read the VID headers which the fastmap attach has read already
+ */
+static int ubispl_test_fastmap_stale(struct unit_test_state *uts)
+{
+	ut_assertok(ubispl_test_load(uts, true, TEST_IMAGE_STALE));
+	ut_asserteq(TEST_PEBS, test_flash.hdr_reads);
+
+	return 0;
+}
+UBISPL_TEST(ubispl_test_fastmap_stale, 0);
+
+/*
+ * Test that blocks which only looked corrupt against the fastmap are
+ * used by the full scan. Every LEB the fastmap knows about disagrees with
+ * it on the number of LEBs, and the loader reads all the other VID
+ * headers while looking for a replacement.
+ */
+static int ubispl_test_fastmap_unlisted(struct unit_test_state *uts)
+{
+	ut_assertok(ubispl_test_load(uts, true, TEST_IMAGE_UNLISTED));
+	ut_asserteq(TEST_PEBS, test_flash.hdr_reads);
+
+	return 0;
+}
+UBISPL_TEST(ubispl_test_fastmap_unlisted, 0);
@@ -32,6 +32,9 @@ struct func_info {
 	const char *name;
 	unsigned long code_size;
 	unsigned long call_count;
+	unsigned long self_samples;	/* samples in this function */
+	unsigned long total_samples;	/* samples with it on the stack */
+	int last_sample;		/* last one counted in total_samples */
 	unsigned flags;
 	/* the section this function is in */
 	struct objsection_info *objsection;
@@ -56,6 +59,10 @@ struct func_info *func_list;
 int func_count;
 struct trace_call *call_list;
 int call_count;
+struct trace_sample *sample_list;
+int sample_count;
+struct trace_graph *graph_list;
+int graph_count;
 int verbose;	/* Verbosity level 0=none, 1=warn, 2=notice, 3=info, 4=debug */
 unsigned long text_offset;		/* text address of first function */
 
@@ -86,6 +93,8 @@ static void usage(void)
 		"\n"
 		"Commands\n"
 		"   dump-ftrace\t\tDump out textual data in ftrace format\n"
+		"   dump-profile\t\tDump out a flat profile from samples\n"
+		"   dump-folded\t\tDump out call graph as folded stacks\n"
 		"\n"
 		"Options:\n"
 		"   -m <map>\tSpecify Systen.map file\n"
@@ -227,6 +236,59 @@ static int read_calls(FILE *fin, int count)
 	return 0;
 }
 
+static int read_samples(FILE *fin, int count)
+{
+	struct trace_sample *sample;
+	int i;
+
+	notice("sample count: %d\n", count);
+	sample_list = (struct trace_sample *)calloc(count, sizeof(*sample));
+	if (!sample_list) {
+		error("Cannot allocate sample_list\n");
+		return -1;
+	}
+	sample_count = count;
+
+	sample = sample_list;
+	for (i = 0; i < count; i++, sample++) {
+		if (read_data(fin, sample, sizeof(*sample)))
+			return 1;
+		if (sample->depth < 1 || sample->depth > TRACE_SAMPLE_DEPTH) {
+			error("Invalid depth %u in sample %d\n",
+			      sample->depth, i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int read_graph(FILE *fin, int count)
+{
+	struct trace_graph *node;
+	int i;
+
+	notice("call graph nodes: %d\n", count);
+	graph_list = (struct trace_graph *)calloc(count, sizeof(*node));
+	if (!graph_list) {
+		error("Cannot allocate graph_list\n");
+		return -1;
+	}
+	graph_count = count;
+
+	node = graph_list;
+	for (i = 0; i < count; i++, node++) {
+		if (read_data(fin, node, sizeof(*node)))
+			return 1;
+		/* Parents come first, so this also rules out loops */
+		if (node->parent > i) {
+			error("Invalid parent %u in graph node %d\n",
+			      node->parent, i + 1);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 static int read_profile(FILE *fin, int *not_found)
 {
 	struct trace_output_hdr hdr;
@@ -250,6 +312,16 @@ static int read_profile(FILE *fin, int *not_found)
 			if (read_calls(fin, hdr.rec_count))
 				return 1;
 			break;
+
+		case TRACE_CHUNK_SAMPLES:
+			if (read_samples(fin, hdr.rec_count))
+				return 1;
+			break;
+
+		case TRACE_CHUNK_GRAPH:
+			if (read_graph(fin, hdr.rec_count))
+				return 1;
+			break;
 		}
 	}
 	return 0;
@@ -533,6 +605,120 @@ static int make_ftrace(void)
 	return 0;
 }
 
+static int h_cmp_samples(const void *v1, const void *v2)
+{
+	const struct func_info *f1 = *(struct func_info **)v1;
+	const struct func_info *f2 = *(struct func_info **)v2;
+
+	if (f1->self_samples != f2->self_samples)
+		return f1->self_samples < f2->self_samples ? 1 : -1;
+	if (f1->total_samples != f2->total_samples)
+		return f1->total_samples < f2->total_samples ? 1 : -1;
+
+	return strcmp(f1->name, f2->name);
+}
+
+/*
+ * Each sample counts once towards the 'self' total of the function it was
+ * taken in, and once towards the 'total' of every function on the stack at
+ * the time, however many times it appears there (e.g. with recursion).
+ */
+static int make_flat_profile(void)
+{
+	struct func_info **sorted;
+	struct trace_sample *sample;
+	int missing_count = 0;
+	int i, j, count;
+
+	if (!sample_count) {
+		error("No samples in profile data\n");
+		return -1;
+	}
+	for (i = 0; i < func_count; i++)
+		func_list[i].last_sample = -1;
+
+	for (i = 0, sample = sample_list; i < sample_count; i++, sample++) {
+		for (j = 0; j < sample->depth; j++) {
+			struct func_info *func;
+			uint32_t offset = sample->stack[j];
+
+			/* Return addresses may be just past the caller */
+			func = find_caller_by_offset(j ? offset - 1 : offset);
+			if (!func || offset - func->offset >= func->code_size) {
+				if (!j)
+					missing_count++;
+				continue;
+			}
+			if (!j)
+				func->self_samples++;
+			if (func->last_sample != i) {
+				func->total_samples++;
+				func->last_sample = i;
+			}
+		}
+	}
+
+	sorted = calloc(func_count, sizeof(*sorted));
+	if (!sorted) {
+		error("Cannot allocate sorted function list\n");
+		return -1;
+	}
+	for (i = count = 0; i < func_count; i++) {
+		if (func_list[i].total_samples)
+			sorted[count++] = &func_list[i];
+	}
+	qsort(sorted, count, sizeof(*sorted), h_cmp_samples);
+
+	printf("# %d samples\n", sample_count);
+	printf("#  self%%     self    total  function\n");
+	for (i = 0; i < count; i++) {
+		struct func_info *func = sorted[i];
+
+		printf("%7.2f %8lu %8lu  %s\n",
+		       func->self_samples * 100.0 / sample_count,
+		       func->self_samples, func->total_samples, func->name);
+	}
+	info("profile: %d samples not found in map\n", missing_count);
+	free(sorted);
+
+	return 0;
+}
+
+static void out_folded_path(int num)
+{
+	struct trace_graph *node = &graph_list[num - 1];
+
+	if (node->parent) {
+		out_folded_path(node->parent);
+		putchar(';');
+	}
+	out_func(node->func, 0, "");
+}
+
+/*
+ * Write each call path on a line, with the functions from the outermost
+ * caller separated by ';', then the microseconds spent in the innermost
+ * function. This is the 'folded' format read by flamegraph.pl.
+ */
+static int make_folded(void)
+{
+	struct trace_graph *node;
+	int i;
+
+	if (!graph_count) {
+		error("No call graph in profile data\n");
+		return -1;
+	}
+	for (i = 0, node = graph_list; i < graph_count; i++, node++) {
+		if (!node->self_us)
+			continue;
+		out_folded_path(i + 1);
+		printf(" %llu\n", (unsigned long long)node->self_us);
+	}
+
+	return 0;
+}
+
 static int prof_tool(int argc, char * const argv[],
 		     const char *prof_fname, const char *map_fname,
 		     const char *trace_config_fname)
@@ -553,6 +739,10 @@ static int prof_tool(int argc, char * const argv[],
 
 		if (0 == strcmp(cmd, "dump-ftrace"))
 			err = make_ftrace();
+		else if (0 == strcmp(cmd, "dump-profile"))
+			err = make_flat_profile();
+		else if (0 == strcmp(cmd, "dump-folded"))
+			err = make_folded();
 		else
 			warn("Unknown command '%s'\n", cmd);
 	}